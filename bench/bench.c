@@ -0,0 +1,177 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "bench.h"
+
+#define BENCH_SAMPLES 5                 // Timed batches per case, the median is reported
+#define BENCH_DEFAULT_MIN_TIME 0.5      // Seconds spent timing each case
+
+static double min_time = BENCH_DEFAULT_MIN_TIME;
+static const char** filters;
+static int filter_count;
+static const char* revision;
+
+/* Allocation counting */
+
+static size_t alloc_count;
+static size_t alloc_bytes;
+
+#ifdef __GLIBC__
+// Interpose the allocator so libcurl and json-c are counted along with our code
+extern void* __libc_malloc(size_t size);
+extern void* __libc_calloc(size_t count, size_t size);
+extern void* __libc_realloc(void* ptr, size_t size);
+
+static void count_allocation(size_t size) {
+    __atomic_add_fetch(&alloc_count, 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&alloc_bytes, size, __ATOMIC_RELAXED);
+}
+
+void* malloc(size_t size) {
+    count_allocation(size);
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size) {
+    count_allocation(count * size);
+    return __libc_calloc(count, size);
+}
+
+void* realloc(void* ptr, size_t size) {
+    count_allocation(size);
+    return __libc_realloc(ptr, size);
+}
+#endif
+
+void bench_alloc_counts(size_t* allocations, size_t* bytes) {
+    *allocations = __atomic_load_n(&alloc_count, __ATOMIC_RELAXED);
+    *bytes = __atomic_load_n(&alloc_bytes, __ATOMIC_RELAXED);
+}
+
+/* Peak RSS */
+
+// Restart the VmHWM high-water mark (Linux 4.0+), so each case reports its own peak
+static void reset_peak_rss(void) {
+    FILE* file = fopen("/proc/self/clear_refs", "w");
+    if (!file) return;
+    fputs("5", file);
+    fclose(file);
+}
+
+static long peak_rss_kb(void) {
+    FILE* file = fopen("/proc/self/status", "r");
+    if (!file) return -1;
+
+    char line[256];
+    long peak = -1;
+    while (fgets(line, sizeof(line), file)) {
+        if (strncmp(line, "VmHWM:", 6) == 0) peak = strtol(line + 6, NULL, 10);
+    }
+    fclose(file);
+    return peak;
+}
+
+/* Timing */
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+// Seconds taken by iterations calls of fn, or -1 when one failed
+static double run_batch(bench_fn fn, void* userp, long iterations) {
+    double start = now_seconds();
+    for (long i = 0; i < iterations; i++) {
+        if (fn(userp) != 0) return -1;
+    }
+    return now_seconds() - start;
+}
+
+static int compare_doubles(const void* a, const void* b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+int bench_selected(const char* name) {
+    if (filter_count == 0) return 1;
+    for (int i = 0; i < filter_count; i++) {
+        if (strstr(name, filters[i])) return 1;
+    }
+    return 0;
+}
+
+void bench_run(const char* name, long param, bench_fn fn, void* userp) {
+    if (!bench_selected(name)) return;
+    fprintf(stderr, "%s/%ld...\n", name, param);
+    reset_peak_rss();
+
+    // Warm up caches and pools, then grow the batch until it fills its share of the time
+    long iterations = 1;
+    double elapsed = run_batch(fn, userp, 1);
+    while (elapsed >= 0 && elapsed < min_time / BENCH_SAMPLES) {
+        iterations *= 2;
+        elapsed = run_batch(fn, userp, iterations);
+    }
+
+    double samples[BENCH_SAMPLES];
+    size_t allocs_before, bytes_before, allocs_after, bytes_after;
+    bench_alloc_counts(&allocs_before, &bytes_before);
+    for (int i = 0; i < BENCH_SAMPLES && elapsed >= 0; i++) {
+        elapsed = run_batch(fn, userp, iterations);
+        samples[i] = elapsed * 1e9 / (double)iterations;
+    }
+    bench_alloc_counts(&allocs_after, &bytes_after);
+
+    if (elapsed < 0) {
+        printf("{\"bench\": \"%s\", \"param\": %ld, \"rev\": \"%s\", \"error\": \"operation failed\"}\n",
+               name, param, revision);
+        fflush(stdout);
+        return;
+    }
+
+    qsort(samples, BENCH_SAMPLES, sizeof(double), compare_doubles);
+    double ops = (double)iterations * BENCH_SAMPLES;
+    printf("{\"bench\": \"%s\", \"param\": %ld, \"rev\": \"%s\", \"iterations\": %ld, "
+           "\"ns_per_op\": %.1f, \"ns_per_op_min\": %.1f, \"allocs_per_op\": %.2f, "
+           "\"bytes_per_op\": %.1f, \"peak_rss_kb\": %ld}\n",
+           name, param, revision, iterations * BENCH_SAMPLES,
+           samples[BENCH_SAMPLES / 2], samples[0],
+           (double)(allocs_after - allocs_before) / ops, (double)(bytes_after - bytes_before) / ops,
+           peak_rss_kb());
+    fflush(stdout);
+}
+
+static void usage(const char* program) {
+    fprintf(stderr, "Usage: %s [--min-time SECONDS] [FILTER...]\n"
+                    "Prints one JSON object per benchmark case on stdout. Cases run when their\n"
+                    "name contains one of the filters, or always without filters.\n", program);
+}
+
+int main(int argc, char** argv) {
+    filters = calloc(argc, sizeof(char*));
+    if (!filters) return 1;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--min-time") == 0 && i + 1 < argc) {
+            min_time = atof(argv[++i]);
+        } else if (argv[i][0] == '-') {
+            usage(argv[0]);
+            return 1;
+        } else {
+            filters[filter_count++] = argv[i];
+        }
+    }
+
+    // Lets results from different commits be told apart, see the bench target
+    revision = getenv("BENCH_REV") ? getenv("BENCH_REV") : "";
+
+    bench_decode_suite();
+    bench_buffer_suite();
+    bench_transfer_suite();
+    bench_render_suite();
+
+    free(filters);
+    return 0;
+}
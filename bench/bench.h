@@ -0,0 +1,39 @@
+#ifndef ROMM_BENCH_H
+#define ROMM_BENCH_H
+
+#include <stddef.h>
+
+// One operation of a benchmark; returns 0, or -1 to abort the case
+typedef int (*bench_fn)(void* userp);
+
+// Time fn until it ran for the configured minimum time, then print one JSON line:
+// {"bench": name, "param": param, "ns_per_op": ..., "allocs_per_op": ..., ...}
+// Allocations and bytes cover every malloc, calloc and realloc in the process,
+// peak RSS is the high-water mark reached while the case ran.
+void bench_run(const char* name, long param, bench_fn fn, void* userp);
+
+// Command line selection: a case runs when its name contains one of the filters
+int bench_selected(const char* name);
+
+// Allocation counters, also usable around setup code
+void bench_alloc_counts(size_t* allocations, size_t* bytes);
+
+// Loopback HTTP/1.1 server answering every GET with the current body
+typedef struct BenchServer BenchServer;
+
+BenchServer* bench_server_start(void);
+void bench_server_stop(BenchServer* server);
+const char* bench_server_url(const BenchServer* server);
+void bench_server_set_body(BenchServer* server, const char* body, size_t length);
+
+// Synthetic RomM payloads of count records, caller frees the result
+char* bench_platforms_json(int count, size_t* length);
+char* bench_roms_json(int count, size_t* length);   // {"items": [...], "total": count}
+
+// Suites, each registers its cases through bench_run
+void bench_decode_suite(void);
+void bench_buffer_suite(void);
+void bench_transfer_suite(void);
+void bench_render_suite(void);
+
+#endif // ROMM_BENCH_H
@@ -0,0 +1,64 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bench.h"
+#include "base64.h"
+#include "http.h"
+#include "response.h"
+
+typedef struct {
+    size_t size;
+    unsigned char* data;
+} BufferCase;
+
+// Grow a response the way a body arrives, 64 bytes at a time
+static int response_append_op(void* userp) {
+    BufferCase* c = (BufferCase*)userp;
+    static const char chunk[] = "0123456789abcdef0123456789abcdef0123456789abcdef0123456789abcdef";
+
+    Response* response = response_init();
+    if (!response) return -1;
+    while (response_get_size(response) < c->size) {
+        response_append(response, chunk);
+    }
+    response_free(response);
+    return 0;
+}
+
+static int base64_encode_op(void* userp) {
+    BufferCase* c = (BufferCase*)userp;
+    size_t length;
+
+    unsigned char* encoded = base64_encode(c->data, c->size, &length);
+    if (!encoded) return -1;
+    free(encoded);
+    return 0;
+}
+
+static int authorization_header_op(void* userp) {
+    (void)userp;
+    char* header = generate_authorization_header("romm-user", "a rather long password of 32 ch");
+    if (!header) return -1;
+    free(header);
+    return 0;
+}
+
+void bench_buffer_suite(void) {
+    static const size_t response_sizes[] = { 4096, 65536, 1 << 20, 16 << 20 };
+    static const size_t base64_sizes[] = { 48, 4096, 1 << 20 };
+
+    for (size_t i = 0; i < sizeof(response_sizes) / sizeof(response_sizes[0]); i++) {
+        BufferCase c = { response_sizes[i], NULL };
+        bench_run("response_append", (long)c.size, response_append_op, &c);
+    }
+
+    for (size_t i = 0; i < sizeof(base64_sizes) / sizeof(base64_sizes[0]); i++) {
+        BufferCase c = { base64_sizes[i], malloc(base64_sizes[i]) };
+        if (!c.data) return;
+        for (size_t j = 0; j < c.size; j++) c.data[j] = (unsigned char)(j * 131 + 7);
+        bench_run("base64_encode", (long)c.size, base64_encode_op, &c);
+        free(c.data);
+    }
+
+    bench_run("authorization_header", 0, authorization_header_op, NULL);
+}
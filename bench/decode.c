@@ -0,0 +1,100 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bench.h"
+#include "http.h"
+#include "json_stream.h"
+#include "platform.h"
+#include "rom.h"
+
+#define STREAM_CHUNK 16384   // Bytes per feed, about what one curl write callback delivers
+
+static const int record_counts[] = { 100, 1000, 10000, 50000 };
+
+typedef struct {
+    HttpSession* session;
+    const char* payload;
+    size_t payload_length;
+    int count;
+} DecodeCase;
+
+// Full path of the platform list: HTTP over loopback, stream split and record parsing
+static int platform_decode_op(void* userp) {
+    DecodeCase* c = (DecodeCase*)userp;
+    Arena* arena = arena_create(0);
+    RomMPlatform* platforms = NULL;
+    int count = 0;
+
+    int result = fetch_platform_list(c->session, arena, &platforms, &count);
+    arena_release(arena);
+    return result == 0 && count == c->count ? 0 : -1;
+}
+
+static int rom_page_decode_op(void* userp) {
+    DecodeCase* c = (DecodeCase*)userp;
+    RomMRomPage page;
+
+    if (fetch_rom_page(c->session, 4, 0, c->count, &page) != 0) return -1;
+    int count = page.count;
+    free_rom_page(&page);
+    return count == c->count ? 0 : -1;
+}
+
+static int count_element(struct json_object* element, void* userp) {
+    (void)element;
+    (*(int*)userp)++;
+    return 0;
+}
+
+// Stream splitting alone, without the transport or record parsing
+static int json_stream_op(void* userp) {
+    DecodeCase* c = (DecodeCase*)userp;
+    int count = 0;
+    JsonStream* stream = json_stream_init(NULL, count_element, &count);
+    if (!stream) return -1;
+
+    int result = 0;
+    for (size_t offset = 0; offset < c->payload_length && result == 0; offset += STREAM_CHUNK) {
+        size_t length = c->payload_length - offset < STREAM_CHUNK ? c->payload_length - offset : STREAM_CHUNK;
+        result = json_stream_feed(stream, c->payload + offset, length);
+    }
+    if (result == 0 && json_stream_finish(stream, NULL) != c->count) result = -1;
+    json_stream_free(stream);
+    return result;
+}
+
+void bench_decode_suite(void) {
+    if (!bench_selected("platform_decode") && !bench_selected("rom_page_decode") &&
+        !bench_selected("json_stream_split")) {
+        return;
+    }
+
+    BenchServer* server = bench_server_start();
+    if (!server) return;
+    HttpSession* session = http_session_init(bench_server_url(server), "bench", "bench");
+    if (!session) {
+        bench_server_stop(server);
+        return;
+    }
+
+    for (size_t i = 0; i < sizeof(record_counts) / sizeof(record_counts[0]); i++) {
+        DecodeCase c = { session, NULL, 0, record_counts[i] };
+
+        char* payload = bench_platforms_json(c.count, &c.payload_length);
+        c.payload = payload;
+        bench_server_set_body(server, payload, c.payload_length);
+        bench_run("platform_decode", c.count, platform_decode_op, &c);
+        bench_run("json_stream_split", c.count, json_stream_op, &c);
+        free(payload);
+
+        payload = bench_roms_json(c.count, &c.payload_length);
+        c.payload = payload;
+        bench_server_set_body(server, payload, c.payload_length);
+        bench_run("rom_page_decode", c.count, rom_page_decode_op, &c);
+        free(payload);
+    }
+
+    // Connections close with the session, before the server goes away
+    http_session_free(session);
+    bench_server_stop(server);
+}
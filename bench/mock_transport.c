@@ -0,0 +1,385 @@
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+#include <zlib.h>
+#include "mock_transport.h"
+
+#define MOCK_DEFAULT_CHUNK (16 * 1024)
+#define MOCK_PROGRESS_MS 20    // Progress reported at least this often while waiting
+
+typedef struct {
+    char* path;
+    int status;
+    char* body;
+    size_t length;
+    char* etag;
+    char* gzip_body;       // Compressed copy of body, only while gzip is enabled
+    size_t gzip_length;
+} MockFixture;
+
+struct MockTransport {
+    HttpTransport base;
+    MockFixture* fixtures;
+    int fixture_count;
+    int fixture_capacity;
+    MockFaults faults;
+    bool gzip;
+    int drops_left;
+    MockStats stats;
+};
+
+static double now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1000.0 + (double)ts.tv_nsec / 1e6;
+}
+
+// Sleep until the deadline in short slices, reporting progress like a stalled
+// connection does; returns non-zero when the transfer was aborted meanwhile
+static int wait_until(double deadline_ms, const HttpTransfer* transfer, long long total, long long now) {
+    for (;;) {
+        if (transfer->progress_fn && transfer->progress_fn(transfer->progress_userp, total, now) != 0) return -1;
+
+        double left = deadline_ms - now_ms();
+        if (left <= 0) return 0;
+        if (left > MOCK_PROGRESS_MS) left = MOCK_PROGRESS_MS;
+        struct timespec ts = { 0, (long)(left * 1e6) };
+        nanosleep(&ts, NULL);
+    }
+}
+
+static int compress_fixture(MockFixture* fixture) {
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+    // 15 + 16 writes a gzip wrapper, like a web server's gzip filter
+    if (deflateInit2(&zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) return -1;
+
+    size_t capacity = deflateBound(&zs, fixture->length);
+    free(fixture->gzip_body);
+    fixture->gzip_body = malloc(capacity);
+    if (!fixture->gzip_body) {
+        deflateEnd(&zs);
+        return -1;
+    }
+
+    zs.next_in = (unsigned char*)fixture->body;
+    zs.avail_in = (uInt)fixture->length;
+    zs.next_out = (unsigned char*)fixture->gzip_body;
+    zs.avail_out = (uInt)capacity;
+    int rc = deflate(&zs, Z_FINISH);
+    fixture->gzip_length = zs.total_out;
+    deflateEnd(&zs);
+    return rc == Z_STREAM_END ? 0 : -1;
+}
+
+static const MockFixture* find_fixture(const MockTransport* mock, const char* path) {
+    size_t path_length = strcspn(path, "?");
+
+    for (int i = 0; i < mock->fixture_count; i++) {
+        if (strcmp(mock->fixtures[i].path, path) == 0) return &mock->fixtures[i];
+    }
+    for (int i = 0; i < mock->fixture_count; i++) {
+        const char* fixture_path = mock->fixtures[i].path;
+        if (strlen(fixture_path) == path_length && strncmp(fixture_path, path, path_length) == 0) {
+            return &mock->fixtures[i];
+        }
+    }
+    return NULL;
+}
+
+// Value of a request header, or NULL
+static const char* header_value(const HttpTransfer* transfer, const char* name) {
+    size_t name_length = strlen(name);
+    for (int i = 0; transfer->headers && transfer->headers[i]; i++) {
+        const char* line = transfer->headers[i];
+        if (strncasecmp(line, name, name_length) == 0 && line[name_length] == ':') {
+            const char* value = line + name_length + 1;
+            while (*value == ' ') value++;
+            return value;
+        }
+    }
+    return NULL;
+}
+
+static int emit_header(const HttpTransfer* transfer, const char* format, ...) __attribute__((format(printf, 2, 3)));
+
+static int emit_header(const HttpTransfer* transfer, const char* format, ...) {
+    if (!transfer->header_fn) return 0;
+
+    char line[512];
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+    if (length < 0 || (size_t)length >= sizeof(line)) return -1;
+    return transfer->header_fn(line, 1, (size_t)length, transfer->header_userp) == (size_t)length ? 0 : -1;
+}
+
+static const char* reason_phrase(int status) {
+    switch (status) {
+        case 200: return "OK";
+        case 206: return "Partial Content";
+        case 304: return "Not Modified";
+        case 404: return "Not Found";
+        case 416: return "Range Not Satisfiable";
+        default: return "Status";
+    }
+}
+
+// Whether this request is one of the configured drops
+static bool take_drop(MockTransport* mock) {
+    if (mock->faults.drop_after < 0) return false;
+
+    int left = __atomic_load_n(&mock->drops_left, __ATOMIC_RELAXED);
+    while (left > 0) {
+        if (__atomic_compare_exchange_n(&mock->drops_left, &left, left - 1, false,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static int mock_perform(HttpTransport* base, const HttpTransfer* transfer) {
+    MockTransport* mock = (MockTransport*)base;
+    MockFaults faults = mock->faults;
+    size_t chunk_size = faults.chunk_size ? faults.chunk_size : MOCK_DEFAULT_CHUNK;
+    __atomic_add_fetch(&mock->stats.requests, 1, __ATOMIC_RELAXED);
+
+    if (faults.latency_ms && wait_until(now_ms() + faults.latency_ms, transfer, 0, 0) != 0) return -1;
+
+    // Path below the server url, the host part is not checked
+    const char* path = strstr(transfer->url, "://");
+    path = path ? strchr(path + 3, '/') : transfer->url;
+    if (!path) path = "/";
+
+    const MockFixture* fixture = find_fixture(mock, path);
+    int status = fixture ? fixture->status : 404;
+    const char* body = fixture ? fixture->body : "{\"detail\": \"Not Found\"}";
+    size_t length = fixture ? fixture->length : strlen(body);
+    size_t offset = 0;
+    char content_range[96] = "";
+
+    const char* if_none_match = header_value(transfer, "If-None-Match");
+    const char* range = header_value(transfer, "Range");
+    long long range_start = range && strncmp(range, "bytes=", 6) == 0 ? atoll(range + 6) : 0;
+
+    if (status == 200 && fixture->etag && if_none_match && strcmp(if_none_match, fixture->etag) == 0) {
+        status = 304;
+        length = 0;
+    } else if (status == 200 && range_start > 0) {
+        if ((size_t)range_start >= length) {
+            snprintf(content_range, sizeof(content_range), "bytes */%zu", length);
+            status = 416;
+            length = 0;
+        } else {
+            snprintf(content_range, sizeof(content_range), "bytes %lld-%zu/%zu", range_start, length - 1, length);
+            status = 206;
+            offset = (size_t)range_start;
+            length -= offset;
+        }
+    }
+
+    const char* accept_encoding = header_value(transfer, "Accept-Encoding");
+    bool gzip = status == 200 && fixture && fixture->gzip_body && accept_encoding && strstr(accept_encoding, "gzip");
+    if (gzip) {
+        body = fixture->gzip_body;
+        length = fixture->gzip_length;
+    }
+
+    if (emit_header(transfer, "HTTP/1.1 %d %s\r\n", status, reason_phrase(status)) != 0 ||
+        emit_header(transfer, "Content-Length: %zu\r\n", length) != 0 ||
+        (gzip && emit_header(transfer, "Content-Encoding: gzip\r\n") != 0) ||
+        (content_range[0] && emit_header(transfer, "Content-Range: %s\r\n", content_range) != 0) ||
+        (fixture && fixture->etag && emit_header(transfer, "ETag: %s\r\n", fixture->etag) != 0) ||
+        emit_header(transfer, "\r\n") != 0) {
+        return -1;
+    }
+
+    bool drop = take_drop(mock);
+    bool stalled = faults.stall_ms == 0;
+    double start = now_ms();
+    size_t sent = 0;
+    while (sent < length) {
+        if (drop && (long long)sent >= faults.drop_after) {
+            __atomic_add_fetch(&mock->stats.dropped, 1, __ATOMIC_RELAXED);
+            fprintf(stderr, "Request to %s failed: connection dropped by mock after %zu bytes\n", transfer->url, sent);
+            return -1;
+        }
+        if (!stalled && sent >= length / 2) {
+            stalled = true;
+            if (wait_until(now_ms() + faults.stall_ms, transfer, (long long)length, (long long)sent) != 0) return -1;
+            start += faults.stall_ms;
+        }
+
+        size_t chunk = length - sent < chunk_size ? length - sent : chunk_size;
+        if (drop && (long long)(sent + chunk) > faults.drop_after) chunk = (size_t)(faults.drop_after - (long long)sent);
+
+        // Deliver each chunk no earlier than the bandwidth cap allows
+        if (faults.bytes_per_sec) {
+            double due = start + (double)(sent + chunk) * 1000.0 / (double)faults.bytes_per_sec;
+            if (wait_until(due, transfer, (long long)length, (long long)sent) != 0) return -1;
+        }
+
+        if (chunk > 0 && transfer->write_fn((void*)(body + offset + sent), 1, chunk, transfer->write_userp) != chunk) {
+            return -1;
+        }
+        sent += chunk;
+        __atomic_add_fetch(&mock->stats.body_bytes, chunk, __ATOMIC_RELAXED);
+        if (transfer->progress_fn &&
+            transfer->progress_fn(transfer->progress_userp, (long long)length, (long long)sent) != 0) {
+            return -1;
+        }
+    }
+    return status;
+}
+
+static void mock_destroy(HttpTransport* base) {
+    MockTransport* mock = (MockTransport*)base;
+
+    for (int i = 0; i < mock->fixture_count; i++) {
+        free(mock->fixtures[i].path);
+        free(mock->fixtures[i].body);
+        free(mock->fixtures[i].etag);
+        free(mock->fixtures[i].gzip_body);
+    }
+    free(mock->fixtures);
+    free(mock);
+}
+
+static const HttpTransportOps mock_transport_ops = {
+    mock_perform,
+    mock_destroy,
+};
+
+MockTransport* mock_transport_create(void) {
+    MockTransport* mock = calloc(1, sizeof(struct MockTransport));
+    if (!mock) return NULL;
+
+    mock->base.ops = &mock_transport_ops;
+    mock->faults.drop_after = -1;
+    return mock;
+}
+
+HttpTransport* mock_transport_base(MockTransport* mock) {
+    return &mock->base;
+}
+
+int mock_transport_add(MockTransport* mock, const char* path, int status,
+                       const char* body, size_t length, const char* etag) {
+    MockFixture* fixture = NULL;
+    for (int i = 0; i < mock->fixture_count; i++) {
+        if (strcmp(mock->fixtures[i].path, path) == 0) fixture = &mock->fixtures[i];
+    }
+
+    if (!fixture) {
+        if (mock->fixture_count == mock->fixture_capacity) {
+            int capacity = mock->fixture_capacity ? mock->fixture_capacity * 2 : 16;
+            MockFixture* fixtures = realloc(mock->fixtures, capacity * sizeof(MockFixture));
+            if (!fixtures) return -1;
+            mock->fixtures = fixtures;
+            mock->fixture_capacity = capacity;
+        }
+        fixture = &mock->fixtures[mock->fixture_count++];
+        memset(fixture, 0, sizeof(MockFixture));
+        fixture->path = strdup(path);
+    }
+
+    free(fixture->body);
+    free(fixture->etag);
+    fixture->status = status;
+    fixture->body = malloc(length + 1);
+    fixture->length = length;
+    fixture->etag = etag ? strdup(etag) : NULL;
+    if (!fixture->path || !fixture->body) return -1;
+    memcpy(fixture->body, body, length);
+    fixture->body[length] = '\0';
+
+    free(fixture->gzip_body);
+    fixture->gzip_body = NULL;
+    return mock->gzip ? compress_fixture(fixture) : 0;
+}
+
+static char* read_file(const char* path, size_t* length) {
+    FILE* file = fopen(path, "rb");
+    if (!file) return NULL;
+
+    char* data = NULL;
+    long size = -1;
+    if (fseek(file, 0, SEEK_END) == 0) size = ftell(file);
+    if (size >= 0 && fseek(file, 0, SEEK_SET) == 0) data = malloc((size_t)size + 1);
+    if (data && fread(data, 1, (size_t)size, file) != (size_t)size) {
+        free(data);
+        data = NULL;
+    }
+    fclose(file);
+    *length = data ? (size_t)size : 0;
+    return data;
+}
+
+int mock_transport_load(MockTransport* mock, const char* dir) {
+    char path[1024];
+    snprintf(path, sizeof(path), "%s/index.txt", dir);
+
+    FILE* index = fopen(path, "r");
+    if (!index) {
+        fprintf(stderr, "Failed to open fixture index %s\n", path);
+        return -1;
+    }
+
+    char line[2048];
+    int count = 0;
+    while (fgets(line, sizeof(line), index)) {
+        char url_path[1024], file_name[512], etag[256];
+        int status = 200;
+        etag[0] = '\0';
+        if (line[0] == '#' || sscanf(line, "%1023s %511s %d %255s", url_path, file_name, &status, etag) < 2) continue;
+
+        size_t length;
+        snprintf(path, sizeof(path), "%s/%s", dir, file_name);
+        char* body = read_file(path, &length);
+        if (!body) {
+            fprintf(stderr, "Failed to read fixture %s\n", path);
+            fclose(index);
+            return -1;
+        }
+        int result = mock_transport_add(mock, url_path, status, body, length, etag[0] ? etag : NULL);
+        free(body);
+        if (result != 0) {
+            fclose(index);
+            return -1;
+        }
+        count++;
+    }
+    fclose(index);
+    return count;
+}
+
+void mock_transport_set_faults(MockTransport* mock, const MockFaults* faults) {
+    mock->faults = *faults;
+    __atomic_store_n(&mock->drops_left, faults->drop_count, __ATOMIC_RELAXED);
+}
+
+void mock_transport_stats(MockTransport* mock, MockStats* stats) {
+    stats->requests = __atomic_load_n(&mock->stats.requests, __ATOMIC_RELAXED);
+    stats->dropped = __atomic_load_n(&mock->stats.dropped, __ATOMIC_RELAXED);
+    stats->body_bytes = __atomic_load_n(&mock->stats.body_bytes, __ATOMIC_RELAXED);
+}
+
+int mock_transport_set_gzip(MockTransport* mock, bool enabled) {
+    mock->gzip = enabled;
+    for (int i = 0; i < mock->fixture_count; i++) {
+        MockFixture* fixture = &mock->fixtures[i];
+        if (!enabled) {
+            free(fixture->gzip_body);
+            fixture->gzip_body = NULL;
+        } else if (!fixture->gzip_body && compress_fixture(fixture) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
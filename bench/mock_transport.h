@@ -0,0 +1,53 @@
+#ifndef ROMM_MOCK_TRANSPORT_H
+#define ROMM_MOCK_TRANSPORT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "transport.h"
+
+// Stand-in for a RomM server: answers GETs and POSTs (whose body is ignored) from
+// fixtures held in memory, with injectable faults. Honors "Range: bytes=N-"
+// (206 / 416) and "If-None-Match" (304 when the fixture has that ETag), and
+// "Accept-Encoding: gzip" once gzip is enabled; unknown paths get a 404.
+typedef struct MockTransport MockTransport;
+
+// Applied to every request until changed; zero values disable a fault
+typedef struct MockFaults {
+    unsigned int latency_ms;         // Before the status line, like a round trip
+    unsigned long long bytes_per_sec;  // Body bandwidth cap
+    size_t chunk_size;               // Bytes per write callback, 16KB when 0
+    long long drop_after;            // Connection drops after this many body bytes, -1 never
+    int drop_count;                  // Requests that drop; each dropped request uses one up
+    unsigned int stall_ms;           // Pause once mid-body, progress keeps being reported
+} MockFaults;
+
+typedef struct MockStats {
+    unsigned long requests;
+    unsigned long dropped;
+    unsigned long long body_bytes;
+} MockStats;
+
+MockTransport* mock_transport_create(void);
+
+// The transport to hand to http_session_init_transport, which then owns the mock;
+// the MockTransport pointer stays usable until the session is freed
+HttpTransport* mock_transport_base(MockTransport* mock);
+
+// Serve body (copied) for path, matched with its query string first and then without.
+// etag may be NULL. A later fixture for the same path replaces the earlier one.
+int mock_transport_add(MockTransport* mock, const char* path, int status,
+                       const char* body, size_t length, const char* etag);
+
+// Recorded responses: each line of <dir>/index.txt reads "PATH FILE [STATUS [ETAG]]"
+// with FILE relative to dir, e.g. captured with curl -o. Returns the count or -1.
+int mock_transport_load(MockTransport* mock, const char* dir);
+
+// Set before requests run; not synchronized with transfers in flight
+void mock_transport_set_faults(MockTransport* mock, const MockFaults* faults);
+
+// Serve full 200 bodies gzip-compressed to requests that accept it. Fixtures are
+// compressed once, when enabled or added. Returns 0 or -1.
+int mock_transport_set_gzip(MockTransport* mock, bool enabled);
+void mock_transport_stats(MockTransport* mock, MockStats* stats);
+
+#endif // ROMM_MOCK_TRANSPORT_H
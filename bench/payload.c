@@ -0,0 +1,124 @@
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bench.h"
+
+// Shaped after RomM 3.x responses; deterministic so runs stay comparable
+static const char* title_words[] = {
+    "Super", "Mega", "Legend", "Quest", "Fighter", "Racing", "Dragon", "Star", "World",
+    "Adventure", "Island", "Kart", "Tactics", "Soccer", "Pinball", "Castle", "Ninja", "Zero"
+};
+#define TITLE_WORD_COUNT (sizeof(title_words) / sizeof(title_words[0]))
+
+typedef struct {
+    char* data;
+    size_t length;
+    size_t capacity;
+} Buffer;
+
+static void append(Buffer* buffer, const char* format, ...) {
+    va_list args;
+    for (;;) {
+        size_t space = buffer->capacity - buffer->length;
+        va_start(args, format);
+        int needed = vsnprintf(buffer->data ? buffer->data + buffer->length : NULL, space, format, args);
+        va_end(args);
+        if (needed >= 0 && (size_t)needed < space) {
+            buffer->length += (size_t)needed;
+            return;
+        }
+
+        size_t capacity = buffer->capacity ? buffer->capacity * 2 : 65536;
+        char* data = realloc(buffer->data, capacity);
+        if (!data) {
+            fprintf(stderr, "Out of memory building benchmark payload\n");
+            exit(1);
+        }
+        buffer->data = data;
+        buffer->capacity = capacity;
+    }
+}
+
+// Title of one to four words, numbered so every record is distinct
+static void make_title(int index, char* title, size_t title_size) {
+    unsigned int seed = (unsigned int)index * 2654435761u;
+    int words = 1 + (int)(seed % 4);
+    size_t length = 0;
+
+    title[0] = '\0';
+    for (int i = 0; i < words && length < title_size; i++) {
+        seed = seed * 1103515245u + 12345u;
+        length += snprintf(title + length, title_size - length, "%s%s", i ? " " : "",
+                           title_words[(seed >> 16) % TITLE_WORD_COUNT]);
+    }
+    if (length < title_size) snprintf(title + length, title_size - length, " %d", index);
+}
+
+static void append_firmware(Buffer* buffer, int id) {
+    append(buffer,
+           "{\"id\": %d, \"file_name\": \"bios_%d.bin\", \"file_name_no_tags\": \"bios_%d\", "
+           "\"file_name_no_ext\": \"bios_%d\", \"file_extension\": \"bin\", \"file_path\": \"bios/%d\", "
+           "\"file_size_bytes\": 16384, \"full_path\": \"bios/%d/bios_%d.bin\", \"is_verified\": true, "
+           "\"crc_hash\": \"%08x\", \"md5_hash\": \"%032x\", \"sha1_hash\": \"%040x\", "
+           "\"created_at\": \"2024-05-01T10:00:00\", \"updated_at\": \"2024-05-01T10:00:00\"}",
+           id, id, id, id, id, id, id, id * 7919u, id * 31u, id * 131u);
+}
+
+char* bench_platforms_json(int count, size_t* length) {
+    Buffer buffer = { NULL, 0, 0 };
+    char title[96];
+
+    append(&buffer, "[");
+    for (int i = 0; i < count; i++) {
+        make_title(i, title, sizeof(title));
+        append(&buffer,
+               "%s{\"id\": %d, \"slug\": \"platform-%d\", \"fs_slug\": \"platform-%d\", \"name\": \"%s\", "
+               "\"rom_count\": %d, \"igdb_id\": %d, \"sgdb_id\": null, \"moby_id\": %d, "
+               "\"logo_path\": \"/assets/platforms/platform-%d.ico\", \"firmware\": [",
+               i ? ", " : "", i + 1, i, i, title, (i * 37) % 5000, i + 10, i + 20, i);
+        // Every eighth platform needs BIOS files
+        if (i % 8 == 0) {
+            append_firmware(&buffer, i * 2 + 1);
+            append(&buffer, ", ");
+            append_firmware(&buffer, i * 2 + 2);
+        }
+        append(&buffer, "], \"created_at\": \"2024-05-01T10:00:00\", \"updated_at\": \"2024-06-0%dT10:00:00\"}",
+               1 + i % 9);
+    }
+    append(&buffer, "]");
+
+    *length = buffer.length;
+    return buffer.data;
+}
+
+char* bench_roms_json(int count, size_t* length) {
+    Buffer buffer = { NULL, 0, 0 };
+    char title[96];
+
+    append(&buffer, "{\"items\": [");
+    for (int i = 0; i < count; i++) {
+        make_title(i, title, sizeof(title));
+        append(&buffer,
+               "%s{\"id\": %d, \"igdb_id\": %d, \"sgdb_id\": null, \"moby_id\": null, \"platform_id\": 4, "
+               "\"platform_slug\": \"gba\", \"platform_name\": \"Game Boy Advance\", "
+               "\"file_name\": \"%s (USA).gba\", \"file_name_no_tags\": \"%s\", \"file_name_no_ext\": \"%s (USA)\", "
+               "\"file_extension\": \"gba\", \"file_path\": \"roms/gba\", \"file_size_bytes\": %d, "
+               "\"crc_hash\": \"%08x\", \"md5_hash\": \"%032x\", \"sha1_hash\": \"%040x\", "
+               "\"name\": \"%s\", \"slug\": \"rom-%d\", "
+               "\"summary\": \"A synthetic game used to measure list decoding. It has a summary of typical length "
+               "so that string handling weighs what it does with real metadata.\", "
+               "\"first_release_date\": %d, \"path_cover_s\": \"/assets/romm/resources/roms/4/%d/cover/small.png\", "
+               "\"path_cover_l\": \"/assets/romm/resources/roms/4/%d/cover/big.png\", \"has_cover\": true, "
+               "\"url_cover\": \"https://images.igdb.com/igdb/image/upload/t_cover_big/co%d.png\", "
+               "\"revision\": \"\", \"multi\": false, \"files\": [], "
+               "\"full_path\": \"roms/gba/%s (USA).gba\", "
+               "\"created_at\": \"2024-05-01T10:00:00\", \"updated_at\": \"2024-05-01T10:00:00\"}",
+               i ? ", " : "", i + 1, 1000 + i, title, title, title, 4194304 + (i % 64) * 65536,
+               i * 7919u, i * 31u, i * 131u, title, i, 946684800 + i * 86400, i + 1, i + 1, i, title);
+    }
+    append(&buffer, "], \"total\": %d, \"limit\": %d, \"offset\": 0}", count, count);
+
+    *length = buffer.length;
+    return buffer.data;
+}
@@ -0,0 +1,94 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bench.h"
+#include "client.h"
+
+#include "SDL/SDL.h"
+#include "SDL/SDL_ttf.h"
+
+#define RENDER_WIDTH 640            // Miyoo Mini screen
+#define RENDER_HEIGHT 480
+#define RENDER_FONT_SIZE 16
+#define RENDER_TEXT_BUDGET (1024 * 1024)  // Same budget as the app's text cache
+#define RENDER_PLATFORMS 1000
+#define RENDER_DEFAULT_FONT "/usr/share/fonts/truetype/dejavu/DejaVuSans.ttf"
+
+// The app's init_menu expects the device's font and display; this sets up the
+// same state offscreen through SDL's dummy video driver
+static int init_offscreen(MenuState* state, const char* font_path) {
+    memset(state, 0, sizeof(MenuState));
+    setenv("SDL_VIDEODRIVER", "dummy", 0);
+
+    if (SDL_Init(SDL_INIT_VIDEO) < 0 || TTF_Init() < 0) {
+        fprintf(stderr, "Skipping render benchmarks, SDL could not initialize: %s\n", SDL_GetError());
+        return -1;
+    }
+
+    state->display_width = RENDER_WIDTH;
+    state->display_height = RENDER_HEIGHT;
+    state->font_size = RENDER_FONT_SIZE;
+    state->font = TTF_OpenFont(font_path, state->font_size);
+    state->screen = SDL_SetVideoMode(RENDER_WIDTH, RENDER_HEIGHT, 32, SDL_SWSURFACE);
+    state->renderer = state->screen ?
+                      SDL_CreateRGBSurface(SDL_SWSURFACE, RENDER_WIDTH, RENDER_HEIGHT, 32, 0, 0, 0, 0) : NULL;
+    state->text_cache = surface_cache_init(RENDER_TEXT_BUDGET);
+    if (!state->font || !state->screen || !state->renderer || !state->text_cache) {
+        fprintf(stderr, "Skipping render benchmarks, offscreen setup failed (font %s): %s\n",
+                font_path, SDL_GetError());
+        return -1;
+    }
+
+    state->platform_arena = arena_create(0);
+    state->platforms = arena_alloc(state->platform_arena, RENDER_PLATFORMS * sizeof(RomMPlatform));
+    if (!state->platforms) return -1;
+    for (int i = 0; i < RENDER_PLATFORMS; i++) {
+        char name[64];
+        snprintf(name, sizeof(name), "Platform %d", i);
+        state->platforms[i].id = i + 1;
+        state->platforms[i].name = arena_strdup(state->platform_arena, name);
+    }
+    state->platform_count = RENDER_PLATFORMS;
+    return 0;
+}
+
+// Same frame again: cache hits, clears and blits only
+static int render_static_op(void* userp) {
+    render_platform_list((MenuState*)userp);
+    return 0;
+}
+
+// Cursor moving down one row per frame and wrapping, as with a held d-pad
+static int render_scroll_op(void* userp) {
+    MenuState* state = (MenuState*)userp;
+
+    state->selected_index = (state->selected_index + 1) % state->platform_count;
+    if (state->selected_index == 0) state->scroll_offset = 0;
+    if (state->selected_index >= state->scroll_offset + 10) state->scroll_offset++;
+    render_platform_list(state);
+    return 0;
+}
+
+// Every text rasterized again, the first frame after startup
+static int render_cold_op(void* userp) {
+    MenuState* state = (MenuState*)userp;
+
+    surface_cache_free(state->text_cache);
+    state->text_cache = surface_cache_init(RENDER_TEXT_BUDGET);
+    if (!state->text_cache) return -1;
+    render_platform_list(state);
+    return 0;
+}
+
+void bench_render_suite(void) {
+    if (!bench_selected("render_platform_list")) return;
+
+    const char* font_path = getenv("BENCH_FONT") ? getenv("BENCH_FONT") : RENDER_DEFAULT_FONT;
+    MenuState state;
+    if (init_offscreen(&state, font_path) == 0) {
+        bench_run("render_platform_list_static", RENDER_PLATFORMS, render_static_op, &state);
+        bench_run("render_platform_list_scroll", RENDER_PLATFORMS, render_scroll_op, &state);
+        bench_run("render_platform_list_cold", RENDER_PLATFORMS, render_cold_op, &state);
+    }
+    cleanup_menu(&state);
+}
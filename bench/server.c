@@ -0,0 +1,155 @@
+#define _GNU_SOURCE  // strcasestr
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include "bench.h"
+
+// Serves every request of a keep-alive connection from one thread per connection.
+// The body is swapped only between cases, while no request is in flight.
+struct BenchServer {
+    int listen_fd;
+    pthread_t thread;
+    char url[64];
+    const char* body;
+    size_t body_length;
+};
+
+typedef struct {
+    BenchServer* server;
+    int fd;
+} Connection;
+
+static int write_all(int fd, const char* data, size_t length) {
+    while (length > 0) {
+        ssize_t written = write(fd, data, length);
+        if (written <= 0) return -1;
+        data += written;
+        length -= (size_t)written;
+    }
+    return 0;
+}
+
+static void* connection_main(void* userp) {
+    Connection* connection = (Connection*)userp;
+    BenchServer* server = connection->server;
+    char request[8192];
+    size_t used = 0;
+
+    for (;;) {
+        ssize_t got = read(connection->fd, request + used, sizeof(request) - 1 - used);
+        if (got <= 0) break;
+        used += (size_t)got;
+        request[used] = '\0';
+
+        // Answer each complete request; only a POST (the login) has a body after its head
+        char* end;
+        while ((end = strstr(request, "\r\n\r\n"))) {
+            char* length_line = strcasestr(request, "\r\nContent-Length:");
+            size_t body_length = length_line && length_line < end ? strtoul(length_line + 17, NULL, 10) : 0;
+            size_t consumed = (size_t)(end + 4 - request) + body_length;
+            if (consumed > used) break;
+
+            char head[160];
+            int head_length = snprintf(head, sizeof(head),
+                                       "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\n"
+                                       "Content-Length: %zu\r\n\r\n", server->body_length);
+            if (write_all(connection->fd, head, (size_t)head_length) != 0 ||
+                write_all(connection->fd, server->body, server->body_length) != 0) {
+                goto done;
+            }
+            memmove(request, request + consumed, used - consumed + 1);
+            used -= consumed;
+        }
+        if (used == sizeof(request) - 1) break;
+    }
+
+done:
+    close(connection->fd);
+    free(connection);
+    return NULL;
+}
+
+static void* accept_main(void* userp) {
+    BenchServer* server = (BenchServer*)userp;
+
+    for (;;) {
+        int fd = accept(server->listen_fd, NULL, NULL);
+        if (fd < 0) break;
+
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+        Connection* connection = malloc(sizeof(Connection));
+        pthread_t thread;
+        if (!connection) {
+            close(fd);
+            continue;
+        }
+        connection->server = server;
+        connection->fd = fd;
+        if (pthread_create(&thread, NULL, connection_main, connection) != 0) {
+            close(fd);
+            free(connection);
+            continue;
+        }
+        pthread_detach(thread);
+    }
+    return NULL;
+}
+
+BenchServer* bench_server_start(void) {
+    BenchServer* server = calloc(1, sizeof(struct BenchServer));
+    if (!server) return NULL;
+
+    struct sockaddr_in address;
+    socklen_t address_length = sizeof(address);
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = 0;  // Any free port
+
+    server->listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (server->listen_fd < 0 ||
+        bind(server->listen_fd, (struct sockaddr*)&address, sizeof(address)) != 0 ||
+        listen(server->listen_fd, 16) != 0 ||
+        getsockname(server->listen_fd, (struct sockaddr*)&address, &address_length) != 0) {
+        perror("Failed to start benchmark server");
+        if (server->listen_fd >= 0) close(server->listen_fd);
+        free(server);
+        return NULL;
+    }
+    snprintf(server->url, sizeof(server->url), "http://127.0.0.1:%d", ntohs(address.sin_port));
+
+    server->body = "";
+    if (pthread_create(&server->thread, NULL, accept_main, server) != 0) {
+        close(server->listen_fd);
+        free(server);
+        return NULL;
+    }
+    return server;
+}
+
+void bench_server_stop(BenchServer* server) {
+    if (!server) return;
+
+    // Wakes the blocked accept; connection threads end when the client hangs up
+    shutdown(server->listen_fd, SHUT_RDWR);
+    close(server->listen_fd);
+    pthread_join(server->thread, NULL);
+    free(server);
+}
+
+const char* bench_server_url(const BenchServer* server) {
+    return server->url;
+}
+
+void bench_server_set_body(BenchServer* server, const char* body, size_t length) {
+    server->body = body;
+    server->body_length = length;
+}
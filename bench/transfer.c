@@ -0,0 +1,184 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "bench.h"
+#include "mock_transport.h"
+#include "download.h"
+#include "hash.h"
+#include "platform.h"
+
+#define DOWNLOAD_PATH "/api/roms/1/content/game.bin"
+
+typedef struct {
+    HttpSession* session;
+    MockTransport* mock;
+    int count;
+    size_t size;
+    char destination[512];
+    char crc32[16];
+    char md5[40];
+    char sha1[48];
+    MockFaults faults;
+} TransferCase;
+
+// Platform list through the mock: decoding cost without sockets or a server thread
+static int platform_decode_mock_op(void* userp) {
+    TransferCase* c = (TransferCase*)userp;
+    Arena* arena = arena_create(0);
+    RomMPlatform* platforms = NULL;
+    int count = 0;
+
+    int result = fetch_platform_list(c->session, arena, &platforms, &count);
+    arena_release(arena);
+    return result == 0 && count == c->count ? 0 : -1;
+}
+
+static int download_matches(TransferCase* c) {
+    struct stat st;
+    return stat(c->destination, &st) == 0 && (size_t)st.st_size == c->size ? 0 : -1;
+}
+
+// Whole file: write callback, hashing, the partial file and the final rename
+static int download_op(void* userp) {
+    TransferCase* c = (TransferCase*)userp;
+    DownloadHashes hashes = { c->crc32, c->md5, c->sha1 };
+
+    unlink(c->destination);
+    mock_transport_set_faults(c->mock, &c->faults);
+    if (download_file(c->session, DOWNLOAD_PATH, c->destination, &hashes, NULL, NULL) != DOWNLOAD_OK) return -1;
+    return download_matches(c);
+}
+
+// Connection dropped halfway, then a second call resumes from the partial file
+static int download_resume_op(void* userp) {
+    TransferCase* c = (TransferCase*)userp;
+    DownloadHashes hashes = { c->crc32, c->md5, c->sha1 };
+
+    unlink(c->destination);
+    download_discard_partial(c->destination);
+    mock_transport_set_faults(c->mock, &c->faults);
+    if (download_file(c->session, DOWNLOAD_PATH, c->destination, &hashes, NULL, NULL) != DOWNLOAD_ERROR) return -1;
+    if (download_file(c->session, DOWNLOAD_PATH, c->destination, &hashes, NULL, NULL) != DOWNLOAD_OK) return -1;
+    return download_matches(c);
+}
+
+static void hex(const unsigned char* bytes, size_t length, char* out) {
+    for (size_t i = 0; i < length; i++) sprintf(out + i * 2, "%02x", bytes[i]);
+}
+
+// Serve a deterministic file of size bytes and record its digests
+static int add_download_fixture(TransferCase* c, size_t size) {
+    unsigned char* data = malloc(size);
+    if (!data) return -1;
+    for (size_t i = 0; i < size; i++) data[i] = (unsigned char)((i * 2654435761u) >> 13);
+
+    HashState state;
+    HashDigest digest;
+    hash_init(&state, HASH_CRC32 | HASH_MD5 | HASH_SHA1);
+    hash_update(&state, data, size);
+    hash_final(&state, &digest);
+    snprintf(c->crc32, sizeof(c->crc32), "%08x", (unsigned int)digest.crc32);
+    hex(digest.md5, sizeof(digest.md5), c->md5);
+    hex(digest.sha1, sizeof(digest.sha1), c->sha1);
+
+    c->size = size;
+    int result = mock_transport_add(c->mock, DOWNLOAD_PATH, 200, (const char*)data, size, NULL);
+    free(data);
+    return result;
+}
+
+// Wifi-like 2 MB/s link, once plain and once gzip-compressed: the inflate cost
+// against the transfer time it saves
+static void platform_decode_wifi(TransferCase* c) {
+    size_t length;
+    char* payload = bench_platforms_json(1000, &length);
+    if (!payload) return;
+
+    c->count = 1000;
+    mock_transport_add(c->mock, "/api/platforms", 200, payload, length, NULL);
+    free(payload);
+
+    memset(&c->faults, 0, sizeof(c->faults));
+    c->faults.drop_after = -1;
+    c->faults.bytes_per_sec = 2 << 20;
+    mock_transport_set_faults(c->mock, &c->faults);
+    bench_run("platform_decode_wifi", c->count, platform_decode_mock_op, c);
+    if (mock_transport_set_gzip(c->mock, true) == 0) {
+        bench_run("platform_decode_wifi_gzip", c->count, platform_decode_mock_op, c);
+    }
+
+    mock_transport_set_gzip(c->mock, false);
+    memset(&c->faults, 0, sizeof(c->faults));
+    c->faults.drop_after = -1;
+    mock_transport_set_faults(c->mock, &c->faults);
+}
+
+void bench_transfer_suite(void) {
+    static const int platform_counts[] = { 1000, 10000 };
+    static const size_t download_sizes[] = { 1 << 20, 16 << 20 };
+
+    if (!bench_selected("platform_decode_mock") && !bench_selected("platform_decode_wifi") &&
+        !bench_selected("download_")) {
+        return;
+    }
+
+    char dir[] = "/tmp/romm-bench-XXXXXX";
+    if (!mkdtemp(dir)) {
+        perror("Failed to create benchmark directory");
+        return;
+    }
+
+    TransferCase c;
+    memset(&c, 0, sizeof(c));
+    c.mock = mock_transport_create();
+    c.session = c.mock ? http_session_init_transport("http://romm.mock", "bench", "bench", mock_transport_base(c.mock)) : NULL;
+    if (c.mock) {
+        static const char token[] = "{\"access_token\": \"bench\", \"token_type\": \"bearer\", \"expires\": 1800}";
+        mock_transport_add(c.mock, "/api/token", 200, token, strlen(token), NULL);
+    }
+    if (!c.session) {
+        rmdir(dir);
+        return;
+    }
+    snprintf(c.destination, sizeof(c.destination), "%s/game.bin", dir);
+    c.faults.drop_after = -1;
+
+    for (size_t i = 0; i < sizeof(platform_counts) / sizeof(platform_counts[0]); i++) {
+        size_t length;
+        char* payload = bench_platforms_json(platform_counts[i], &length);
+        c.count = platform_counts[i];
+        mock_transport_add(c.mock, "/api/platforms", 200, payload, length, NULL);
+        free(payload);
+        bench_run("platform_decode_mock", c.count, platform_decode_mock_op, &c);
+    }
+
+    platform_decode_wifi(&c);
+
+    for (size_t i = 0; i < sizeof(download_sizes) / sizeof(download_sizes[0]); i++) {
+        if (add_download_fixture(&c, download_sizes[i]) != 0) break;
+
+        memset(&c.faults, 0, sizeof(c.faults));
+        c.faults.drop_after = -1;
+        bench_run("download_file", (long)c.size, download_op, &c);
+
+        c.faults.drop_after = (long long)c.size / 2;
+        c.faults.drop_count = 1;
+        bench_run("download_resume", (long)c.size, download_resume_op, &c);
+    }
+
+    // Bandwidth cap of 8 MB/s with 20 ms of latency: should take about 150 ms per MB
+    if (add_download_fixture(&c, 1 << 20) == 0) {
+        memset(&c.faults, 0, sizeof(c.faults));
+        c.faults.drop_after = -1;
+        c.faults.latency_ms = 20;
+        c.faults.bytes_per_sec = 8 << 20;
+        bench_run("download_throttled", (long)c.faults.bytes_per_sec, download_op, &c);
+    }
+
+    http_session_free(c.session);
+    unlink(c.destination);
+    download_discard_partial(c.destination);
+    rmdir(dir);
+}
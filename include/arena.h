@@ -0,0 +1,28 @@
+#ifndef ROMM_ARENA_H
+#define ROMM_ARENA_H
+
+#include <stdlib.h>
+
+#define ARENA_DEFAULT_CHUNK_SIZE 16384  // 16KB, about one page of ROM records
+
+// Opaque pointer to hide implementation details
+typedef struct Arena Arena;
+
+// Diagnostics of an arena's memory use
+typedef struct ArenaStats {
+    size_t allocations;      // arena_alloc calls served
+    size_t bytes_used;       // Bytes handed out, including alignment padding
+    size_t bytes_reserved;   // Bytes obtained from malloc
+    size_t chunks;
+} ArenaStats;
+
+// Bump allocator owning every record and string of one fetched list.
+// Individual allocations are never freed; arena_release drops them all at once.
+// An arena is not thread-safe, but may be handed from one thread to another.
+Arena* arena_create(size_t chunk_size);  // 0 selects ARENA_DEFAULT_CHUNK_SIZE
+void arena_release(Arena* arena);
+void* arena_alloc(Arena* arena, size_t size);        // 8-byte aligned, zeroed
+char* arena_strdup(Arena* arena, const char* text);  // NULL stays NULL
+void arena_stats(const Arena* arena, ArenaStats* stats);
+
+#endif // ROMM_ARENA_H
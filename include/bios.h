@@ -0,0 +1,21 @@
+#ifndef ROMM_BIOS_H
+#define ROMM_BIOS_H
+
+#include <stddef.h>
+#include "platform.h"
+#include "download_queue.h"
+
+// Onion OS looks up every emulator's BIOS files in this one folder
+#ifndef BIOS_ROOT
+#define BIOS_ROOT "/mnt/SDCARD/BIOS"
+#endif
+
+char* firmware_content_url(const RomMPlatformFirmware* firmware);
+void firmware_bios_path(const RomMPlatformFirmware* firmware, char* path, size_t path_size);
+
+// Queue every firmware file of a platform in one pass. Files already in BIOS_ROOT
+// with matching size and hashes are skipped by the download workers.
+// Returns the number of files queued, or -1 when any could not be queued.
+int bios_fetch_platform(DownloadQueue* queue, const RomMPlatform* platform);
+
+#endif // ROMM_BIOS_H
@@ -0,0 +1,65 @@
+#ifndef ROMM_CATALOG_H
+#define ROMM_CATALOG_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "http.h"
+#include "platform.h"
+#include "rom.h"
+
+#ifndef CATALOG_CACHE_DIR
+#define CATALOG_CACHE_DIR "/mnt/SDCARD/App/RomM/cache"
+#endif
+
+// Outcomes of catalog_fetch
+#define CATALOG_ERROR -1
+#define CATALOG_FRESH 0       // New body from the server
+#define CATALOG_UNCHANGED 1   // Server answered 304 Not Modified
+#define CATALOG_OFFLINE 2     // Server unreachable, cached catalog still valid
+
+// Record kinds of a catalog file
+#define CATALOG_KIND_PLATFORMS 1
+#define CATALOG_KIND_ROMS 2
+#define CATALOG_KIND_FIRMWARE 3
+
+// HTTP validators stored with a catalog
+typedef struct CatalogValidators {
+    char etag[128];
+    char last_modified[64];
+} CatalogValidators;
+
+// Opaque pointers to hide implementation details
+typedef struct CatalogFile CatalogFile;
+typedef struct CatalogWriter CatalogWriter;
+
+// Read side: the file is mmap'ed read-only and records are decoded in place.
+// Strings of decoded records point into the mapping and stay valid until
+// catalog_close; they must not be freed.
+CatalogFile* catalog_open(const char* name, uint32_t kind);
+void catalog_close(CatalogFile* catalog);
+int catalog_count(const CatalogFile* catalog);
+const char* catalog_stamp(const CatalogFile* catalog);
+const CatalogValidators* catalog_validators(const CatalogFile* catalog);
+void catalog_get_platform(const CatalogFile* catalog, int index, RomMPlatform* platform);
+void catalog_get_rom(const CatalogFile* catalog, int index, RomMRom* rom);
+int catalog_get_firmware(const CatalogFile* catalog, int index, RomMPlatformFirmware* firmware);  // Returns the platform id
+
+// Write side: records are spooled to a temporary file, strings deduplicated in
+// memory, and the finished catalog replaces the old one atomically on commit
+CatalogWriter* catalog_writer_init(const char* name, uint32_t kind);
+int catalog_writer_add_platform(CatalogWriter* writer, const RomMPlatform* platform);
+int catalog_writer_add_rom(CatalogWriter* writer, const RomMRom* rom);
+int catalog_writer_add_firmware(CatalogWriter* writer, int platform_id, const RomMPlatformFirmware* firmware);
+int catalog_writer_count(const CatalogWriter* writer);
+int catalog_writer_commit(CatalogWriter* writer, const char* stamp, const CatalogValidators* validators);
+void catalog_writer_abort(CatalogWriter* writer);
+
+// Conditional GET of an API path. validators (may be NULL) come from the cached
+// catalog; when the server never sent Last-Modified, modified_hint (an ISO 8601
+// updated_at) is used for If-Modified-Since. A fresh body is streamed to write_fn
+// and its validators returned in received.
+int catalog_fetch(HttpSession* session, const char* path, const CatalogValidators* validators,
+                  const char* modified_hint, http_write_fn write_fn, void* userp,
+                  CatalogValidators* received);
+
+#endif // ROMM_CATALOG_H
@@ -10,6 +10,19 @@
 int init_menu(MenuState* state);
 void cleanup_menu(MenuState* state);
 void render_platform_list(MenuState* state);
+void render_rom_list(MenuState* state);
+void render_rom_detail(MenuState* state);
+void render_search(MenuState* state);
+void open_rom_list(MenuState* state, int platform_index);
+void close_rom_list(MenuState* state);
+void open_rom_detail(MenuState* state);
+void close_rom_detail(MenuState* state);
+void enqueue_selected_rom(MenuState* state);
+void control_selected_download(MenuState* state, bool cancel);
+void open_search(MenuState* state);
+void close_search(MenuState* state, int rom_index);
+void fetch_selected_bios(MenuState* state);
+void apply_platform_list(MenuState* state, Arena* arena, RomMPlatform* platforms, int platform_count);
 void handle_input(MenuState* state, SDL_Event* event, bool* quit, bool* selected);
 int read_config(MenuState* state, const char* config_file);
 
@@ -0,0 +1,56 @@
+#ifndef ROMM_COVER_H
+#define ROMM_COVER_H
+
+#include <stdbool.h>
+#include "SDL/SDL.h"
+#include "http.h"
+#include "rom.h"
+#include "download_queue.h"
+
+#ifndef COVER_CACHE_DIR
+#define COVER_CACHE_DIR "/mnt/SDCARD/App/RomM/cache/covers"
+#endif
+
+#define COVER_LIST_SIZE 36      // Thumbnail box in the ROM list, in pixels
+#define COVER_DETAIL_SIZE 200   // Thumbnail box on the detail screen, in pixels
+#define COVER_MAX_WANTED 32     // Requests queued for the worker at once
+
+// Thumbnail variants, each scaled once and stored separately
+typedef enum {
+    COVER_LIST,
+    COVER_DETAIL
+} CoverSize;
+
+// Opaque pointer to hide implementation details
+typedef struct CoverStore CoverStore;
+
+// Invoked from the cover worker whenever a thumbnail is ready, must be thread-safe
+typedef void (*cover_notify_fn)(void* userp);
+
+// Pipeline steps, usable from any thread: SDL 1.2 video calls are not thread-safe,
+// so they only see a copy of the display's pixel format and make software surfaces.
+// cover_load_cached reads a stored thumbnail (one read, already in that format)
+// and returns NULL when there is none. cover_build downloads, decodes and
+// downscales the cover and stores the result; returns 0 or -1.
+bool rom_cover_available(const RomMRom* rom, CoverSize size);
+SDL_Surface* cover_load_cached(const RomMRom* rom, CoverSize size, const SDL_PixelFormat* format);
+int cover_build(HttpSession* session, const RomMRom* rom, CoverSize size, const SDL_PixelFormat* format);
+
+// Store keeping recently drawn thumbnails in memory, byte_budget caps their pixel
+// bytes. A low-priority worker loads and builds the thumbnails; covers that still
+// have to be downloaded wait while downloads has transfers running. Main thread,
+// once the video mode is set.
+CoverStore* cover_store_init(HttpSession* session, DownloadQueue* downloads, size_t byte_budget,
+                             cover_notify_fn notify, void* userp);
+void cover_store_free(CoverStore* store);
+
+// Main thread: declare the ROMs whose covers are wanted next, most urgent first.
+// Requests no longer in the list are dropped. Also takes in finished thumbnails,
+// so call it once per frame before drawing.
+void cover_store_set_window(CoverStore* store, const RomMRom* const* roms, int count, CoverSize size);
+
+// Main thread: thumbnail to blit this frame, NULL while it is not in memory.
+// Never blocks on I/O.
+SDL_Surface* cover_store_get(CoverStore* store, const RomMRom* rom, CoverSize size);
+
+#endif // ROMM_COVER_H
@@ -0,0 +1,55 @@
+#ifndef ROMM_DOWNLOAD_H
+#define ROMM_DOWNLOAD_H
+
+#include <stdbool.h>
+#include "http.h"
+
+// Return codes of download_file and download_archive
+#define DOWNLOAD_OK 0
+#define DOWNLOAD_ERROR -1
+#define DOWNLOAD_CANCELLED -2  // Stopped by the progress callback, partial file kept for resume
+#define DOWNLOAD_CORRUPT -3    // Content still did not match the expected hashes after a re-download
+
+// Snapshot of a running transfer
+typedef struct DownloadProgress {
+    unsigned long long bytes_done;   // Includes bytes resumed from an earlier attempt
+    unsigned long long bytes_total;  // 0 when the server did not send a length
+    double bytes_per_sec;            // Smoothed receive rate
+    int eta_seconds;                 // -1 when unknown
+} DownloadProgress;
+
+// Published digests of a file as hex strings, NULL or empty when unknown
+typedef struct DownloadHashes {
+    const char* crc32;
+    const char* md5;
+    const char* sha1;
+} DownloadHashes;
+
+// Called a few times per second and once on completion, return non-zero to cancel
+typedef int (*download_progress_fn)(const DownloadProgress* progress, void* userp);
+
+// Stream url to destination through "<destination>.part", resuming a previous partial file.
+// With expected hashes (may be NULL) every chunk is hashed on its way to disk and a
+// mismatch discards the file and downloads it again from zero.
+int download_file(HttpSession* session, const char* url, const char* destination,
+                  const DownloadHashes* expected, download_progress_fn on_progress, void* userp);
+
+// Stream a zip archive from url and extract its entries next to destination as
+// they arrive; the archive itself never touches the card. Expected hashes are
+// those of the archive, and extracted files replace existing ones only once it
+// verified. Nothing is resumed: a cancelled or failed download removes the
+// .part files it extracted, and later attempts start from zero.
+int download_archive(HttpSession* session, const char* url, const char* destination,
+                     const DownloadHashes* expected, download_progress_fn on_progress, void* userp);
+
+// Whether path already holds the expected file: same size (when size is non-zero)
+// and the same digests (when any are given). Reads the file only if the size matches.
+bool download_file_matches(const char* path, unsigned long long size, const DownloadHashes* expected);
+
+// Remove the partial file of destination and its saved hash state
+void download_discard_partial(const char* destination);
+
+// Create every missing directory above path, returns 0 or -1
+int make_parent_dirs(const char* path);
+
+#endif // ROMM_DOWNLOAD_H
@@ -0,0 +1,77 @@
+#ifndef ROMM_DOWNLOAD_QUEUE_H
+#define ROMM_DOWNLOAD_QUEUE_H
+
+#include <stdbool.h>
+#include "http.h"
+#include "rom.h"
+
+#define DOWNLOAD_QUEUE_DEFAULT_WORKERS 2
+#define DOWNLOAD_QUEUE_MAX_WORKERS 8
+
+typedef enum {
+    DOWNLOAD_ITEM_QUEUED,
+    DOWNLOAD_ITEM_ACTIVE,
+    DOWNLOAD_ITEM_PAUSED,
+    DOWNLOAD_ITEM_DONE,
+    DOWNLOAD_ITEM_FAILED,
+    DOWNLOAD_ITEM_CANCELLED
+} DownloadItemState;
+
+// One queued transfer. Progress fields are written by a worker with atomic stores
+// and may be read from the main loop at any time with download_item_* getters.
+typedef struct DownloadItem {
+    int id;
+    int rom_id;                       // -1 for files that are not ROMs
+    char* name;
+    char* url;
+    char* destination;
+    unsigned long long file_size;     // Expected size, 0 when unknown
+    char* crc_hash;                   // Expected digests, NULL when unknown
+    char* md5_hash;
+    char* sha1_hash;
+    bool extract;                     // Zip archive unpacked next to destination, which is never written
+    int state;                        // DownloadItemState
+    int control;                      // Pending pause/cancel request for an active item
+    unsigned long long bytes_done;
+    unsigned long long bytes_total;
+    unsigned int bytes_per_sec;
+    int eta_seconds;
+} DownloadItem;
+
+// Opaque pointer to hide implementation details
+typedef struct DownloadQueue DownloadQueue;
+
+// Invoked from worker threads whenever an item changes, must be thread-safe
+typedef void (*download_queue_notify_fn)(void* userp);
+
+// Queue lifecycle
+DownloadQueue* download_queue_init(HttpSession* session, int max_workers,
+                                   download_queue_notify_fn notify, void* userp);
+void download_queue_free(DownloadQueue* queue);
+
+// Returns the item id, or -1. A file already queued or downloading for the same
+// destination returns that item, and a worker finds a file already on the card
+// with the expected size and digests done without downloading it. The digests come
+// from detail, which may be NULL when the ROM was never opened. With extract set a
+// zip ROM is unpacked while it downloads and always fetched again.
+int download_queue_add(DownloadQueue* queue, const RomMRom* rom, const RomMRomDetail* detail, const char* destination,
+                       bool extract);
+int download_queue_add_file(DownloadQueue* queue, const char* name, const char* url, const char* destination,
+                            unsigned long long file_size, const DownloadHashes* hashes);
+
+// Operations, all return 0 on success or -1 (unknown item / invalid state)
+int download_queue_pause(DownloadQueue* queue, int item_id);
+int download_queue_resume(DownloadQueue* queue, int item_id);
+int download_queue_cancel(DownloadQueue* queue, int item_id);
+
+// Main-thread accessors, items stay valid until the queue is freed
+int download_queue_count(DownloadQueue* queue);
+const DownloadItem* download_queue_get(DownloadQueue* queue, int index);
+unsigned int download_queue_generation(DownloadQueue* queue);
+DownloadItemState download_item_state(const DownloadItem* item);
+void download_item_progress(const DownloadItem* item, DownloadProgress* progress);
+
+// Number of transfers running right now, safe to call from any thread
+int download_queue_active(DownloadQueue* queue);
+
+#endif // ROMM_DOWNLOAD_QUEUE_H
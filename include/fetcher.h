@@ -0,0 +1,28 @@
+#ifndef ROMM_FETCHER_H
+#define ROMM_FETCHER_H
+
+#include <stdbool.h>
+#include "http.h"
+#include "platform.h"
+
+// Opaque pointer to hide implementation details
+typedef struct Fetcher Fetcher;
+
+// Invoked from the worker thread when a result is ready, must be thread-safe
+typedef void (*fetcher_notify_fn)(void* userp);
+
+// Fetcher lifecycle, one background worker for catalog requests
+Fetcher* fetcher_init(HttpSession* session, fetcher_notify_fn notify, void* userp);
+void fetcher_free(Fetcher* fetcher);
+
+// Revalidate the platform list in the background. current is read by the worker
+// and must stay untouched until the result has been taken. Returns -1 when busy.
+int fetcher_refresh_platforms(Fetcher* fetcher, const RomMPlatform* current, int current_count);
+
+// Hand a finished refresh over to the main thread, once. result is a CATALOG_* code;
+// the list outputs are only set for CATALOG_FRESH and then owned by the caller,
+// who releases the arena holding the list.
+bool fetcher_take_platforms(Fetcher* fetcher, int* result, Arena** arena,
+                            RomMPlatform** platform_list, int* platform_count);
+
+#endif // ROMM_FETCHER_H
@@ -0,0 +1,33 @@
+#ifndef ROMM_FILE_WRITER_H
+#define ROMM_FILE_WRITER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#define FILE_WRITER_BUFFERS 4                   // Ring depth, bounds memory per open file
+#define FILE_WRITER_BUFFER_SIZE (512 * 1024)    // Bytes handed to the card per write
+
+// Opaque pointer to hide implementation details
+typedef struct FileWriter FileWriter;
+
+// Sequential file writer with its own thread. Data is copied into a ring of
+// page-aligned buffers and each full buffer is written in one call, so the
+// caller only waits on the card when every buffer is still queued. A write
+// error is sticky and reported once the next buffer is handed over, or on close.
+FileWriter* file_writer_open(const char* path, long long offset);  // Writes from offset on, truncating there
+
+// Returns 0, or -1 once a write failed
+int file_writer_write(FileWriter* writer, const void* data, size_t length);
+
+// Reserve blocks up to total_length bytes without changing the file size, done
+// by the writer thread before its next write. Best effort, ignored where unsupported.
+void file_writer_reserve(FileWriter* writer, long long total_length);
+
+// Wait for every queued byte, then cut the file to zero length and start over
+int file_writer_restart(FileWriter* writer);
+
+// Write what is left and close; with sync the data is on the card when it returns.
+// Returns 0, or -1 when any write failed.
+int file_writer_close(FileWriter* writer, bool sync);
+
+#endif // ROMM_FILE_WRITER_H
@@ -0,0 +1,52 @@
+#ifndef ROMM_HASH_H
+#define ROMM_HASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Digests computed by a HashState, combine with |
+#define HASH_CRC32 0x1
+#define HASH_MD5   0x2
+#define HASH_SHA1  0x4
+
+typedef struct {
+    uint32_t state[4];
+    uint64_t length;
+    unsigned char block[64];
+} Md5State;
+
+typedef struct {
+    uint32_t state[5];
+    uint64_t length;
+    unsigned char block[64];
+} Sha1State;
+
+// Incremental CRC32/MD5/SHA1 over one stream. Plain data, so a partial state can
+// be written to disk and picked up again when a download resumes.
+typedef struct {
+    unsigned int flags;
+    uint64_t length;           // Bytes hashed so far
+    uint32_t crc32;
+    Md5State md5;
+    Sha1State sha1;
+} HashState;
+
+typedef struct {
+    uint32_t crc32;
+    unsigned char md5[16];
+    unsigned char sha1[20];
+} HashDigest;
+
+void hash_init(HashState* state, unsigned int flags);
+void hash_update(HashState* state, const void* data, size_t length);
+void hash_final(const HashState* state, HashDigest* digest);
+
+// Standalone CRC32 (IEEE, slicing-by-8), start with crc = 0
+uint32_t crc32_update(uint32_t crc, const void* data, size_t length);
+
+// Compare the digests selected by flags against hex strings (any case); NULL or
+// empty strings are skipped. Returns 0 when everything matches, -1 otherwise.
+int hash_verify(const HashDigest* digest, unsigned int flags,
+                const char* crc32_hex, const char* md5_hex, const char* sha1_hex);
+
+#endif // ROMM_HASH_H
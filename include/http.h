@@ -0,0 +1,57 @@
+#ifndef ROMM_HTTP_H
+#define ROMM_HTTP_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "response.h"
+
+// Opaque pointer to hide implementation details
+typedef struct HttpSession HttpSession;
+
+// Body sink, same contract as response_write_callback
+typedef size_t (*http_write_fn)(void* contents, size_t size, size_t nmemb, void* userp);
+
+// Receives each raw response header line, including the status line
+typedef size_t (*http_header_fn)(char* buffer, size_t size, size_t nitems, void* userp);
+
+// Transfer progress in bytes for the current request, return non-zero to abort it
+typedef int (*http_progress_fn)(void* userp, long long dltotal, long long dlnow);
+
+// Description of a single GET request made through a session
+typedef struct HttpRequest {
+    const char* path;          // Path below the server url ("/api/platforms") or an absolute url; other hosts get no credentials
+    const char** headers;      // Extra header lines, NULL terminated, may be NULL
+    long long range_start;     // Request bytes from this offset on when > 0
+    bool compressed;           // Offer gzip/deflate, write_fn still receives the plain body
+    http_write_fn write_fn;    // Defaults to response_write_callback when NULL
+    void* write_userp;
+    http_header_fn header_fn;  // Optional
+    void* header_userp;
+    http_progress_fn progress_fn;  // Optional
+    void* progress_userp;
+} HttpRequest;
+
+// Access and refresh tokens kept between runs, readable by the owner only
+#ifndef HTTP_TOKEN_FILE
+#define HTTP_TOKEN_FILE "/mnt/SDCARD/App/RomM/token.txt"
+#endif
+
+// Session lifecycle, one session is shared by every request the app makes. The
+// first request logs in for a token that every request then carries; it is
+// renewed before it expires or when the server refuses it. Servers without
+// token support get Basic auth, as does every request while a login fails.
+HttpSession* http_session_init(const char* server_url, const char* username, const char* password);
+void http_session_free(HttpSession* session);
+
+// Make every request in flight fail fast and refuse new ones, used when quitting
+void http_session_abort(HttpSession* session);
+
+// Operations, both return the HTTP status code or -1 on transport failure
+int http_request(HttpSession* session, const HttpRequest* request);
+int http_get(HttpSession* session, const char* path, Response* resp);
+
+// Helpers
+char* generate_authorization_header(const char* username, const char* password);
+char* http_escape(const char* text);
+
+#endif // ROMM_HTTP_H
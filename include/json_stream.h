@@ -0,0 +1,34 @@
+#ifndef ROMM_JSON_STREAM_H
+#define ROMM_JSON_STREAM_H
+
+#include <stddef.h>
+#include <json-c/json.h>
+#include "arena.h"
+
+// Opaque pointer to hide implementation details
+typedef struct JsonStream JsonStream;
+
+// Called once per completed array element, the element is released afterwards.
+// Return non-zero to abort the stream.
+typedef int (*json_element_fn)(struct json_object* element, void* userp);
+
+// array_key selects the array to split: NULL for a top-level array, or the name
+// of a top-level member such as "items" for paginated envelopes. An object
+// without that member is accepted and has no elements.
+JsonStream* json_stream_init(const char* array_key, json_element_fn on_element, void* userp);
+void json_stream_free(JsonStream* stream);
+
+// Feed raw body bytes as they arrive, returns 0 or -1 on malformed input / abort
+int json_stream_feed(JsonStream* stream, const char* data, size_t len);
+size_t json_stream_write_callback(void* contents, size_t size, size_t nmemb, void* userp);
+
+// Validate the end of the document and return the number of elements emitted, or -1.
+// When envelope is not NULL it receives the document with the split array left empty
+// (e.g. {"items": [], "total": 5000}), to be released with json_object_put.
+int json_stream_finish(JsonStream* stream, struct json_object** envelope);
+
+// Helpers copying fields of parsed elements into an arena, NULL when missing or null
+char* json_get_string_dup(Arena* arena, struct json_object* obj, const char* key);
+int* json_get_int_dup(Arena* arena, struct json_object* obj, const char* key);
+
+#endif // ROMM_JSON_STREAM_H
@@ -0,0 +1,41 @@
+#ifndef ROMM_LIBRARY_H
+#define ROMM_LIBRARY_H
+
+#include <stdbool.h>
+#include "platform.h"
+#include "rom.h"
+
+// Whether a ROM from the server is already on the SD card
+typedef enum {
+    LIBRARY_UNKNOWN,    // Folder not scanned yet
+    LIBRARY_MISSING,
+    LIBRARY_PRESENT,
+    LIBRARY_OUTDATED    // A file of that name exists but its size differs
+} LibraryStatus;
+
+// Opaque pointer to hide implementation details
+typedef struct LocalLibrary LocalLibrary;
+
+// Invoked from the scan thread when a scan finished, must be thread-safe
+typedef void (*library_notify_fn)(void* userp);
+
+// Loads the index persisted by the last scan, so lookups work before any scan
+LocalLibrary* library_init(library_notify_fn notify, void* userp);
+void library_free(LocalLibrary* library);
+
+// Rescan the ROM folders of platforms in the background. Only folders whose
+// mtime changed since the last scan are read again. A request made while a scan
+// runs starts once library_update collected that one. Returns 0, or -1 on failure.
+int library_scan(LocalLibrary* library, const RomMPlatform* platforms, int count);
+
+// Main thread: swap in a finished scan; returns true when the index changed
+bool library_update(LocalLibrary* library);
+
+// Main thread: hash lookups only, never touches the filesystem. A zip ROM also
+// counts as present when a file of the same name with another extension exists.
+LibraryStatus library_rom_status(LocalLibrary* library, const RomMPlatform* platform, const RomMRom* rom);
+
+// Main thread: record a file that just appeared, e.g. a finished download
+void library_note_file(LocalLibrary* library, const char* path);
+
+#endif // ROMM_LIBRARY_H
@@ -1,7 +1,27 @@
+#ifndef ROMM_MENU_STATE_H
+#define ROMM_MENU_STATE_H
+
 #include "SDL/SDL.h"
 #include "SDL/SDL_ttf.h"
 
 #include "platform.h"
+#include "download_queue.h"
+#include "rom_list.h"
+#include "rom_detail.h"
+#include "fetcher.h"
+#include "surface_cache.h"
+#include "cover.h"
+#include "search.h"
+#include "library.h"
+#include "trace.h"
+
+// Screen currently shown by the menu
+typedef enum {
+    VIEW_PLATFORMS,
+    VIEW_ROMS,
+    VIEW_ROM_DETAIL,   // Selected ROM of the list, with its fetched details
+    VIEW_SEARCH
+} MenuView;
 
 typedef struct {
     int display_width;
@@ -9,13 +29,52 @@ typedef struct {
     SDL_Surface* screen;
     SDL_Surface* renderer;
     TTF_Font* font;
+    int font_size;
+    SurfaceCache* text_cache;   // Rendered text reused across frames
+    CoverStore* covers;         // Cover thumbnails of the ROM list
+    Arena* platform_arena;      // Owns platforms and their strings
     RomMPlatform* platforms;
     int platform_count;
-    int selected_index;
+    MenuView view;
+    int selected_index;         // Cursor of the current view
     int scroll_offset;
+    int scroll_direction;       // -1 up, 1 down, 0 idle
+    RomList* roms;              // ROMs of the opened platform, from VIEW_ROMS on
+    int rom_platform_index;
+    int platform_selected_index;  // Platform cursor saved while browsing ROMs
+    int platform_scroll_offset;
+    RomDetailCache* details;    // Details of opened ROMs, fetched on demand
+    CatalogFile* search_catalog;  // Catalog of the open platform the index was built from
+    SearchIndex* search;        // Built on first search, kept while the ROM list is open
+    char search_query[SEARCH_MAX_QUERY];
+    int search_count;           // Matches of search_query
+    int search_key;             // On-screen keyboard cursor
+    bool search_in_results;     // D-pad moves through the matches instead of the keyboard
+    int search_selected;
+    int search_scroll;
+    int wake_pending;           // A worker's wake event is queued, see wake_main_loop
     int last_tick_count;
     int cur_tick_count;
     char* server_url;
     char* username;
     char* password;
+    HttpSession* session;
+    DownloadQueue* downloads;
+    Fetcher* fetcher;
+    LocalLibrary* library;      // Which ROMs are already on the SD card
+    unsigned int library_generation;  // Download queue generation last checked for finished files
+    int library_done_count;     // Finished downloads already noted in the library
+    bool offline;               // Showing the cached catalog, server unreachable
+    bool loading;               // First platform list on its way, nothing cached to show
+    bool load_failed;           // First platform list could not be fetched, A retries
+    char notice[96];            // One-off status line message, cleared by the next key
+    bool select_held;           // Select is down, for button combos
+    bool show_stats;            // Performance overlay, toggled with Select + R1
+    uint64_t frame_start;       // trace_now_us() when the frame being drawn began
+    char trace_file[256];       // Spans are dumped here when set in the config
+    int download_workers;
+    bool extract_zip;           // Unpack zip ROMs while they download, except for arcade folders
+    bool skip_verify;           // Queue ROMs whose digests could not be fetched, unverified
 } MenuState;
+
+#endif /* ROMM_MENU_STATE_H */
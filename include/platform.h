@@ -3,7 +3,9 @@
 
 #include <json-c/json.h>
 #include <stdbool.h>
+#include "arena.h"
 #include "rom.h"
+#include "http.h"
 
 // Structure to hold firmware information
 typedef struct RomMPlatformFirmware {
@@ -40,13 +42,26 @@ typedef struct RomMPlatform {
     char* updated_at;           // ISO 8601 datetime string
 } RomMPlatform;
 
-// Function declarations for memory management
-void free_platform(RomMPlatform* platform);
-void free_firmware(RomMPlatformFirmware* firmware);
-void free_platform_list(RomMPlatform* platforms, int count);
+// Root of the Onion ROM folders on the SD card
+#ifndef ROMS_ROOT
+#define ROMS_ROOT "/mnt/SDCARD/Roms"
+#endif
 
-// Function declarations for operations
-char* generate_authorization_header(const char* username, const char* password);
-int fetch_platform_list(const char* server_url, const char* username, const char* password, RomMPlatform** platform_list, int* platform_count);
+// Receives each platform as soon as it is parsed; its strings live in the arena
+// given to fetch_platform_list_stream. Return non-zero to abort the transfer.
+typedef int (*platform_fn)(const RomMPlatform* platform, void* userp);
+
+// Function declarations for operations. Lists, records and strings are allocated
+// in the caller's arena and released together with it.
+int fetch_platform_list_stream(HttpSession* session, Arena* arena, platform_fn on_platform, void* userp);
+const char* platform_rom_folder(const RomMPlatform* platform);  // NULL when not a single path component
+bool platform_keeps_archives(const RomMPlatform* platform);
+// Destination of a ROM on the card, -1 when the folder or file name would leave ROMS_ROOT
+int platform_rom_path(const RomMPlatform* platform, const char* file_name, char* path, size_t path_size);
+int fetch_platform_list(HttpSession* session, Arena* arena, RomMPlatform** platform_list, int* platform_count);
+int load_platform_list_cache(Arena* arena, RomMPlatform** platform_list, int* platform_count);
+int refresh_platform_list(HttpSession* session, const RomMPlatform* current, int current_count,
+                          Arena* arena, RomMPlatform** platform_list, int* platform_count);
+const char* platform_list_newest_update(const RomMPlatform* platforms, int count);
 
 #endif // ROMM_PLATFORM_H
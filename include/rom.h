@@ -2,43 +2,78 @@
 #define ROMM_ROM_H
 
 #include <stdbool.h>
+#include "arena.h"
+#include "http.h"
+#include "download.h"
 
-// Structure to hold ROM information
+// List record of a ROM: only what a row of the ROM list, search and the local
+// library need. The list is requested with just these fields.
 typedef struct RomMRom {
     int id;
-    int* igdb_id;              // Nullable
-    int* sgdb_id;             // object type
-    int* moby_id;             // object type
     int platform_id;
-    char* platform_slug;
-    char* platform_name;
+    char* name;
     char* file_name;
     char* file_name_no_tags;
+    unsigned long long file_size_bytes;
+    char* path_cover_s;        // Large enough for both thumbnail sizes
+    bool has_cover;
+    bool multi;
+} RomMRom;
+
+// One file of a multi-file ROM
+typedef struct RomMRomFile {
+    char* file_name;
+    unsigned long long file_size_bytes;
+} RomMRomFile;
+
+// Heavy fields of one ROM, fetched when the ROM is opened. Strings live in arena.
+typedef struct RomMRomDetail {
+    Arena* arena;
+    int id;
+    int* igdb_id;              // Nullable
+    int* sgdb_id;
+    int* moby_id;
+    char* platform_slug;
+    char* platform_name;
     char* file_name_no_ext;
     char* file_extension;
     char* file_path;
-    unsigned long long file_size_bytes;
-    char* name;
+    char* full_path;
+    char* crc_hash;            // Published digests of the file, nullable
+    char* md5_hash;
+    char* sha1_hash;
     char* slug;
     char* summary;
-    int* first_release_date;    // Nullable
-    char* path_cover_s;
+    int* first_release_date;   // Nullable, seconds since the epoch
     char* path_cover_l;
-    bool has_cover;
     char* url_cover;
     char* revision;
-    bool multi;
-    void** files;              // Array of object pointers
+    RomMRomFile* files;
     int files_count;
-    char* full_path;
     char* created_at;          // ISO 8601 datetime string
-    char* updated_at;          // ISO 8601 datetime string
-} RomMRom;
+    char* updated_at;
+} RomMRomDetail;
+
+// One page of a platform's ROM list, records and strings live in its arena
+typedef struct RomMRomPage {
+    Arena* arena;
+    RomMRom* roms;
+    int count;                 // Records in this page
+    int offset;                // Index of the first record in the full list
+    int total;                 // Size of the full list reported by the server
+} RomMRomPage;
 
 // Function declarations for memory management
-void free_rom(RomMRom* rom);
+void free_rom_page(RomMRomPage* page);
+void free_rom_detail(RomMRomDetail* detail);
 
 // Function declarations for operations
-int download_rom(const char* url, const char* destination);
+int fetch_rom_page(HttpSession* session, int platform_id, int offset, int limit, RomMRomPage* page);
+int fetch_rom_detail(HttpSession* session, int rom_id, RomMRomDetail* detail);
+char* rom_content_url(const RomMRom* rom);
+void rom_hashes(const RomMRom* rom, const RomMRomDetail* detail, DownloadHashes* hashes);  // detail may be NULL
+bool rom_is_zip(const RomMRom* rom);
+int download_rom(HttpSession* session, const RomMRom* rom, const RomMRomDetail* detail, const char* destination,
+                 bool extract, download_progress_fn on_progress, void* userp);
 
 #endif /* ROMM_ROM_H */
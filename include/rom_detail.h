@@ -0,0 +1,30 @@
+#ifndef ROMM_ROM_DETAIL_H
+#define ROMM_ROM_DETAIL_H
+
+#include <stdbool.h>
+#include "http.h"
+#include "rom.h"
+
+#define ROM_DETAIL_CACHE_SIZE 16   // Details of recently opened ROMs kept in memory
+
+// Opaque pointer to hide implementation details
+typedef struct RomDetailCache RomDetailCache;
+
+// Invoked from the detail worker when a fetch finished, must be thread-safe
+typedef void (*rom_detail_notify_fn)(void* userp);
+
+// Cache lifecycle, one background worker fetching the most recently asked for ROM
+RomDetailCache* rom_detail_cache_init(HttpSession* session, rom_detail_notify_fn notify, void* userp);
+void rom_detail_cache_free(RomDetailCache* cache);
+
+// Main thread: detail of rom_id, or NULL while it is fetched. A missing detail is
+// requested, replacing an older request that has not started. The result stays
+// valid until the next call, which may evict it.
+const RomMRomDetail* rom_detail_cache_get(RomDetailCache* cache, int rom_id);
+
+// Main thread: the last fetch of rom_id failed. Failed ROMs are not requested
+// again until retry is called for them.
+bool rom_detail_cache_failed(RomDetailCache* cache, int rom_id);
+void rom_detail_cache_retry(RomDetailCache* cache, int rom_id);
+
+#endif // ROMM_ROM_DETAIL_H
@@ -0,0 +1,39 @@
+#ifndef ROMM_ROM_LIST_H
+#define ROMM_ROM_LIST_H
+
+#include "http.h"
+#include "rom.h"
+#include "catalog.h"
+
+#define ROM_LIST_PAGE_SIZE 50
+#define ROM_LIST_PREFETCH_PAGES 1   // Pages fetched ahead of the window in the scroll direction
+#define ROM_LIST_KEEP_PAGES 4       // Loaded pages kept on each side of the window
+
+// Opaque pointer to hide implementation details
+typedef struct RomList RomList;
+
+// Invoked from the fetch thread whenever a page lands, must be thread-safe
+typedef void (*rom_list_notify_fn)(void* userp);
+
+// List lifecycle, expected_count seeds the size until the server reports its total.
+// When the local catalog was written for the same updated_at the list is served
+// from it; otherwise pages come from the server and, once the UI is idle, the
+// whole list is copied into a new catalog for next time.
+RomList* rom_list_init(HttpSession* session, int platform_id, int expected_count, const char* updated_at,
+                       rom_list_notify_fn notify, void* userp);
+void rom_list_free(RomList* list);
+
+// Local catalog of a platform's ROMs, or NULL unless it was written for the same
+// updated_at and holds expected_count records. Same order as the list.
+CatalogFile* rom_catalog_open(int platform_id, int expected_count, const char* updated_at);
+
+// Main-thread accessors
+int rom_list_count(RomList* list);
+const RomMRom* rom_list_get(RomList* list, int index);  // NULL while its page is loading
+bool rom_list_failed(RomList* list);                    // Last page request failed
+
+// Declare the visible window, scheduling missing pages and evicting far ones.
+// direction is -1 when scrolling up, 1 when scrolling down, 0 otherwise.
+void rom_list_set_window(RomList* list, int first_visible, int visible_count, int direction);
+
+#endif // ROMM_ROM_LIST_H
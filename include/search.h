@@ -0,0 +1,24 @@
+#ifndef ROMM_SEARCH_H
+#define ROMM_SEARCH_H
+
+#include "catalog.h"
+
+#define SEARCH_MAX_QUERY 64
+
+// Opaque pointer to hide implementation details
+typedef struct SearchIndex SearchIndex;
+
+// Build a trigram index over the normalized name and file_name_no_tags of every
+// ROM in a catalog. The catalog must stay open while the index is in use.
+SearchIndex* search_index_build(const CatalogFile* catalog);
+void search_index_free(SearchIndex* index);
+
+// Run a query and return the number of matches. Queries are normalized like the
+// index (case-insensitive, punctuation ignored). Typing or deleting characters
+// narrows or restores the previous result set instead of searching again.
+int search_index_query(SearchIndex* index, const char* text);
+
+// Catalog record of the i-th match of the last query, in catalog order
+int search_index_result(const SearchIndex* index, int i);
+
+#endif // ROMM_SEARCH_H
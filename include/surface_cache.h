@@ -0,0 +1,36 @@
+#ifndef ROMM_SURFACE_CACHE_H
+#define ROMM_SURFACE_CACHE_H
+
+#include <stddef.h>
+#include "SDL/SDL.h"
+
+// Opaque pointer to hide implementation details
+typedef struct SurfaceCache SurfaceCache;
+
+// Diagnostics of a cache's effectiveness
+typedef struct SurfaceCacheStats {
+    size_t entries;
+    size_t bytes;            // Pixel bytes held
+    size_t hits;
+    size_t misses;
+    size_t evictions;
+} SurfaceCacheStats;
+
+// Cache lifecycle. Surfaces are kept least recently used first out once the
+// pixel bytes they hold exceed byte_budget. Main thread only.
+SurfaceCache* surface_cache_init(size_t byte_budget);
+void surface_cache_free(SurfaceCache* cache);
+
+// Surface stored under key, or NULL. The surface stays owned by the cache and
+// valid until the next surface_cache_put.
+SDL_Surface* surface_cache_get(SurfaceCache* cache, const char* key);
+
+// Store a surface under key, taking ownership of it (it is freed right away if it
+// cannot be stored). A surface larger than the whole budget is still kept until
+// the next put, so the caller can draw it this frame.
+void surface_cache_put(SurfaceCache* cache, const char* key, SDL_Surface* surface);
+
+void surface_cache_clear(SurfaceCache* cache);
+void surface_cache_stats(const SurfaceCache* cache, SurfaceCacheStats* stats);
+
+#endif // ROMM_SURFACE_CACHE_H
@@ -0,0 +1,58 @@
+#ifndef ROMM_TRACE_H
+#define ROMM_TRACE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// What a span measured
+typedef enum {
+    TRACE_HTTP_REQUEST,    // Whole request, as seen by the caller
+    TRACE_HTTP_DNS,        // Name lookup
+    TRACE_HTTP_CONNECT,    // TCP and TLS handshakes
+    TRACE_HTTP_TTFB,       // Request sent until the first response byte
+    TRACE_HTTP_TRANSFER,   // First to last response byte, bytes = body size
+    TRACE_JSON_DECODE,     // Time spent splitting and parsing one streamed document
+    TRACE_FRAME,           // Whole frame
+    TRACE_FRAME_BUILD,     // Drawing the frame onto the renderer surface
+    TRACE_FRAME_BLIT,      // Renderer surface to screen
+    TRACE_FRAME_FLIP,
+    TRACE_DISK_WRITE,      // One buffer written to the card by a file writer, bytes = its size
+    TRACE_DISK_WAIT,       // Receiver blocked because every write buffer was still queued
+    TRACE_KIND_COUNT
+} TraceKind;
+
+// One finished span; timestamps in microseconds of a monotonic clock
+typedef struct TraceSpan {
+    uint64_t start_us;
+    uint32_t duration_us;
+    uint16_t kind;         // TraceKind
+    uint16_t thread;       // Small per-thread number, in order of first use
+    uint64_t bytes;        // Payload size where it applies, else 0
+} TraceSpan;
+
+// Summary of the recent spans of one kind
+typedef struct TraceStats {
+    int count;
+    uint32_t p50_us;
+    uint32_t p99_us;
+    uint32_t max_us;
+    uint64_t bytes;
+} TraceStats;
+
+// Recording is lock-free and safe from any thread. Spans go to a fixed-size
+// ring; the oldest are overwritten once it is full.
+uint64_t trace_now_us(void);
+void trace_span(TraceKind kind, uint64_t start_us, uint64_t end_us, uint64_t bytes);
+const char* trace_kind_name(TraceKind kind);
+
+// Spans of kind that started at or after since_us still held by the ring
+void trace_stats(TraceKind kind, uint64_t since_us, TraceStats* stats);
+
+// Write every span from now on to path in Chrome's trace event format (load it in
+// chrome://tracing or Perfetto). Flush regularly from one thread so the ring does
+// not wrap in between; spans lost to wrapping are counted in the file.
+int trace_dump_open(const char* path);
+void trace_dump_flush(void);
+void trace_dump_close(void);
+
+#endif // ROMM_TRACE_H
@@ -0,0 +1,44 @@
+#ifndef ROMM_TRANSPORT_H
+#define ROMM_TRANSPORT_H
+
+#include "http.h"
+
+// One GET (or a POST, when body is set) as a session hands it to its transport. The transport delivers the
+// header lines (status line first) to header_fn and the body to write_fn, and
+// calls progress_fn regularly, also while connecting or stalled; a non-zero
+// return from any callback ends the transfer as a failure.
+typedef struct HttpTransfer {
+    const char* url;             // Absolute
+    const char** headers;        // Complete header lines (Authorization, Range, ...), NULL terminated
+    const char* body;            // POST body, its Content-Type among headers; NULL for a GET
+    size_t body_length;
+    http_write_fn write_fn;
+    void* write_userp;
+    http_header_fn header_fn;    // May be NULL
+    void* header_userp;
+    http_progress_fn progress_fn;
+    void* progress_userp;
+} HttpTransfer;
+
+typedef struct HttpTransport HttpTransport;
+
+typedef struct HttpTransportOps {
+    // Run one transfer to completion. Returns the HTTP status, or -1 when the
+    // transfer failed or was aborted. Called from any thread, concurrently.
+    int (*perform)(HttpTransport* transport, const HttpTransfer* transfer);
+    void (*destroy)(HttpTransport* transport);
+} HttpTransportOps;
+
+// Implementations embed this as their first member
+struct HttpTransport {
+    const HttpTransportOps* ops;
+};
+
+// The libcurl transport every session uses on the device
+HttpTransport* curl_transport_create(void);
+
+// Session over any transport, which it owns from then on (also on failure)
+HttpSession* http_session_init_transport(const char* server_url, const char* username, const char* password,
+                                         HttpTransport* transport);
+
+#endif // ROMM_TRANSPORT_H
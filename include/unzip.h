@@ -0,0 +1,32 @@
+#ifndef ROMM_UNZIP_H
+#define ROMM_UNZIP_H
+
+#include <stddef.h>
+
+// Opaque pointer to hide implementation details
+typedef struct ZipExtractor ZipExtractor;
+
+// Streaming zip extractor: bytes are fed in arrival order and every entry is
+// inflated straight into <directory>/<entry name> while the archive downloads.
+// Only the local headers are read, so the archive is never stored. Handles
+// stored and deflated entries, data descriptors and zip64 sizes. Each entry is
+// checked against its CRC32 and kept as <name>.part; existing files are only
+// replaced by zip_extractor_commit, once the caller verified the whole archive.
+ZipExtractor* zip_extractor_init(const char* directory);
+void zip_extractor_free(ZipExtractor* extractor);
+
+// Returns 0, or -1 on a malformed or unsupported archive or a write error
+int zip_extractor_feed(ZipExtractor* extractor, const void* data, size_t length);
+
+// 0 when the archive ended cleanly after its last entry, -1 when it was cut short
+int zip_extractor_finish(ZipExtractor* extractor);
+
+// Move every extracted entry into place, after zip_extractor_finish succeeded.
+// Returns 0, or -1 when an entry could not be moved.
+int zip_extractor_commit(ZipExtractor* extractor);
+
+// Remove every .part file this extractor wrote, used when the download fails.
+// Files already on the card are left alone.
+void zip_extractor_discard(ZipExtractor* extractor);
+
+#endif // ROMM_UNZIP_H
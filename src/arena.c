@@ -0,0 +1,128 @@
+#include "arena.h"
+#include <string.h>
+
+#define ARENA_ALIGNMENT 8
+
+typedef struct ArenaChunk {
+    struct ArenaChunk* next;
+    size_t size;      // Usable bytes after the header
+    size_t used;
+} ArenaChunk;
+
+struct Arena {
+    ArenaChunk* chunks;   // Current chunk first
+    size_t chunk_size;
+    size_t allocations;
+    size_t bytes_used;
+    size_t bytes_reserved;
+    size_t chunk_count;
+};
+
+// Chunk headers are padded so the data behind them stays aligned
+#define CHUNK_HEADER_SIZE ((sizeof(ArenaChunk) + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1))
+
+static unsigned char* chunk_data(ArenaChunk* chunk) {
+    return (unsigned char*)chunk + CHUNK_HEADER_SIZE;
+}
+
+Arena* arena_create(size_t chunk_size) {
+    Arena* arena = calloc(1, sizeof(struct Arena));
+    if (!arena) return NULL;
+
+    arena->chunk_size = chunk_size ? chunk_size : ARENA_DEFAULT_CHUNK_SIZE;
+    return arena;
+}
+
+void arena_release(Arena* arena) {
+    if (!arena) return;
+
+    ArenaChunk* chunk = arena->chunks;
+    while (chunk) {
+        ArenaChunk* next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+    free(arena);
+}
+
+static ArenaChunk* add_chunk(Arena* arena, size_t size) {
+    ArenaChunk* chunk = malloc(CHUNK_HEADER_SIZE + size);
+    if (!chunk) return NULL;
+
+    chunk->size = size;
+    chunk->used = 0;
+    arena->bytes_reserved += CHUNK_HEADER_SIZE + size;
+    arena->chunk_count++;
+    return chunk;
+}
+
+static size_t align_up(size_t value, size_t alignment) {
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+// Carve size bytes at the given alignment out of the current chunk, adding chunks as needed
+static void* arena_push(Arena* arena, size_t size, size_t alignment) {
+    if (!arena) return NULL;
+    if (size == 0) size = 1;
+
+    ArenaChunk* chunk = arena->chunks;
+    size_t offset = chunk ? align_up(chunk->used, alignment) : 0;
+
+    if (!chunk || offset > chunk->size || chunk->size - offset < size) {
+        if (size > arena->chunk_size / 4) {
+            // Large blocks get a chunk of their own, queued behind the current one
+            // so its free space is not abandoned
+            ArenaChunk* own = add_chunk(arena, size);
+            if (!own) return NULL;
+            own->used = size;
+            if (chunk) {
+                own->next = chunk->next;
+                chunk->next = own;
+            } else {
+                own->next = NULL;
+                arena->chunks = own;
+            }
+            arena->allocations++;
+            arena->bytes_used += size;
+            return chunk_data(own);
+        }
+
+        chunk = add_chunk(arena, arena->chunk_size);
+        if (!chunk) return NULL;
+        chunk->next = arena->chunks;
+        arena->chunks = chunk;
+        offset = 0;
+    }
+
+    void* memory = chunk_data(chunk) + offset;
+    arena->allocations++;
+    arena->bytes_used += offset + size - chunk->used;
+    chunk->used = offset + size;
+    return memory;
+}
+
+void* arena_alloc(Arena* arena, size_t size) {
+    void* memory = arena_push(arena, size, ARENA_ALIGNMENT);
+    if (memory) memset(memory, 0, size);
+    return memory;
+}
+
+char* arena_strdup(Arena* arena, const char* text) {
+    if (!text) return NULL;
+
+    // Strings need no alignment, so they pack back to back
+    size_t length = strlen(text) + 1;
+    char* copy = arena_push(arena, length, 1);
+    if (copy) memcpy(copy, text, length);
+    return copy;
+}
+
+void arena_stats(const Arena* arena, ArenaStats* stats) {
+    memset(stats, 0, sizeof(ArenaStats));
+    if (!arena) return;
+
+    stats->allocations = arena->allocations;
+    stats->bytes_used = arena->bytes_used;
+    stats->bytes_reserved = arena->bytes_reserved;
+    stats->chunks = arena->chunk_count;
+}
@@ -0,0 +1,53 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include "bios.h"
+
+char* firmware_content_url(const RomMPlatformFirmware* firmware) {
+    if (!firmware || !firmware->file_name) return NULL;
+
+    char* escaped_name = http_escape(firmware->file_name);
+    if (!escaped_name) return NULL;
+
+    size_t len = strlen(escaped_name) + 64;
+    char* url = malloc(len);
+    if (url) {
+        snprintf(url, len, "/api/firmware/%d/content/%s", firmware->id, escaped_name);
+    }
+    free(escaped_name);
+    return url;
+}
+
+void firmware_bios_path(const RomMPlatformFirmware* firmware, char* path, size_t path_size) {
+    snprintf(path, path_size, "%s/%s", BIOS_ROOT, firmware->file_name);
+}
+
+int bios_fetch_platform(DownloadQueue* queue, const RomMPlatform* platform) {
+    int queued = 0;
+    int result = 0;
+
+    for (int i = 0; i < platform->firmware_count; i++) {
+        const RomMPlatformFirmware* firmware = platform->firmware[i];
+
+        // The name becomes a path on the card, never let it leave the BIOS folder
+        if (!firmware->file_name || strchr(firmware->file_name, '/') || strcmp(firmware->file_name, "..") == 0) {
+            continue;
+        }
+
+        char* url = firmware_content_url(firmware);
+        char destination[1024];
+        firmware_bios_path(firmware, destination, sizeof(destination));
+        DownloadHashes hashes = { firmware->crc_hash, firmware->md5_hash, firmware->sha1_hash };
+
+        if (!url || download_queue_add_file(queue, firmware->file_name, url, destination,
+                                            firmware->file_size_bytes > 0 ? firmware->file_size_bytes : 0,
+                                            &hashes) < 0) {
+            fprintf(stderr, "Failed to queue firmware %s\n", firmware->file_name);
+            result = -1;
+        } else {
+            queued++;
+        }
+        free(url);
+    }
+    return result < 0 ? -1 : queued;
+}
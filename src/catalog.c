@@ -0,0 +1,626 @@
+#define _GNU_SOURCE  // timegm
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "catalog.h"
+
+/*
+ * Catalog file layout (native byte order, the file never leaves the device):
+ *
+ *   CatalogHeader
+ *   record array     record_count * record_size bytes, fixed-size records
+ *   string table     strings_size bytes of NUL-terminated, deduplicated strings
+ *
+ * Records refer to strings by offset into the string table; offset 0 is an
+ * empty string reserved to mean NULL.
+ */
+
+#define CATALOG_MAGIC "RMCT"
+#define CATALOG_VERSION 3
+#define CATALOG_COPY_CHUNK 65536
+#define CATALOG_STRING_BUCKETS_MIN 1024
+#define CATALOG_STRINGS_INITIAL 65536   // String table bytes, doubled as needed
+
+// Bits of CatalogRomRecord.flags
+#define ROM_FLAG_HAS_COVER (1u << 0)
+#define ROM_FLAG_MULTI (1u << 1)
+
+// Bits of CatalogFirmwareRecord.flags
+#define FIRMWARE_FLAG_VERIFIED (1u << 0)
+
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    uint32_t kind;
+    uint32_t record_count;
+    uint32_t record_size;
+    uint32_t records_offset;
+    uint32_t strings_offset;
+    uint32_t strings_size;
+    char stamp[64];                // Freshness marker chosen by the writer (e.g. platform updated_at)
+    CatalogValidators validators;
+} CatalogHeader;
+
+typedef struct {
+    int32_t id;
+    int32_t igdb_id;
+    int32_t sgdb_id;
+    int32_t moby_id;
+    int32_t rom_count;
+    uint32_t slug;
+    uint32_t fs_slug;
+    uint32_t name;
+    uint32_t logo_path;
+    uint32_t created_at;
+    uint32_t updated_at;
+} CatalogPlatformRecord;
+
+typedef struct {
+    int32_t id;
+    int32_t platform_id;
+    uint64_t file_size_bytes;
+    uint32_t flags;
+    uint32_t name;
+    uint32_t file_name;
+    uint32_t file_name_no_tags;
+    uint32_t path_cover_s;
+} CatalogRomRecord;
+
+typedef struct {
+    int32_t id;
+    int32_t platform_id;
+    uint64_t file_size_bytes;
+    uint32_t flags;
+    uint32_t file_name;
+    uint32_t file_name_no_tags;
+    uint32_t file_name_no_ext;
+    uint32_t file_extension;
+    uint32_t file_path;
+    uint32_t full_path;
+    uint32_t crc_hash;
+    uint32_t md5_hash;
+    uint32_t sha1_hash;
+    uint32_t created_at;
+    uint32_t updated_at;
+} CatalogFirmwareRecord;
+
+struct CatalogFile {
+    void* map;
+    size_t map_size;
+    const CatalogHeader* header;
+    const unsigned char* records;
+    const char* strings;
+};
+
+// Deduplication slot: hash and length pick candidates, the bytes in the table decide
+typedef struct {
+    uint64_t hash;
+    uint32_t length;
+    uint32_t offset;   // 0 marks an empty slot
+} StringSlot;
+
+struct CatalogWriter {
+    char name[128];
+    uint32_t kind;
+    FILE* records;
+    char* strings;               // String table built in memory, compared against when interning
+    uint32_t strings_capacity;
+    uint32_t record_count;
+    uint32_t strings_size;
+    StringSlot* slots;
+    uint32_t slot_count;
+    uint32_t slot_used;
+    bool failed;
+};
+
+static void catalog_path(const char* name, const char* extension, char* path, size_t path_size) {
+    snprintf(path, path_size, "%s/%s.%s", CATALOG_CACHE_DIR, name, extension);
+}
+
+static uint32_t record_size_of(uint32_t kind) {
+    switch (kind) {
+        case CATALOG_KIND_PLATFORMS: return sizeof(CatalogPlatformRecord);
+        case CATALOG_KIND_FIRMWARE: return sizeof(CatalogFirmwareRecord);
+        default: return sizeof(CatalogRomRecord);
+    }
+}
+
+/* Read side */
+
+CatalogFile* catalog_open(const char* name, uint32_t kind) {
+    char path[512];
+    struct stat st;
+
+    catalog_path(name, "bin", path, sizeof(path));
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return NULL;
+
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(CatalogHeader)) {
+        close(fd);
+        return NULL;
+    }
+
+    // Only the pages actually read are faulted in from the SD card
+    void* map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return NULL;
+
+    const CatalogHeader* header = (const CatalogHeader*)map;
+    size_t size = (size_t)st.st_size;
+    uint64_t records_end = (uint64_t)header->records_offset + (uint64_t)header->record_count * header->record_size;
+    uint64_t strings_end = (uint64_t)header->strings_offset + header->strings_size;
+
+    if (memcmp(header->magic, CATALOG_MAGIC, 4) != 0 || header->version != CATALOG_VERSION ||
+        header->kind != kind || header->record_size != record_size_of(kind) ||
+        records_end > header->strings_offset || strings_end > size || header->strings_size == 0 ||
+        ((const char*)map)[strings_end - 1] != '\0') {
+        fprintf(stderr, "Ignoring invalid catalog %s\n", path);
+        munmap(map, size);
+        return NULL;
+    }
+
+    CatalogFile* catalog = malloc(sizeof(struct CatalogFile));
+    if (!catalog) {
+        munmap(map, size);
+        return NULL;
+    }
+    catalog->map = map;
+    catalog->map_size = size;
+    catalog->header = header;
+    catalog->records = (const unsigned char*)map + header->records_offset;
+    catalog->strings = (const char*)map + header->strings_offset;
+    return catalog;
+}
+
+void catalog_close(CatalogFile* catalog) {
+    if (!catalog) return;
+
+    munmap(catalog->map, catalog->map_size);
+    free(catalog);
+}
+
+int catalog_count(const CatalogFile* catalog) {
+    return catalog ? (int)catalog->header->record_count : 0;
+}
+
+const char* catalog_stamp(const CatalogFile* catalog) {
+    return catalog->header->stamp;
+}
+
+const CatalogValidators* catalog_validators(const CatalogFile* catalog) {
+    return &catalog->header->validators;
+}
+
+static char* catalog_string(const CatalogFile* catalog, uint32_t offset) {
+    if (offset == 0 || offset >= catalog->header->strings_size) return NULL;
+    return (char*)catalog->strings + offset;
+}
+
+void catalog_get_platform(const CatalogFile* catalog, int index, RomMPlatform* platform) {
+    const CatalogPlatformRecord* record =
+        (const CatalogPlatformRecord*)(catalog->records + (size_t)index * sizeof(CatalogPlatformRecord));
+
+    memset(platform, 0, sizeof(RomMPlatform));
+    platform->id = record->id;
+    platform->igdb_id = record->igdb_id;
+    platform->sgdb_id = record->sgdb_id;
+    platform->moby_id = record->moby_id;
+    platform->rom_count = record->rom_count;
+    platform->slug = catalog_string(catalog, record->slug);
+    platform->fs_slug = catalog_string(catalog, record->fs_slug);
+    platform->name = catalog_string(catalog, record->name);
+    platform->logo_path = catalog_string(catalog, record->logo_path);
+    platform->created_at = catalog_string(catalog, record->created_at);
+    platform->updated_at = catalog_string(catalog, record->updated_at);
+}
+
+void catalog_get_rom(const CatalogFile* catalog, int index, RomMRom* rom) {
+    const CatalogRomRecord* record =
+        (const CatalogRomRecord*)(catalog->records + (size_t)index * sizeof(CatalogRomRecord));
+
+    memset(rom, 0, sizeof(RomMRom));
+    rom->id = record->id;
+    rom->platform_id = record->platform_id;
+    rom->file_size_bytes = record->file_size_bytes;
+    rom->has_cover = (record->flags & ROM_FLAG_HAS_COVER) != 0;
+    rom->multi = (record->flags & ROM_FLAG_MULTI) != 0;
+    rom->name = catalog_string(catalog, record->name);
+    rom->file_name = catalog_string(catalog, record->file_name);
+    rom->file_name_no_tags = catalog_string(catalog, record->file_name_no_tags);
+    rom->path_cover_s = catalog_string(catalog, record->path_cover_s);
+}
+
+int catalog_get_firmware(const CatalogFile* catalog, int index, RomMPlatformFirmware* firmware) {
+    const CatalogFirmwareRecord* record =
+        (const CatalogFirmwareRecord*)(catalog->records + (size_t)index * sizeof(CatalogFirmwareRecord));
+
+    memset(firmware, 0, sizeof(RomMPlatformFirmware));
+    firmware->id = record->id;
+    firmware->file_size_bytes = (int)record->file_size_bytes;
+    firmware->is_verified = (record->flags & FIRMWARE_FLAG_VERIFIED) != 0;
+    firmware->file_name = catalog_string(catalog, record->file_name);
+    firmware->file_name_no_tags = catalog_string(catalog, record->file_name_no_tags);
+    firmware->file_name_no_ext = catalog_string(catalog, record->file_name_no_ext);
+    firmware->file_extension = catalog_string(catalog, record->file_extension);
+    firmware->file_path = catalog_string(catalog, record->file_path);
+    firmware->full_path = catalog_string(catalog, record->full_path);
+    firmware->crc_hash = catalog_string(catalog, record->crc_hash);
+    firmware->md5_hash = catalog_string(catalog, record->md5_hash);
+    firmware->sha1_hash = catalog_string(catalog, record->sha1_hash);
+    firmware->created_at = catalog_string(catalog, record->created_at);
+    firmware->updated_at = catalog_string(catalog, record->updated_at);
+    return record->platform_id;
+}
+
+/* Write side */
+
+static uint64_t fnv1a(const char* text, size_t length) {
+    uint64_t hash = 1469598103934665603ULL;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= (unsigned char)text[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+static int grow_slots(CatalogWriter* writer) {
+    uint32_t slot_count = writer->slot_count ? writer->slot_count * 2 : CATALOG_STRING_BUCKETS_MIN;
+    StringSlot* slots = calloc(slot_count, sizeof(StringSlot));
+    if (!slots) return -1;
+
+    for (uint32_t i = 0; i < writer->slot_count; i++) {
+        if (!writer->slots[i].offset) continue;
+        uint32_t j = (uint32_t)writer->slots[i].hash & (slot_count - 1);
+        while (slots[j].offset) j = (j + 1) & (slot_count - 1);
+        slots[j] = writer->slots[i];
+    }
+
+    free(writer->slots);
+    writer->slots = slots;
+    writer->slot_count = slot_count;
+    return 0;
+}
+
+// Offset of text in the string table, appending it the first time it is seen
+static uint32_t intern_string(CatalogWriter* writer, const char* text) {
+    if (!text || writer->failed) return 0;
+
+    size_t length = strlen(text);
+    uint64_t hash = fnv1a(text, length);
+
+    if ((writer->slot_used + 1) * 4 > writer->slot_count * 3 && grow_slots(writer) != 0) {
+        writer->failed = true;
+        return 0;
+    }
+
+    // A hash collision must not hand one ROM another's name or file name
+    uint32_t i = (uint32_t)hash & (writer->slot_count - 1);
+    while (writer->slots[i].offset) {
+        const StringSlot* slot = &writer->slots[i];
+        if (slot->hash == hash && slot->length == length && memcmp(writer->strings + slot->offset, text, length) == 0) {
+            return slot->offset;
+        }
+        i = (i + 1) & (writer->slot_count - 1);
+    }
+
+    if (writer->strings_size + length + 1 > writer->strings_capacity) {
+        uint64_t capacity = (uint64_t)writer->strings_capacity * 2;
+        while (capacity < writer->strings_size + length + 1) capacity *= 2;
+        char* strings = capacity <= UINT32_MAX ? realloc(writer->strings, capacity) : NULL;
+        if (!strings) {
+            writer->failed = true;
+            return 0;
+        }
+        writer->strings = strings;
+        writer->strings_capacity = (uint32_t)capacity;
+    }
+
+    uint32_t offset = writer->strings_size;
+    memcpy(writer->strings + offset, text, length + 1);
+    writer->strings_size += length + 1;
+
+    writer->slots[i].hash = hash;
+    writer->slots[i].length = (uint32_t)length;
+    writer->slots[i].offset = offset;
+    writer->slot_used++;
+    return offset;
+}
+
+CatalogWriter* catalog_writer_init(const char* name, uint32_t kind) {
+    char path[512];
+
+    if (mkdir(CATALOG_CACHE_DIR, 0755) != 0 && errno != EEXIST) {
+        fprintf(stderr, "Failed to create cache directory %s: %s\n", CATALOG_CACHE_DIR, strerror(errno));
+        return NULL;
+    }
+
+    CatalogWriter* writer = calloc(1, sizeof(struct CatalogWriter));
+    if (!writer) return NULL;
+
+    snprintf(writer->name, sizeof(writer->name), "%s", name);
+    writer->kind = kind;
+
+    catalog_path(name, "records.tmp", path, sizeof(path));
+    writer->records = fopen(path, "w+b");
+    writer->strings_capacity = CATALOG_STRINGS_INITIAL;
+    writer->strings = malloc(writer->strings_capacity);
+
+    // Offset 0 is the reserved NULL string
+    if (!writer->records || !writer->strings || grow_slots(writer) != 0) {
+        catalog_writer_abort(writer);
+        return NULL;
+    }
+    writer->strings[0] = '\0';
+    writer->strings_size = 1;
+    return writer;
+}
+
+static void add_record(CatalogWriter* writer, const void* record, size_t size) {
+    if (writer->failed) return;
+
+    if (fwrite(record, 1, size, writer->records) != size) {
+        writer->failed = true;
+        return;
+    }
+    writer->record_count++;
+}
+
+int catalog_writer_add_platform(CatalogWriter* writer, const RomMPlatform* platform) {
+    CatalogPlatformRecord record;
+
+    memset(&record, 0, sizeof(record));
+    record.id = platform->id;
+    record.igdb_id = platform->igdb_id;
+    record.sgdb_id = platform->sgdb_id;
+    record.moby_id = platform->moby_id;
+    record.rom_count = platform->rom_count;
+    record.slug = intern_string(writer, platform->slug);
+    record.fs_slug = intern_string(writer, platform->fs_slug);
+    record.name = intern_string(writer, platform->name);
+    record.logo_path = intern_string(writer, platform->logo_path);
+    record.created_at = intern_string(writer, platform->created_at);
+    record.updated_at = intern_string(writer, platform->updated_at);
+
+    add_record(writer, &record, sizeof(record));
+    return writer->failed ? -1 : 0;
+}
+
+int catalog_writer_add_rom(CatalogWriter* writer, const RomMRom* rom) {
+    CatalogRomRecord record;
+
+    memset(&record, 0, sizeof(record));
+    record.id = rom->id;
+    record.platform_id = rom->platform_id;
+    record.file_size_bytes = rom->file_size_bytes;
+    if (rom->has_cover) record.flags |= ROM_FLAG_HAS_COVER;
+    if (rom->multi) record.flags |= ROM_FLAG_MULTI;
+    record.name = intern_string(writer, rom->name);
+    record.file_name = intern_string(writer, rom->file_name);
+    record.file_name_no_tags = intern_string(writer, rom->file_name_no_tags);
+    record.path_cover_s = intern_string(writer, rom->path_cover_s);
+
+    add_record(writer, &record, sizeof(record));
+    return writer->failed ? -1 : 0;
+}
+
+int catalog_writer_add_firmware(CatalogWriter* writer, int platform_id, const RomMPlatformFirmware* firmware) {
+    CatalogFirmwareRecord record;
+
+    memset(&record, 0, sizeof(record));
+    record.id = firmware->id;
+    record.platform_id = platform_id;
+    record.file_size_bytes = (uint64_t)firmware->file_size_bytes;
+    if (firmware->is_verified) record.flags |= FIRMWARE_FLAG_VERIFIED;
+    record.file_name = intern_string(writer, firmware->file_name);
+    record.file_name_no_tags = intern_string(writer, firmware->file_name_no_tags);
+    record.file_name_no_ext = intern_string(writer, firmware->file_name_no_ext);
+    record.file_extension = intern_string(writer, firmware->file_extension);
+    record.file_path = intern_string(writer, firmware->file_path);
+    record.full_path = intern_string(writer, firmware->full_path);
+    record.crc_hash = intern_string(writer, firmware->crc_hash);
+    record.md5_hash = intern_string(writer, firmware->md5_hash);
+    record.sha1_hash = intern_string(writer, firmware->sha1_hash);
+    record.created_at = intern_string(writer, firmware->created_at);
+    record.updated_at = intern_string(writer, firmware->updated_at);
+
+    add_record(writer, &record, sizeof(record));
+    return writer->failed ? -1 : 0;
+}
+
+int catalog_writer_count(const CatalogWriter* writer) {
+    return writer ? (int)writer->record_count : 0;
+}
+
+static int copy_stream(FILE* from, FILE* to, char* chunk) {
+    size_t read;
+
+    rewind(from);
+    while ((read = fread(chunk, 1, CATALOG_COPY_CHUNK, from)) > 0) {
+        if (fwrite(chunk, 1, read, to) != read) return -1;
+    }
+    return ferror(from) ? -1 : 0;
+}
+
+int catalog_writer_commit(CatalogWriter* writer, const char* stamp, const CatalogValidators* validators) {
+    char tmp_path[512];
+    char bin_path[512];
+    CatalogHeader header;
+
+    if (!writer) return -1;
+    if (writer->failed) {
+        catalog_writer_abort(writer);
+        return -1;
+    }
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CATALOG_MAGIC, 4);
+    header.version = CATALOG_VERSION;
+    header.kind = writer->kind;
+    header.record_count = writer->record_count;
+    header.record_size = record_size_of(writer->kind);
+    header.records_offset = sizeof(CatalogHeader);
+    header.strings_offset = header.records_offset + header.record_count * header.record_size;
+    header.strings_size = writer->strings_size;
+    if (stamp) snprintf(header.stamp, sizeof(header.stamp), "%s", stamp);
+    if (validators) header.validators = *validators;
+
+    catalog_path(writer->name, "bin.tmp", tmp_path, sizeof(tmp_path));
+    catalog_path(writer->name, "bin", bin_path, sizeof(bin_path));
+
+    int ret = -1;
+    char* chunk = malloc(CATALOG_COPY_CHUNK);
+    FILE* out = fopen(tmp_path, "wb");
+    if (chunk && out &&
+        fwrite(&header, 1, sizeof(header), out) == sizeof(header) &&
+        fflush(writer->records) == 0 && copy_stream(writer->records, out, chunk) == 0 &&
+        fwrite(writer->strings, 1, writer->strings_size, out) == writer->strings_size) {
+        ret = 0;
+    }
+    if (out && fclose(out) != 0) ret = -1;
+    free(chunk);
+
+    // Readers still mapping the old file keep their copy until they close it
+    if (ret == 0 && rename(tmp_path, bin_path) != 0) ret = -1;
+    if (ret != 0) {
+        fprintf(stderr, "Failed to write catalog %s\n", bin_path);
+        unlink(tmp_path);
+    }
+
+    catalog_writer_abort(writer);
+    return ret;
+}
+
+void catalog_writer_abort(CatalogWriter* writer) {
+    char path[512];
+
+    if (!writer) return;
+
+    if (writer->records) fclose(writer->records);
+    catalog_path(writer->name, "records.tmp", path, sizeof(path));
+    unlink(path);
+
+    free(writer->strings);
+    free(writer->slots);
+    free(writer);
+}
+
+/* Network side */
+
+typedef struct {
+    http_write_fn write_fn;
+    void* userp;
+    int status;
+    CatalogValidators received;
+} FetchContext;
+
+// "2024-05-01T10:20:30..." (UTC) to an HTTP-date, empty string when unparsable
+static void iso_to_http_date(const char* iso, char* out, size_t out_size) {
+    struct tm tm;
+
+    out[0] = '\0';
+    memset(&tm, 0, sizeof(tm));
+    if (!iso || sscanf(iso, "%d-%d-%dT%d:%d:%d", &tm.tm_year, &tm.tm_mon, &tm.tm_mday,
+                       &tm.tm_hour, &tm.tm_min, &tm.tm_sec) != 6) {
+        return;
+    }
+    tm.tm_year -= 1900;
+    tm.tm_mon -= 1;
+
+    time_t when = timegm(&tm);
+    strftime(out, out_size, "%a, %d %b %Y %H:%M:%S GMT", gmtime_r(&when, &tm));
+}
+
+// Copy a header value without its name and line ending
+static void header_value(const char* line, size_t name_len, char* out, size_t out_size) {
+    const char* value = line + name_len;
+    while (*value == ' ') value++;
+
+    snprintf(out, out_size, "%s", value);
+    out[strcspn(out, "\r\n")] = 0;
+}
+
+static size_t fetch_header_callback(char* buffer, size_t size, size_t nitems, void* userp) {
+    size_t realsize = size * nitems;
+    FetchContext* ctx = (FetchContext*)userp;
+    char line[256];
+
+    size_t len = realsize < sizeof(line) - 1 ? realsize : sizeof(line) - 1;
+    memcpy(line, buffer, len);
+    line[len] = '\0';
+
+    int status;
+    if (sscanf(line, "HTTP/%*s %d", &status) == 1) {
+        ctx->status = status;
+        memset(&ctx->received, 0, sizeof(CatalogValidators));
+    } else if (strncasecmp(line, "ETag:", 5) == 0) {
+        header_value(line, 5, ctx->received.etag, sizeof(ctx->received.etag));
+    } else if (strncasecmp(line, "Last-Modified:", 14) == 0) {
+        header_value(line, 14, ctx->received.last_modified, sizeof(ctx->received.last_modified));
+    }
+    return realsize;
+}
+
+static size_t fetch_write_callback(void* contents, size_t size, size_t nmemb, void* userp) {
+    FetchContext* ctx = (FetchContext*)userp;
+
+    // Only a 200 body is catalog data
+    if (ctx->status != 200) return size * nmemb;
+    return ctx->write_fn(contents, size, nmemb, ctx->userp);
+}
+
+int catalog_fetch(HttpSession* session, const char* path, const CatalogValidators* validators,
+                  const char* modified_hint, http_write_fn write_fn, void* userp,
+                  CatalogValidators* received) {
+    char if_none_match[192];
+    char if_modified_since[96];
+    char http_date[64] = "";
+    const char* headers[3];
+    int header_count = 0;
+
+    if (validators && validators->etag[0]) {
+        snprintf(if_none_match, sizeof(if_none_match), "If-None-Match: %s", validators->etag);
+        headers[header_count++] = if_none_match;
+    }
+    if (validators && validators->last_modified[0]) {
+        snprintf(http_date, sizeof(http_date), "%s", validators->last_modified);
+    } else if (validators) {
+        iso_to_http_date(modified_hint, http_date, sizeof(http_date));
+    }
+    if (http_date[0]) {
+        snprintf(if_modified_since, sizeof(if_modified_since), "If-Modified-Since: %s", http_date);
+        headers[header_count++] = if_modified_since;
+    }
+    headers[header_count] = NULL;
+
+    FetchContext ctx;
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.write_fn = write_fn;
+    ctx.userp = userp;
+
+    HttpRequest request = {
+        .path = path,
+        .headers = headers,
+        .compressed = true,
+        .write_fn = fetch_write_callback,
+        .write_userp = &ctx,
+        .header_fn = fetch_header_callback,
+        .header_userp = &ctx,
+    };
+    int status = http_request(session, &request);
+
+    if (status == 200) {
+        if (received) *received = ctx.received;
+        return CATALOG_FRESH;
+    }
+    if (status == 304 && validators) return CATALOG_UNCHANGED;
+    if (status < 0 || status >= 500) return validators ? CATALOG_OFFLINE : CATALOG_ERROR;
+    return CATALOG_ERROR;
+}
@@ -1,21 +1,59 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include "client.h"
 #include "platform.h"
 #include "menu_state.h"
+#include "catalog.h"
+#include "surface_cache.h"
+#include "cover.h"
+#include "search.h"
+#include "bios.h"
+#include "library.h"
+#include "trace.h"
 
 #include "SDL/SDL.h"
 #include "SDL/SDL_ttf.h"
 
 #define ITEM_HEIGHT 40
 #define MAX_VISIBLE_ITEMS 10
-#define FRAME_RATE 60.0f
+#define FRAME_RATE 60.0f   // Upper bound, frames are only drawn when something changed
+#define EVENT_WAKE 1       // SDL_USEREVENT code posted by worker threads
+#define FONT_SIZE 16
+#define ROM_TEXT_X (20 + COVER_LIST_SIZE + 8)  // ROM names start right of the cover thumbnail
+#define TEXT_CACHE_BUDGET (1024 * 1024)  // Rendered text kept across frames, in pixel bytes
+#define COVER_CACHE_BUDGET (2 * 1024 * 1024)  // Cover thumbnails kept in memory, in pixel bytes
+#define COVER_PREFETCH_AHEAD MAX_VISIBLE_ITEMS  // Covers requested past the window in the scroll direction
+#define SEARCH_KEYS "abcdefghijklmnopqrstuvwxyz0123456789 "  // On-screen keyboard, space last
+#define SEARCH_KEY_COLUMNS 10
+#define SEARCH_KEY_WIDTH 40
+#define SEARCH_KEY_HEIGHT 32
+#define SEARCH_VISIBLE_RESULTS 6
+#define DETAIL_WRAP_CHARS 44       // Summary line length left of the detail cover
+#define DETAIL_SUMMARY_LINES 7
+#define STATS_REFRESH_MS 500     // Overlay redraw period while nothing else changes
+#define STATS_POLL_MS 50
+#define STATS_FRAME_WINDOW_US 2000000ULL      // Frames summarized by the overlay
+#define STATS_REQUEST_WINDOW_US 60000000ULL   // Requests summarized by the overlay
 
 void cleanup_menu(MenuState* state) {
+    // Unblock workers waiting on a slow or dead server so quitting is immediate
+    if (state->session) http_session_abort(state->session);
     if (state->server_url) free(state->server_url);
     if (state->username) free(state->username);
     if (state->password) free(state->password);
-    if (state->platforms) free_platform_list(state->platforms, state->platform_count);
+    if (state->search) search_index_free(state->search);
+    if (state->search_catalog) catalog_close(state->search_catalog);
+    if (state->roms) rom_list_free(state->roms);
+    if (state->details) rom_detail_cache_free(state->details);
+    if (state->covers) cover_store_free(state->covers);
+    if (state->fetcher) fetcher_free(state->fetcher);
+    if (state->library) library_free(state->library);
+    if (state->platform_arena) arena_release(state->platform_arena);
+    if (state->downloads) download_queue_free(state->downloads);
+    if (state->session) http_session_free(state->session);
+    if (state->text_cache) surface_cache_free(state->text_cache);
+    trace_dump_close();
     if (state->font) TTF_CloseFont(state->font);
     if (state->screen) SDL_FreeSurface(state->screen);
     if (state->renderer) SDL_FreeSurface(state->renderer);
@@ -46,7 +84,8 @@ int init_menu(MenuState* state) {
     state->display_height = info->current_h;
 
     // Load font - adjust path as needed for the Miyoo Mini
-    state->font = TTF_OpenFont("/mnt/SDCARD/App/RomM/fonts/DejaVuSans.ttf", 16);
+    state->font_size = FONT_SIZE;
+    state->font = TTF_OpenFont("/mnt/SDCARD/App/RomM/fonts/DejaVuSans.ttf", state->font_size);
     if (!state->font) {
         fprintf(stderr, "Failed to load font! TTF_Error: %s\n", TTF_GetError());
         TTF_Quit();
@@ -79,22 +118,201 @@ int init_menu(MenuState* state) {
     state->last_tick_count = SDL_GetTicks();
     state->cur_tick_count = state->last_tick_count;
 
+    state->text_cache = surface_cache_init(TEXT_CACHE_BUDGET);
+    if (!state->text_cache) {
+        fprintf(stderr, "Failed to create text cache\n");
+        return -1;
+    }
+
     state->server_url = malloc(256);
     state->username = malloc(256);
     state->password = malloc(256);
+    state->download_workers = DOWNLOAD_QUEUE_DEFAULT_WORKERS;
 
     return 0;
 }
 
-void render_platform_list(MenuState* state) {
-    if (!state->renderer || !state->font) return;  // Add safety check
+// Rendered text for (text, color, font size), rasterized only on a cache miss
+static SDL_Surface* text_surface(MenuState* state, const char* text, SDL_Color color) {
+    char key_buffer[256];
+    char* key = key_buffer;
+
+    int key_len = snprintf(key_buffer, sizeof(key_buffer), "%d|%02x%02x%02x|%s",
+                           state->font_size, color.r, color.g, color.b, text);
+    if (key_len >= (int)sizeof(key_buffer)) {
+        key = malloc(key_len + 1);
+        if (!key) return NULL;
+        snprintf(key, key_len + 1, "%d|%02x%02x%02x|%s", state->font_size, color.r, color.g, color.b, text);
+    }
+
+    SDL_Surface* surface = surface_cache_get(state->text_cache, key);
+    if (!surface) {
+        surface = TTF_RenderUTF8_Solid(state->font, text, color);
+
+        // Convert once to the screen format so every later frame is a plain blit
+        SDL_Surface* converted = surface ? SDL_DisplayFormat(surface) : NULL;
+        if (converted) {
+            SDL_FreeSurface(surface);
+            surface = converted;
+        }
+        surface_cache_put(state->text_cache, key, surface);
+    }
+
+    if (key != key_buffer) free(key);
+    return surface;
+}
+
+// Draw a line of text onto the renderer surface
+static void draw_text(MenuState* state, const char* text, int x, int y, SDL_Color color) {
+    if (!text || !*text) return;
+
+    SDL_Surface* surface = text_surface(state, text, color);
+    if (surface) {
+        SDL_Rect dest_rect = {
+            x,                 // x position
+            y,                 // y position
+            surface->w,        // width
+            surface->h         // height
+        };
+
+        SDL_BlitSurface(surface, NULL, state->renderer, &dest_rect);
+    }
+}
+
+static void clear_frame(MenuState* state) {
+    state->frame_start = trace_now_us();
 
     // Clear screen with black using the surface's format
     Uint32 black = SDL_MapRGB(state->renderer->format, 0, 0, 0);
     SDL_FillRect(state->renderer, NULL, black);
+}
+
+// Values change every frame, so the overlay bypasses the text cache
+static void draw_text_uncached(MenuState* state, const char* text, int x, int y, SDL_Color color) {
+    SDL_Surface* surface = TTF_RenderUTF8_Solid(state->font, text, color);
+    if (!surface) return;
+
+    SDL_Rect dest_rect = { x, y, surface->w, surface->h };
+    SDL_BlitSurface(surface, NULL, state->renderer, &dest_rect);
+    SDL_FreeSurface(surface);
+}
+
+// Frame time, request latency and download rate from the trace ring
+static void draw_stats_overlay(MenuState* state) {
+    uint64_t now = trace_now_us();
+    TraceStats frame, build, blit, flip, request, ttfb, dns, json, disk, disk_wait;
+    trace_stats(TRACE_FRAME, now - STATS_FRAME_WINDOW_US, &frame);
+    trace_stats(TRACE_FRAME_BUILD, now - STATS_FRAME_WINDOW_US, &build);
+    trace_stats(TRACE_FRAME_BLIT, now - STATS_FRAME_WINDOW_US, &blit);
+    trace_stats(TRACE_FRAME_FLIP, now - STATS_FRAME_WINDOW_US, &flip);
+    trace_stats(TRACE_HTTP_REQUEST, now - STATS_REQUEST_WINDOW_US, &request);
+    trace_stats(TRACE_HTTP_TTFB, now - STATS_REQUEST_WINDOW_US, &ttfb);
+    trace_stats(TRACE_HTTP_DNS, now - STATS_REQUEST_WINDOW_US, &dns);
+    trace_stats(TRACE_JSON_DECODE, now - STATS_REQUEST_WINDOW_US, &json);
+    trace_stats(TRACE_DISK_WRITE, now - STATS_REQUEST_WINDOW_US, &disk);
+    trace_stats(TRACE_DISK_WAIT, now - STATS_REQUEST_WINDOW_US, &disk_wait);
+
+    unsigned long long rate = 0;
+    int count = download_queue_count(state->downloads);
+    for (int i = 0; i < count; i++) {
+        const DownloadItem* item = download_queue_get(state->downloads, i);
+        if (download_item_state(item) != DOWNLOAD_ITEM_ACTIVE) continue;
+        DownloadProgress progress;
+        download_item_progress(item, &progress);
+        rate += (unsigned long long)progress.bytes_per_sec;
+    }
+
+    char lines[5][96];
+    snprintf(lines[0], sizeof(lines[0]), "frame %.1f ms  build %.1f  blit %.1f  flip %.1f",
+             frame.p50_us / 1000.0, build.p50_us / 1000.0, blit.p50_us / 1000.0, flip.p50_us / 1000.0);
+    snprintf(lines[1], sizeof(lines[1]), "request p50 %u ms  p99 %u ms  (%d)",
+             request.p50_us / 1000, request.p99_us / 1000, request.count);
+    snprintf(lines[2], sizeof(lines[2]), "ttfb p50 %u ms  p99 %u ms  dns %u ms",
+             ttfb.p50_us / 1000, ttfb.p99_us / 1000, dns.p50_us / 1000);
+    snprintf(lines[3], sizeof(lines[3]), "json p50 %u ms  p99 %u ms",
+             json.p50_us / 1000, json.p99_us / 1000);
+    snprintf(lines[4], sizeof(lines[4]), "download %.1f KB/s  disk p99 %u ms  stalls %d",
+             rate / 1024.0, disk.p99_us / 1000, disk_wait.count);
+
+    SDL_Rect box = { state->display_width - 330, 4, 326, 5 * 18 + 8 };
+    SDL_FillRect(state->renderer, &box, SDL_MapRGB(state->renderer->format, 24, 24, 48));
+    SDL_Color stats_color = {200, 230, 255, 0};
+    for (int i = 0; i < 5; i++) {
+        draw_text_uncached(state, lines[i], box.x + 6, box.y + 4 + i * 18, stats_color);
+    }
+}
+
+static void present_frame(MenuState* state) {
+    uint64_t built = trace_now_us();
+    trace_span(TRACE_FRAME_BUILD, state->frame_start, built, 0);
+    if (state->show_stats) draw_stats_overlay(state);
+
+    // Blit the renderer to the screen
+    uint64_t blit_start = trace_now_us();
+    SDL_BlitSurface(state->renderer, NULL, state->screen, NULL);
+    uint64_t blitted = trace_now_us();
+    SDL_Flip(state->screen);
+    uint64_t flipped = trace_now_us();
+
+    trace_span(TRACE_FRAME_BLIT, blit_start, blitted, 0);
+    trace_span(TRACE_FRAME_FLIP, blitted, flipped, 0);
+    trace_span(TRACE_FRAME, state->frame_start, flipped, 0);
+}
+
+// Latest queue item of a ROM, NULL when it was never queued
+static const DownloadItem* find_rom_download(MenuState* state, int rom_id) {
+    const DownloadItem* found = NULL;
+    int count = download_queue_count(state->downloads);
+    for (int i = 0; i < count; i++) {
+        const DownloadItem* item = download_queue_get(state->downloads, i);
+        if (item->rom_id == rom_id) found = item;
+    }
+    return found;
+}
+
+// One-line summary of the connection and download queue along the bottom edge
+static void draw_status_line(MenuState* state) {
+    int active = 0, queued = 0, done = 0, failed = 0;
+    int count = download_queue_count(state->downloads);
+
+    for (int i = 0; i < count; i++) {
+        switch (download_item_state(download_queue_get(state->downloads, i))) {
+            case DOWNLOAD_ITEM_ACTIVE: active++; break;
+            case DOWNLOAD_ITEM_QUEUED: queued++; break;
+            case DOWNLOAD_ITEM_DONE: done++; break;
+            case DOWNLOAD_ITEM_FAILED: failed++; break;
+            default: break;
+        }
+    }
+
+    char status[160] = "";
+    if (state->notice[0]) {
+        snprintf(status, sizeof(status), "%s", state->notice);
+    } else if (state->offline) {
+        snprintf(status, sizeof(status), "Offline, showing cached catalog");
+    } else if (count > 0) {
+        snprintf(status, sizeof(status), "Downloads: %d active, %d queued, %d done, %d failed",
+                 active, queued, done, failed);
+    }
+
+    SDL_Color status_color = {160, 160, 160, 0};
+    draw_text(state, status, 20, state->display_height - 30, status_color);
+}
+
+void render_platform_list(MenuState* state) {
+    if (!state->renderer || !state->font) return;  // Add safety check
+
+    clear_frame(state);
 
     SDL_Color text_color = {255, 255, 255, 0};
     SDL_Color selected_color = {255, 255, 0, 0};
+    SDL_Color pending_color = {110, 110, 110, 0};
+
+    if (state->platform_count == 0) {
+        const char* message = state->load_failed ? "Failed to load platforms, press A to retry"
+                            : state->loading ? "Loading platforms..." : "No platforms";
+        draw_text(state, message, 20, 10, pending_color);
+    }
 
     for (int i = 0; i < state->platform_count && i < MAX_VISIBLE_ITEMS; i++) {
         int actual_index = i + state->scroll_offset;
@@ -104,36 +322,636 @@ void render_platform_list(MenuState* state) {
                                 selected_color : text_color;
 
         if (state->platforms && state->platforms[actual_index].name) {  // Add safety check
-            SDL_Surface* text_surface = TTF_RenderText_Solid(state->font, 
-                state->platforms[actual_index].name, 
-                current_color);
-
-            if (text_surface) {
-                SDL_Rect dest_rect = {
-                    20,                    // x position
-                    i * ITEM_HEIGHT + 10,  // y position
-                    text_surface->w,       // width
-                    text_surface->h        // height
+            draw_text(state, state->platforms[actual_index].name, 20, i * ITEM_HEIGHT + 10, current_color);
+        }
+    }
+
+    draw_status_line(state);
+    present_frame(state);
+}
+
+void render_rom_list(MenuState* state) {
+    if (!state->renderer || !state->font || !state->roms) return;
+
+    clear_frame(state);
+
+    SDL_Color text_color = {255, 255, 255, 0};
+    SDL_Color selected_color = {255, 255, 0, 0};
+    SDL_Color pending_color = {110, 110, 110, 0};
+    SDL_Color present_color = {120, 200, 120, 0};
+    SDL_Color outdated_color = {230, 160, 60, 0};
+    const RomMPlatform* platform = &state->platforms[state->rom_platform_index];
+
+    int rom_count = rom_list_count(state->roms);
+    for (int i = 0; i < MAX_VISIBLE_ITEMS; i++) {
+        int actual_index = i + state->scroll_offset;
+        if (actual_index >= rom_count) break;
+
+        const RomMRom* rom = rom_list_get(state->roms, actual_index);
+        int row_y = i * ITEM_HEIGHT + 10;
+        if (rom) {
+            SDL_Color current_color = text_color;
+            switch (library_rom_status(state->library, platform, rom)) {
+                case LIBRARY_PRESENT: current_color = present_color; break;
+                case LIBRARY_OUTDATED: current_color = outdated_color; break;
+                default: break;
+            }
+            if (actual_index == state->selected_index) current_color = selected_color;
+
+            // Thumbnail centered in its box, to the left of the name
+            SDL_Surface* cover = cover_store_get(state->covers, rom, COVER_LIST);
+            if (cover) {
+                SDL_Rect cover_rect = {
+                    20 + (COVER_LIST_SIZE - cover->w) / 2,
+                    row_y - 8 + (COVER_LIST_SIZE - cover->h) / 2,
+                    cover->w,
+                    cover->h
                 };
+                SDL_BlitSurface(cover, NULL, state->renderer, &cover_rect);
+            }
+            draw_text(state, rom->name ? rom->name : rom->file_name, ROM_TEXT_X, row_y, current_color);
+        } else {
+            // Row whose page is still on its way
+            const char* placeholder = rom_list_failed(state->roms) ? "Failed to load, retrying..." : "Loading...";
+            draw_text(state, placeholder, ROM_TEXT_X, row_y, pending_color);
+        }
+    }
+
+    draw_status_line(state);
+    present_frame(state);
+}
+
+// Length of the next line of text wrapped at max_chars bytes, breaking after a space
+// when there is one and never inside a UTF-8 sequence
+static size_t wrap_length(const char* text, size_t max_chars) {
+    size_t length = strlen(text);
+    if (length <= max_chars) return length;
+
+    size_t cut = max_chars;
+    while (cut > 0 && text[cut] != ' ') cut--;
+    if (cut > 0) return cut + 1;
+
+    cut = max_chars;
+    while (cut > 0 && ((unsigned char)text[cut] & 0xC0) == 0x80) cut--;
+    return cut > 0 ? cut : max_chars;
+}
+
+static void format_size(unsigned long long bytes, char* text, size_t text_size) {
+    if (bytes >= 1024ULL * 1024 * 1024) {
+        snprintf(text, text_size, "%.1f GB", bytes / (1024.0 * 1024 * 1024));
+    } else if (bytes >= 1024 * 1024) {
+        snprintf(text, text_size, "%.1f MB", bytes / (1024.0 * 1024));
+    } else {
+        snprintf(text, text_size, "%.1f KB", bytes / 1024.0);
+    }
+}
+
+// List record of the selected ROM, with the large cover beside its details
+void render_rom_detail(MenuState* state) {
+    if (!state->renderer || !state->font || !state->roms) return;
+
+    clear_frame(state);
+
+    SDL_Color text_color = {255, 255, 255, 0};
+    SDL_Color title_color = {255, 255, 0, 0};
+    SDL_Color pending_color = {110, 110, 110, 0};
+    SDL_Color info_color = {180, 180, 180, 0};
+
+    const RomMRom* rom = rom_list_get(state->roms, state->selected_index);
+    if (!rom) {
+        draw_text(state, "Loading...", 20, 10, pending_color);
+        draw_status_line(state);
+        present_frame(state);
+        return;
+    }
+
+    const RomMPlatform* platform = &state->platforms[state->rom_platform_index];
+    const RomMRomDetail* detail = rom_detail_cache_get(state->details, rom->id);
+    char line[256];
+    int y = 10;
+
+    draw_text(state, rom->name ? rom->name : rom->file_name, 20, y, title_color);
+    y += ITEM_HEIGHT;
+
+    SDL_Surface* cover = cover_store_get(state->covers, rom, COVER_DETAIL);
+    if (cover) {
+        SDL_Rect cover_rect = {
+            state->display_width - 20 - COVER_DETAIL_SIZE + (COVER_DETAIL_SIZE - cover->w) / 2,
+            y + (COVER_DETAIL_SIZE - cover->h) / 2,
+            cover->w,
+            cover->h
+        };
+        SDL_BlitSurface(cover, NULL, state->renderer, &cover_rect);
+    }
+
+    draw_text(state, rom->file_name, 20, y, info_color);
+    y += 24;
+
+    const char* status = "Not on the SD card";
+    switch (library_rom_status(state->library, platform, rom)) {
+        case LIBRARY_PRESENT: status = "On the SD card"; break;
+        case LIBRARY_OUTDATED: status = "Outdated on the SD card"; break;
+        default: break;
+    }
+    char size[32];
+    format_size(rom->file_size_bytes, size, sizeof(size));
+    snprintf(line, sizeof(line), "%s, %s", size, status);
+    draw_text(state, line, 20, y, info_color);
+    y += 24;
+
+    const DownloadItem* download = find_rom_download(state, rom->id);
+    if (download) {
+        DownloadProgress progress;
+        download_item_progress(download, &progress);
+        int percent = progress.bytes_total > 0 ? (int)(progress.bytes_done * 100 / progress.bytes_total) : 0;
+        line[0] = '\0';
+        switch (download_item_state(download)) {
+            case DOWNLOAD_ITEM_QUEUED:
+                snprintf(line, sizeof(line), "Queued, X pauses, Select + X cancels");
+                break;
+            case DOWNLOAD_ITEM_ACTIVE:
+                snprintf(line, sizeof(line), "Downloading %d%%, X pauses, Select + X cancels", percent);
+                break;
+            case DOWNLOAD_ITEM_PAUSED:
+                snprintf(line, sizeof(line), "Paused at %d%%, X resumes, Select + X cancels", percent);
+                break;
+            case DOWNLOAD_ITEM_FAILED:
+                snprintf(line, sizeof(line), "Download failed, X retries, Select + X cancels");
+                break;
+            default:
+                break;
+        }
+        if (line[0]) {
+            draw_text(state, line, 20, y, info_color);
+            y += 24;
+        }
+    }
+
+    if (!detail) {
+        const char* message = "Loading details...";
+        if (rom_detail_cache_failed(state->details, rom->id)) {
+            message = state->skip_verify ? "Details unavailable, A downloads without verifying" :
+                                           "Details unavailable, A retries";
+        }
+        draw_text(state, message, 20, y, pending_color);
+    } else {
+        if (rom->multi && detail->files_count > 0) {
+            snprintf(line, sizeof(line), "%d files", detail->files_count);
+            draw_text(state, line, 20, y, info_color);
+            y += 24;
+        }
+        if (detail->revision && detail->revision[0]) {
+            snprintf(line, sizeof(line), "Revision %s", detail->revision);
+            draw_text(state, line, 20, y, info_color);
+            y += 24;
+        }
+        if (detail->crc_hash) {
+            snprintf(line, sizeof(line), "CRC32 %s", detail->crc_hash);
+            draw_text(state, line, 20, y, info_color);
+            y += 24;
+        }
+
+        y += 8;
+        const char* summary = detail->summary ? detail->summary : "";
+        for (int i = 0; i < DETAIL_SUMMARY_LINES && *summary; i++) {
+            size_t length = wrap_length(summary, DETAIL_WRAP_CHARS);
+            bool last = i == DETAIL_SUMMARY_LINES - 1 && summary[length];
+            snprintf(line, sizeof(line), "%.*s%s", (int)length, summary, last ? "..." : "");
+            draw_text(state, line, 20, y, text_color);
+            summary += length;
+            y += 22;
+        }
+    }
+
+    draw_text(state, "A: download   B: back", 20, state->display_height - 60, pending_color);
+    draw_status_line(state);
+    present_frame(state);
+}
+
+void render_search(MenuState* state) {
+    if (!state->renderer || !state->font || !state->search) return;
+
+    clear_frame(state);
+
+    SDL_Color text_color = {255, 255, 255, 0};
+    SDL_Color selected_color = {255, 255, 0, 0};
+    SDL_Color pending_color = {110, 110, 110, 0};
+
+    char line[SEARCH_MAX_QUERY + 32];
+    snprintf(line, sizeof(line), "Search: %s_", state->search_query);
+    draw_text(state, line, 20, 10, text_color);
+    snprintf(line, sizeof(line), "%d found", state->search_count);
+    draw_text(state, line, state->display_width - 120, 10, pending_color);
+
+    for (int i = 0; i < SEARCH_VISIBLE_RESULTS; i++) {
+        int actual_index = i + state->search_scroll;
+        if (actual_index >= state->search_count) break;
+
+        RomMRom rom;
+        catalog_get_rom(state->search_catalog, search_index_result(state->search, actual_index), &rom);
+        SDL_Color current_color = (state->search_in_results && actual_index == state->search_selected) ?
+                                selected_color : text_color;
+        draw_text(state, rom.name ? rom.name : rom.file_name, 20, i * ITEM_HEIGHT + 50, current_color);
+    }
+
+    // Keyboard along the bottom, above the status line
+    int keys_length = (int)strlen(SEARCH_KEYS);
+    int rows = (keys_length + SEARCH_KEY_COLUMNS - 1) / SEARCH_KEY_COLUMNS;
+    int keyboard_y = state->display_height - 40 - rows * SEARCH_KEY_HEIGHT;
+    for (int i = 0; i < keys_length; i++) {
+        char label[2] = { SEARCH_KEYS[i] == ' ' ? '_' : SEARCH_KEYS[i], '\0' };
+        SDL_Color current_color = i == state->search_key ?
+                                (state->search_in_results ? text_color : selected_color) : pending_color;
+        draw_text(state, label, 20 + (i % SEARCH_KEY_COLUMNS) * SEARCH_KEY_WIDTH,
+                  keyboard_y + (i / SEARCH_KEY_COLUMNS) * SEARCH_KEY_HEIGHT, current_color);
+    }
+
+    draw_status_line(state);
+    present_frame(state);
+}
+
+// Notify callback of every worker thread: wake the main loop, with at most one
+// wake event queued so download progress cannot flood the event queue
+static void wake_main_loop(void* userp) {
+    MenuState* state = (MenuState*)userp;
+
+    if (__atomic_exchange_n(&state->wake_pending, 1, __ATOMIC_ACQ_REL)) return;
+
+    SDL_Event event;
+    memset(&event, 0, sizeof(event));
+    event.type = SDL_USEREVENT;
+    event.user.code = EVENT_WAKE;
+    if (SDL_PushEvent(&event) != 0) __atomic_store_n(&state->wake_pending, 0, __ATOMIC_RELEASE);
+}
+
+void open_rom_list(MenuState* state, int platform_index) {
+    if (platform_index < 0 || platform_index >= state->platform_count) return;
+
+    RomMPlatform* platform = &state->platforms[platform_index];
+    state->roms = rom_list_init(state->session, platform->id, platform->rom_count, platform->updated_at,
+                                wake_main_loop, state);
+    if (!state->roms) return;
+
+    state->rom_platform_index = platform_index;
+    state->platform_selected_index = state->selected_index;
+    state->platform_scroll_offset = state->scroll_offset;
+    state->selected_index = 0;
+    state->scroll_offset = 0;
+    state->scroll_direction = 0;
+    state->view = VIEW_ROMS;
+    rom_list_set_window(state->roms, 0, MAX_VISIBLE_ITEMS, 0);
+}
+
+void close_rom_list(MenuState* state) {
+    search_index_free(state->search);
+    catalog_close(state->search_catalog);
+    state->search = NULL;
+    state->search_catalog = NULL;
+    state->search_query[0] = '\0';
+    rom_list_free(state->roms);
+    state->roms = NULL;
+    state->selected_index = state->platform_selected_index;
+    state->scroll_offset = state->platform_scroll_offset;
+    state->scroll_direction = 0;
+    state->view = VIEW_PLATFORMS;
+}
+
+// Show the selected ROM of the list; its details are fetched while the screen is up
+void open_rom_detail(MenuState* state) {
+    const RomMRom* rom = rom_list_get(state->roms, state->selected_index);
+    if (!rom) return;
+
+    rom_detail_cache_retry(state->details, rom->id);
+    state->scroll_direction = 0;
+    state->view = VIEW_ROM_DETAIL;
+}
 
-                SDL_BlitSurface(text_surface, NULL, state->renderer, &dest_rect);
-                SDL_FreeSurface(text_surface);
+void close_rom_detail(MenuState* state) {
+    state->scroll_direction = 0;
+    state->view = VIEW_ROMS;
+}
+
+// Digests to verify against come with the details, so the download waits for them.
+// When they could not be fetched the fetch is retried; only skip_verify queues without.
+void enqueue_selected_rom(MenuState* state) {
+    const RomMRom* rom = rom_list_get(state->roms, state->selected_index);
+    if (!rom || !rom->file_name) return;
+
+    const RomMRomDetail* detail = rom_detail_cache_get(state->details, rom->id);
+    if (!detail && !rom_detail_cache_failed(state->details, rom->id)) {
+        snprintf(state->notice, sizeof(state->notice), "Waiting for the ROM details");
+        return;
+    }
+    if (!detail && !state->skip_verify) {
+        rom_detail_cache_retry(state->details, rom->id);
+        rom_detail_cache_get(state->details, rom->id);  // Requests it again
+        snprintf(state->notice, sizeof(state->notice), "No ROM details to verify the download, retrying");
+        return;
+    }
+
+    const RomMPlatform* platform = &state->platforms[state->rom_platform_index];
+    bool extract = state->extract_zip && !platform_keeps_archives(platform);
+    char destination[1024];
+    if (platform_rom_path(platform, rom->file_name, destination, sizeof(destination)) != 0) {
+        snprintf(state->notice, sizeof(state->notice), "Refusing to save %s outside the ROM folder", rom->file_name);
+        return;
+    }
+    if (download_queue_add(state->downloads, rom, detail, destination, extract) < 0) {
+        fprintf(stderr, "Failed to queue download of %s\n", rom->file_name);
+    }
+}
+
+// Pause or resume the selected ROM's download, or cancel it
+void control_selected_download(MenuState* state, bool cancel) {
+    const RomMRom* rom = rom_list_get(state->roms, state->selected_index);
+    if (!rom) return;
+
+    const DownloadItem* item = find_rom_download(state, rom->id);
+    DownloadItemState item_state = item ? download_item_state(item) : DOWNLOAD_ITEM_DONE;
+    if (!item || item_state == DOWNLOAD_ITEM_DONE || item_state == DOWNLOAD_ITEM_CANCELLED) {
+        snprintf(state->notice, sizeof(state->notice), "No download of %s to control", rom->file_name);
+        return;
+    }
+
+    const char* action;
+    int result;
+    if (cancel) {
+        action = "Cancelled";
+        result = download_queue_cancel(state->downloads, item->id);
+    } else if (item_state == DOWNLOAD_ITEM_PAUSED || item_state == DOWNLOAD_ITEM_FAILED) {
+        action = "Resumed";
+        result = download_queue_resume(state->downloads, item->id);
+    } else {
+        action = "Paused";
+        result = download_queue_pause(state->downloads, item->id);
+    }
+
+    if (result == 0) {
+        snprintf(state->notice, sizeof(state->notice), "%s %s", action, rom->file_name);
+    } else {
+        snprintf(state->notice, sizeof(state->notice), "Download of %s cannot be changed now", rom->file_name);
+    }
+}
+
+// Enter the search view of the open ROM list. The index needs the whole list, so it
+// is built from the local catalog, which exists once the list was fully fetched.
+void open_search(MenuState* state) {
+    if (!state->search) {
+        RomMPlatform* platform = &state->platforms[state->rom_platform_index];
+        state->search_catalog = rom_catalog_open(platform->id, platform->rom_count, platform->updated_at);
+        if (!state->search_catalog) {
+            snprintf(state->notice, sizeof(state->notice), "Search is available once the list is stored locally");
+            return;
+        }
+
+        state->search = search_index_build(state->search_catalog);
+        if (!state->search) {
+            catalog_close(state->search_catalog);
+            state->search_catalog = NULL;
+            return;
+        }
+    }
+
+    state->search_count = search_index_query(state->search, state->search_query);
+    state->search_in_results = false;
+    state->search_selected = 0;
+    state->search_scroll = 0;
+    state->view = VIEW_SEARCH;
+}
+
+// Leave the search view, moving the ROM list cursor to the chosen match if any
+void close_search(MenuState* state, int rom_index) {
+    state->view = VIEW_ROMS;
+    state->scroll_direction = 0;
+
+    int rom_count = rom_list_count(state->roms);
+    if (rom_index < 0 || rom_index >= rom_count) return;
+
+    state->selected_index = rom_index;
+    state->scroll_offset = rom_index - MAX_VISIBLE_ITEMS / 2;
+    if (state->scroll_offset > rom_count - MAX_VISIBLE_ITEMS) state->scroll_offset = rom_count - MAX_VISIBLE_ITEMS;
+    if (state->scroll_offset < 0) state->scroll_offset = 0;
+}
+
+static void update_search(MenuState* state) {
+    state->search_count = search_index_query(state->search, state->search_query);
+    state->search_selected = 0;
+    state->search_scroll = 0;
+    if (state->search_count == 0) state->search_in_results = false;
+}
+
+// Keyboard focus: d-pad moves, A types, B deletes (leaves when empty), X jumps to
+// the matches. Match focus: d-pad scrolls, A opens the match in the list, B or X
+// goes back to the keyboard.
+static void handle_search_input(MenuState* state, SDLKey key) {
+    int keys_length = (int)strlen(SEARCH_KEYS);
+    size_t query_length = strlen(state->search_query);
+
+    if (state->search_in_results) {
+        switch (key) {
+            case SDLK_UP:
+                if (state->search_selected > 0) state->search_selected--;
+                if (state->search_selected < state->search_scroll) state->search_scroll--;
+                break;
+            case SDLK_DOWN:
+                if (state->search_selected < state->search_count - 1) state->search_selected++;
+                if (state->search_selected >= state->search_scroll + SEARCH_VISIBLE_RESULTS) state->search_scroll++;
+                break;
+            case SDLK_SPACE:
+                close_search(state, search_index_result(state->search, state->search_selected));
+                break;
+            case SDLK_LCTRL:
+            case SDLK_LSHIFT:
+                state->search_in_results = false;
+                break;
+            default:
+                break;
+        }
+        return;
+    }
+
+    switch (key) {
+        case SDLK_UP:
+            if (state->search_key >= SEARCH_KEY_COLUMNS) state->search_key -= SEARCH_KEY_COLUMNS;
+            break;
+        case SDLK_DOWN:
+            if (state->search_key + SEARCH_KEY_COLUMNS < keys_length) state->search_key += SEARCH_KEY_COLUMNS;
+            break;
+        case SDLK_LEFT:
+            if (state->search_key % SEARCH_KEY_COLUMNS > 0) state->search_key--;
+            break;
+        case SDLK_RIGHT:
+            if (state->search_key % SEARCH_KEY_COLUMNS < SEARCH_KEY_COLUMNS - 1 && state->search_key + 1 < keys_length) {
+                state->search_key++;
             }
+            break;
+        case SDLK_SPACE:
+            if (query_length + 1 < sizeof(state->search_query)) {
+                state->search_query[query_length] = SEARCH_KEYS[state->search_key];
+                state->search_query[query_length + 1] = '\0';
+                update_search(state);
+            }
+            break;
+        case SDLK_LCTRL:
+            if (query_length == 0) {
+                close_search(state, -1);
+            } else {
+                state->search_query[query_length - 1] = '\0';
+                update_search(state);
+            }
+            break;
+        case SDLK_LSHIFT:
+            if (state->search_count > 0) state->search_in_results = true;
+            break;
+        default:
+            break;
+    }
+}
+
+// Queue the BIOS files of the selected platform, skipping those already in place
+void fetch_selected_bios(MenuState* state) {
+    if (state->selected_index < 0 || state->selected_index >= state->platform_count) return;
+
+    const RomMPlatform* platform = &state->platforms[state->selected_index];
+    if (platform->firmware_count == 0) {
+        snprintf(state->notice, sizeof(state->notice), "No BIOS files for %s", platform->name);
+        return;
+    }
+
+    int queued = bios_fetch_platform(state->downloads, platform);
+    if (queued < 0) {
+        snprintf(state->notice, sizeof(state->notice), "Failed to queue BIOS files");
+    } else {
+        snprintf(state->notice, sizeof(state->notice), "Checking %d BIOS files for %s", queued, platform->name);
+    }
+}
+
+// Swap in a refreshed platform list, keeping the cursor and an open ROM list valid
+void apply_platform_list(MenuState* state, Arena* arena, RomMPlatform* platforms, int platform_count) {
+    bool list_open = state->view != VIEW_PLATFORMS;
+    int open_platform_id = list_open ? state->platforms[state->rom_platform_index].id : -1;
+
+    if (state->platform_arena) arena_release(state->platform_arena);
+    state->platform_arena = arena;
+    state->platforms = platforms;
+    state->platform_count = platform_count;
+
+    int* cursor = list_open ? &state->platform_selected_index : &state->selected_index;
+    int* scroll = list_open ? &state->platform_scroll_offset : &state->scroll_offset;
+    if (*cursor >= platform_count) *cursor = platform_count > 0 ? platform_count - 1 : 0;
+    if (*scroll > *cursor) *scroll = *cursor;
+
+    if (list_open) {
+        int found = -1;
+        for (int i = 0; i < platform_count; i++) {
+            if (platforms[i].id == open_platform_id) found = i;
+        }
+        if (found < 0) {
+            close_rom_list(state);
+        } else {
+            state->rom_platform_index = found;
         }
     }
 
-    // Blit the renderer to the screen
-    SDL_BlitSurface(state->renderer, NULL, state->screen, NULL);
-    SDL_Flip(state->screen);
+    // New platforms may map to folders the library has not read yet
+    library_scan(state->library, platforms, platform_count);
+}
+
+// Record downloads that finished since the last check, so their rows turn present
+static void note_finished_downloads(MenuState* state) {
+    unsigned int generation = download_queue_generation(state->downloads);
+    if (generation == state->library_generation) return;
+    state->library_generation = generation;
+
+    int count = download_queue_count(state->downloads);
+    int done = 0;
+    for (int i = 0; i < count; i++) {
+        if (download_item_state(download_queue_get(state->downloads, i)) == DOWNLOAD_ITEM_DONE) done++;
+    }
+    if (done == state->library_done_count) return;
+    state->library_done_count = done;
+
+    bool extracted = false;
+    for (int i = 0; i < count; i++) {
+        const DownloadItem* item = download_queue_get(state->downloads, i);
+        if (item->rom_id >= 0 && download_item_state(item) == DOWNLOAD_ITEM_DONE) {
+            library_note_file(state->library, item->destination);
+            extracted = extracted || item->extract;
+        }
+    }
+
+    // Unpacked archives leave files under names of their own, only a scan finds them
+    if (extracted) library_scan(state->library, state->platforms, state->platform_count);
+}
+
+// Request the visible covers, then those just past the window in the scroll direction
+static void prefetch_covers(MenuState* state) {
+    const RomMRom* roms[MAX_VISIBLE_ITEMS + COVER_PREFETCH_AHEAD];
+    int count = 0;
+
+    if (state->view == VIEW_ROM_DETAIL) {
+        const RomMRom* rom = rom_list_get(state->roms, state->selected_index);
+        cover_store_set_window(state->covers, &rom, rom ? 1 : 0, COVER_DETAIL);
+        return;
+    }
+    if (state->view != VIEW_ROMS) {
+        cover_store_set_window(state->covers, NULL, 0, COVER_LIST);
+        return;
+    }
+
+    int rom_count = rom_list_count(state->roms);
+    for (int i = 0; i < MAX_VISIBLE_ITEMS + COVER_PREFETCH_AHEAD; i++) {
+        int index;
+        if (i < MAX_VISIBLE_ITEMS) {
+            index = state->scroll_offset + i;
+        } else if (state->scroll_direction < 0) {
+            index = state->scroll_offset - (i - MAX_VISIBLE_ITEMS + 1);
+        } else {
+            index = state->scroll_offset + i;
+        }
+        if (index < 0 || index >= rom_count) continue;
+
+        const RomMRom* rom = rom_list_get(state->roms, index);
+        if (rom) roms[count++] = rom;
+    }
+    cover_store_set_window(state->covers, roms, count, COVER_LIST);
+}
+
+static int current_item_count(MenuState* state) {
+    // The detail screen pages through the list with the d-pad
+    bool roms = state->view == VIEW_ROMS || state->view == VIEW_ROM_DETAIL;
+    return roms ? rom_list_count(state->roms) : state->platform_count;
 }
 
 void handle_input(MenuState* state, SDL_Event* event, bool* quit, bool* selected) {
+    if (event->type == SDL_KEYUP && event->key.keysym.sym == SDLK_RCTRL) {
+        state->select_held = false;
+    }
+
     if (event->type == SDL_KEYDOWN) {
         SDLKey key = event->key.keysym.sym;
+        state->notice[0] = '\0';
+
+        // Select + R1 toggles the performance overlay in every view
+        if (key == SDLK_RCTRL) {
+            state->select_held = true;
+            return;
+        }
+        if (key == SDLK_t && state->select_held) {
+            state->show_stats = !state->show_stats;
+            return;
+        }
+
+        if (state->view == VIEW_SEARCH && key != SDLK_RETURN) {
+            handle_search_input(state, key);
+            return;
+        }
+
         switch (key) {
             case SDLK_UP:    // D-pad up
                 if (state->selected_index > 0) {
                     state->selected_index--;
+                    state->scroll_direction = -1;
                     if (state->selected_index < state->scroll_offset) {
                         state->scroll_offset--;
                     }
@@ -141,8 +959,9 @@ void handle_input(MenuState* state, SDL_Event* event, bool* quit, bool* selected
                 break;
 
             case SDLK_DOWN:  // D-pad down
-                if (state->selected_index < state->platform_count - 1) {
+                if (state->selected_index < current_item_count(state) - 1) {
                     state->selected_index++;
+                    state->scroll_direction = 1;
                     if (state->selected_index >= state->scroll_offset + MAX_VISIBLE_ITEMS) {
                         state->scroll_offset++;
                     }
@@ -153,6 +972,28 @@ void handle_input(MenuState* state, SDL_Event* event, bool* quit, bool* selected
                 *selected = true;
                 break;
 
+            case SDLK_LCTRL: // B button
+                if (state->view == VIEW_ROM_DETAIL) {
+                    close_rom_detail(state);
+                } else if (state->view == VIEW_ROMS) {
+                    close_rom_list(state);
+                }
+                break;
+
+            case SDLK_LSHIFT: // X button, Select + X cancels a ROM's download
+                if (state->view == VIEW_PLATFORMS) {
+                    fetch_selected_bios(state);
+                } else if (state->view == VIEW_ROMS || state->view == VIEW_ROM_DETAIL) {
+                    control_selected_download(state, state->select_held);
+                }
+                break;
+
+            case SDLK_LALT:  // Y button
+                if (state->view == VIEW_ROMS) {
+                    open_search(state);
+                }
+                break;
+
             case SDLK_RETURN: // Start button
                 *quit = true;
                 break;
@@ -181,6 +1022,14 @@ int read_config(MenuState* state, const char* filename) {
             snprintf(state->username, 256, "%s", line + 9);
         } else if (strncmp(line, "password=", 9) == 0) {
             snprintf(state->password, 256, "%s", line + 9);
+        } else if (strncmp(line, "download_workers=", 17) == 0) {
+            state->download_workers = atoi(line + 17);
+        } else if (strncmp(line, "trace_file=", 11) == 0) {
+            snprintf(state->trace_file, sizeof(state->trace_file), "%s", line + 11);
+        } else if (strncmp(line, "extract_zip=", 12) == 0) {
+            state->extract_zip = atoi(line + 12) != 0;
+        } else if (strncmp(line, "skip_verify=", 12) == 0) {
+            state->skip_verify = atoi(line + 12) != 0;
         }
     }
 
@@ -201,35 +1050,147 @@ int main() {
         return -1;
     }
 
-    if (fetch_platform_list(state.server_url, state.username, state.password, &state.platforms, &state.platform_count) < 0) {
-        fprintf(stderr, "Failed to fetch platform list\n");
+    // Spans of the whole run go to this file, for offline analysis
+    if (state.trace_file[0]) trace_dump_open(state.trace_file);
+
+    state.session = http_session_init(state.server_url, state.username, state.password);
+    if (!state.session) {
+        fprintf(stderr, "Failed to create HTTP session\n");
+        cleanup_menu(&state);
+        return -1;
+    }
+
+    state.downloads = download_queue_init(state.session, state.download_workers, wake_main_loop, &state);
+    if (!state.downloads) {
+        fprintf(stderr, "Failed to start download queue\n");
+        cleanup_menu(&state);
+        return -1;
+    }
+
+    state.covers = cover_store_init(state.session, state.downloads, COVER_CACHE_BUDGET, wake_main_loop, &state);
+    if (!state.covers) {
+        fprintf(stderr, "Failed to create cover store\n");
+        cleanup_menu(&state);
+        return -1;
+    }
+
+    state.details = rom_detail_cache_init(state.session, wake_main_loop, &state);
+    if (!state.details) {
+        fprintf(stderr, "Failed to start detail worker\n");
+        cleanup_menu(&state);
+        return -1;
+    }
+
+    state.fetcher = fetcher_init(state.session, wake_main_loop, &state);
+    if (!state.fetcher) {
+        fprintf(stderr, "Failed to start fetch worker\n");
+        cleanup_menu(&state);
+        return -1;
+    }
+
+    state.library = library_init(wake_main_loop, &state);
+    if (!state.library) {
+        fprintf(stderr, "Failed to create local library\n");
+        cleanup_menu(&state);
+        return -1;
+    }
+
+    state.platform_arena = arena_create(0);
+    if (!state.platform_arena) {
         cleanup_menu(&state);
         return -1;
     }
 
+    // Show the cached catalog right away and revalidate it in the background. Without
+    // a cache the loop still starts at once and shows a loading state until it lands.
+    if (load_platform_list_cache(state.platform_arena, &state.platforms, &state.platform_count) != 0) {
+        state.loading = true;
+    }
+    library_scan(state.library, state.platforms, state.platform_count);
+    fetcher_refresh_platforms(state.fetcher, state.platforms, state.platform_count);
+
     bool quit = false;
     bool selected = false;
+    bool dirty = true;
     SDL_Event event;
 
-    while (!quit && !selected) {
-        state.cur_tick_count = SDL_GetTicks();
-        
+    while (!quit) {
+        // Sleep until input or a worker has something new, unless a frame is owed.
+        // The overlay is live, so while it shows the loop polls and redraws it regularly.
+        if (!dirty && state.show_stats) {
+            SDL_Delay(STATS_POLL_MS);
+            if ((int)SDL_GetTicks() - state.last_tick_count >= STATS_REFRESH_MS) dirty = true;
+        } else if (!dirty && SDL_WaitEvent(&event)) {
+            if (event.type == SDL_USEREVENT) __atomic_store_n(&state.wake_pending, 0, __ATOMIC_RELEASE);
+            handle_input(&state, &event, &quit, &selected);
+            dirty = true;
+        }
         while (SDL_PollEvent(&event)) {
+            if (event.type == SDL_USEREVENT) __atomic_store_n(&state.wake_pending, 0, __ATOMIC_RELEASE);
             handle_input(&state, &event, &quit, &selected);
+            dirty = true;
         }
 
-        // Only render if enough time has passed
-        if (state.cur_tick_count - state.last_tick_count >= (1000 / FRAME_RATE)) {
-            render_platform_list(&state);
-            state.last_tick_count = state.cur_tick_count;
-        } else {
-            SDL_Delay(1);  // Give up some CPU time
+        int refresh_result;
+        Arena* refreshed_arena = NULL;
+        RomMPlatform* refreshed = NULL;
+        int refreshed_count = 0;
+        if (fetcher_take_platforms(state.fetcher, &refresh_result, &refreshed_arena, &refreshed, &refreshed_count)) {
+            state.offline = refresh_result == CATALOG_OFFLINE;
+            if (refresh_result == CATALOG_FRESH) {
+                apply_platform_list(&state, refreshed_arena, refreshed, refreshed_count);
+            } else if (state.loading) {
+                fprintf(stderr, "Failed to fetch platform list\n");
+                state.load_failed = true;
+            }
+            state.loading = false;
         }
-    }
 
-    if (selected && state.selected_index < state.platform_count) {
-        RomMPlatform* selected_platform = &state.platforms[state.selected_index];
-        printf("Selected platform: %s\n", selected_platform->name);
+        if (library_update(state.library)) dirty = true;
+        note_finished_downloads(&state);
+
+        if (selected) {
+            selected = false;
+            if (state.load_failed && state.platform_count == 0) {
+                if (fetcher_refresh_platforms(state.fetcher, NULL, 0) == 0) {
+                    state.load_failed = false;
+                    state.loading = true;
+                }
+            } else if (state.view == VIEW_PLATFORMS) {
+                open_rom_list(&state, state.selected_index);
+            } else if (state.view == VIEW_ROMS) {
+                open_rom_detail(&state);
+            } else {
+                enqueue_selected_rom(&state);
+            }
+        }
+
+        // Keep the visible pages (and the next ones) loading in the background
+        if (state.view == VIEW_ROMS || state.view == VIEW_ROM_DETAIL) {
+            rom_list_set_window(state.roms, state.scroll_offset, MAX_VISIBLE_ITEMS, state.scroll_direction);
+        }
+        prefetch_covers(&state);
+
+        if (!dirty || quit) continue;
+
+        // Bursts of events (held d-pad, several workers) still draw at most FRAME_RATE times a second
+        state.cur_tick_count = SDL_GetTicks();
+        int frame_ms = (int)(1000 / FRAME_RATE);
+        int elapsed = state.cur_tick_count - state.last_tick_count;
+        if (elapsed < frame_ms) SDL_Delay(frame_ms - elapsed);
+
+        if (state.view == VIEW_SEARCH) {
+            render_search(&state);
+        } else if (state.view == VIEW_ROMS) {
+            render_rom_list(&state);
+        } else if (state.view == VIEW_ROM_DETAIL) {
+            render_rom_detail(&state);
+        } else {
+            render_platform_list(&state);
+        }
+        state.last_tick_count = SDL_GetTicks();
+        dirty = false;
+        trace_dump_flush();
     }
 
     cleanup_menu(&state);
@@ -0,0 +1,480 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include "SDL/SDL_image.h"
+#include "cover.h"
+#include "download.h"
+#include "response.h"
+#include "surface_cache.h"
+
+#define COVER_MAGIC "RMCV"
+#define COVER_ASSET_PREFIX "/assets/romm/resources/"
+#define COVER_MISSING_MAX 256   // Covers that failed to build, remembered so they are not retried every frame
+#define COVER_WORKER_NICE 10    // Below the UI and download threads
+#define COVER_BUSY_WAIT_SEC 1   // Recheck interval while ROM downloads hold the network
+
+// Stored thumbnail: this header followed by height rows of pitch bytes, in the
+// pixel format of the display it was built for
+typedef struct {
+    char magic[4];
+    uint16_t width;
+    uint16_t height;
+    uint16_t pitch;
+    uint8_t bits_per_pixel;
+    uint8_t reserved;
+    uint32_t rmask;
+    uint32_t gmask;
+    uint32_t bmask;
+    uint32_t amask;
+} CoverHeader;
+
+// A thumbnail the worker should produce; a copy, since list pages can be evicted meanwhile
+typedef struct {
+    char key[64];
+    int rom_id;
+    CoverSize size;
+    char source[512];
+    bool needs_build;          // Not on disk, waits for the network to be free
+} CoverRequest;
+
+// A finished request waiting for the main thread, surface is NULL on failure
+typedef struct {
+    char key[64];
+    SDL_Surface* surface;
+} CoverResult;
+
+struct CoverStore {
+    HttpSession* session;
+    DownloadQueue* downloads;
+    SDL_PixelFormat format;                     // Copy of the display's, taken on the main thread
+    SurfaceCache* memory;                       // Main thread only
+    uint32_t missing[COVER_MISSING_MAX];        // Main thread only
+    int missing_count;
+    int missing_next;
+    pthread_t thread;
+    pthread_mutex_t lock;                       // Guards everything below, never held during I/O
+    pthread_cond_t wake;
+    bool stopping;
+    CoverRequest wanted[COVER_MAX_WANTED];      // Most urgent first
+    int wanted_count;
+    char in_flight[64];                         // Key the worker is busy with
+    bool in_flight_wanted;                      // Still inside the latest window
+    CoverResult results[COVER_MAX_WANTED];
+    int result_count;
+    cover_notify_fn notify;
+    void* notify_userp;
+};
+
+static uint32_t hash_text(const char* text) {
+    uint32_t hash = 2166136261u;
+    for (const unsigned char* c = (const unsigned char*)text; *c; c++) {
+        hash ^= *c;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// Server path of the cover. The small variant already exceeds the detail box, so
+// both thumbnail sizes are scaled from it.
+static const char* cover_source(const RomMRom* rom, CoverSize size) {
+    (void)size;
+    return rom->path_cover_s;
+}
+
+static int cover_box(CoverSize size) {
+    return size == COVER_LIST ? COVER_LIST_SIZE : COVER_DETAIL_SIZE;
+}
+
+// The source path is part of the name, so a changed cover gets a new file
+static void cover_file_path(const RomMRom* rom, CoverSize size, char* path, size_t path_size) {
+    snprintf(path, path_size, "%s/%d_%c_%08x.px", COVER_CACHE_DIR, rom->id,
+             size == COVER_LIST ? 's' : 'l', hash_text(cover_source(rom, size)));
+}
+
+bool rom_cover_available(const RomMRom* rom, CoverSize size) {
+    return rom && rom->has_cover && cover_source(rom, size);
+}
+
+SDL_Surface* cover_load_cached(const RomMRom* rom, CoverSize size, const SDL_PixelFormat* format) {
+    char path[512];
+    CoverHeader header;
+
+    if (!rom_cover_available(rom, size)) return NULL;
+    cover_file_path(rom, size, path, sizeof(path));
+
+    FILE* file = fopen(path, "rb");
+    if (!file) return NULL;
+
+    // Thumbnails built for another pixel format are ignored and rebuilt
+    if (fread(&header, sizeof(header), 1, file) != 1 || memcmp(header.magic, COVER_MAGIC, 4) != 0 ||
+        header.bits_per_pixel != format->BitsPerPixel || header.rmask != format->Rmask ||
+        header.gmask != format->Gmask || header.bmask != format->Bmask || header.amask != format->Amask ||
+        header.width == 0 || header.height == 0) {
+        fclose(file);
+        return NULL;
+    }
+
+    SDL_Surface* surface = SDL_CreateRGBSurface(SDL_SWSURFACE, header.width, header.height, header.bits_per_pixel,
+                                                header.rmask, header.gmask, header.bmask, header.amask);
+    if (!surface || surface->pitch != header.pitch) {
+        if (surface) SDL_FreeSurface(surface);
+        fclose(file);
+        return NULL;
+    }
+
+    // Pixels go straight into the surface, no decode or conversion
+    size_t bytes = (size_t)header.pitch * header.height;
+    if (SDL_MUSTLOCK(surface)) SDL_LockSurface(surface);
+    size_t read = fread(surface->pixels, 1, bytes, file);
+    if (SDL_MUSTLOCK(surface)) SDL_UnlockSurface(surface);
+    fclose(file);
+
+    if (read != bytes) {
+        SDL_FreeSurface(surface);
+        return NULL;
+    }
+    return surface;
+}
+
+// Area-averaging scale between two 32-bit surfaces with 8 bits per channel
+static void scale_surface(SDL_Surface* src, SDL_Surface* dst) {
+    if (SDL_MUSTLOCK(src)) SDL_LockSurface(src);
+    if (SDL_MUSTLOCK(dst)) SDL_LockSurface(dst);
+
+    for (int y = 0; y < dst->h; y++) {
+        int sy0 = y * src->h / dst->h;
+        int sy1 = (y + 1) * src->h / dst->h;
+        if (sy1 <= sy0) sy1 = sy0 + 1;
+
+        Uint32* out = (Uint32*)((Uint8*)dst->pixels + y * dst->pitch);
+        for (int x = 0; x < dst->w; x++) {
+            int sx0 = x * src->w / dst->w;
+            int sx1 = (x + 1) * src->w / dst->w;
+            if (sx1 <= sx0) sx1 = sx0 + 1;
+
+            unsigned long r = 0, g = 0, b = 0, count = 0;
+            for (int sy = sy0; sy < sy1; sy++) {
+                const Uint32* in = (const Uint32*)((const Uint8*)src->pixels + sy * src->pitch);
+                for (int sx = sx0; sx < sx1; sx++) {
+                    r += (in[sx] >> 16) & 0xFF;
+                    g += (in[sx] >> 8) & 0xFF;
+                    b += in[sx] & 0xFF;
+                    count++;
+                }
+            }
+            out[x] = (Uint32)((r / count) << 16 | (g / count) << 8 | (b / count));
+        }
+    }
+
+    if (SDL_MUSTLOCK(dst)) SDL_UnlockSurface(dst);
+    if (SDL_MUSTLOCK(src)) SDL_UnlockSurface(src);
+}
+
+// Write a display-format surface to the cache, replacing the old file atomically
+static int store_thumbnail(const char* path, SDL_Surface* surface) {
+    char tmp_path[520];
+    CoverHeader header;
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, COVER_MAGIC, 4);
+    header.width = surface->w;
+    header.height = surface->h;
+    header.pitch = surface->pitch;
+    header.bits_per_pixel = surface->format->BitsPerPixel;
+    header.rmask = surface->format->Rmask;
+    header.gmask = surface->format->Gmask;
+    header.bmask = surface->format->Bmask;
+    header.amask = surface->format->Amask;
+
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+    if (make_parent_dirs(tmp_path) != 0) return -1;
+
+    FILE* file = fopen(tmp_path, "wb");
+    if (!file) return -1;
+
+    size_t bytes = (size_t)surface->pitch * surface->h;
+    if (SDL_MUSTLOCK(surface)) SDL_LockSurface(surface);
+    int ret = fwrite(&header, sizeof(header), 1, file) == 1 &&
+              fwrite(surface->pixels, 1, bytes, file) == bytes ? 0 : -1;
+    if (SDL_MUSTLOCK(surface)) SDL_UnlockSurface(surface);
+
+    if (fclose(file) != 0) ret = -1;
+    if (ret == 0 && rename(tmp_path, path) != 0) ret = -1;
+    if (ret != 0) unlink(tmp_path);
+    return ret;
+}
+
+int cover_build(HttpSession* session, const RomMRom* rom, CoverSize size, const SDL_PixelFormat* format) {
+    char url[1024];
+    char path[512];
+
+    if (!rom_cover_available(rom, size)) return -1;
+
+    const char* source = cover_source(rom, size);
+    while (*source == '/') source++;
+    snprintf(url, sizeof(url), "%s%s", COVER_ASSET_PREFIX, source);
+    cover_file_path(rom, size, path, sizeof(path));
+
+    Response* resp = response_init();
+    if (!resp) return -1;
+
+    int status = http_get(session, url, resp);
+    if (status != 200 || response_get_size(resp) == 0) {
+        fprintf(stderr, "Failed to fetch cover of ROM %d (HTTP status %d)\n", rom->id, status);
+        response_free(resp);
+        return -1;
+    }
+
+    SDL_RWops* rw = SDL_RWFromMem((void*)response_get_memory(resp), (int)response_get_size(resp));
+    SDL_Surface* decoded = rw ? IMG_Load_RW(rw, 1) : NULL;
+    response_free(resp);
+    if (!decoded) {
+        fprintf(stderr, "Failed to decode cover of ROM %d: %s\n", rom->id, IMG_GetError());
+        return -1;
+    }
+
+    // Fit the cover in the size's square box, keeping its aspect ratio
+    int box = cover_box(size);
+    int width = decoded->w >= decoded->h ? box : decoded->w * box / decoded->h;
+    int height = decoded->w >= decoded->h ? decoded->h * box / decoded->w : box;
+    if (width < 1) width = 1;
+    if (height < 1) height = 1;
+
+    SDL_Surface* scaled = SDL_CreateRGBSurface(SDL_SWSURFACE, width, height, 32, 0x00FF0000, 0x0000FF00, 0x000000FF, 0);
+    SDL_Surface* source_rgb = scaled ? SDL_ConvertSurface(decoded, scaled->format, SDL_SWSURFACE) : NULL;
+    SDL_FreeSurface(decoded);
+
+    SDL_Surface* native = NULL;
+    if (source_rgb) {
+        scale_surface(source_rgb, scaled);
+        native = SDL_ConvertSurface(scaled, (SDL_PixelFormat*)format, SDL_SWSURFACE);
+        SDL_FreeSurface(source_rgb);
+    }
+    if (scaled) SDL_FreeSurface(scaled);
+    if (!native) return -1;
+
+    int ret = store_thumbnail(path, native);
+    if (ret != 0) fprintf(stderr, "Failed to store cover %s\n", path);
+    SDL_FreeSurface(native);
+    return ret;
+}
+
+static void cover_key(const RomMRom* rom, CoverSize size, char* key, size_t key_size) {
+    snprintf(key, key_size, "%d|%c|%08x", rom->id, size == COVER_LIST ? 's' : 'l',
+             hash_text(cover_source(rom, size)));
+}
+
+// Most urgent request the worker may run now, called with the lock held.
+// Covers that still need downloading wait while ROM downloads are running.
+static int next_request(CoverStore* store) {
+    bool network_free = download_queue_active(store->downloads) == 0;
+
+    for (int i = 0; i < store->wanted_count; i++) {
+        if (!store->wanted[i].needs_build || network_free) return i;
+    }
+    return -1;
+}
+
+static void* cover_worker_main(void* userp) {
+    CoverStore* store = (CoverStore*)userp;
+
+#ifdef SYS_gettid
+    // Per-thread nice on Linux: image work yields to the UI and downloads
+    setpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid), COVER_WORKER_NICE);
+#endif
+
+    pthread_mutex_lock(&store->lock);
+    while (!store->stopping) {
+        int index = next_request(store);
+        if (index < 0 || store->result_count == COVER_MAX_WANTED) {
+            if (store->wanted_count > 0 && store->result_count < COVER_MAX_WANTED) {
+                // Only downloads are in the way, look again shortly
+                struct timespec deadline;
+                clock_gettime(CLOCK_REALTIME, &deadline);
+                deadline.tv_sec += COVER_BUSY_WAIT_SEC;
+                pthread_cond_timedwait(&store->wake, &store->lock, &deadline);
+            } else {
+                pthread_cond_wait(&store->wake, &store->lock);
+            }
+            continue;
+        }
+
+        CoverRequest request = store->wanted[index];
+        memmove(&store->wanted[index], &store->wanted[index + 1],
+                (store->wanted_count - index - 1) * sizeof(CoverRequest));
+        store->wanted_count--;
+        snprintf(store->in_flight, sizeof(store->in_flight), "%s", request.key);
+        store->in_flight_wanted = true;
+        pthread_mutex_unlock(&store->lock);
+
+        RomMRom rom;
+        memset(&rom, 0, sizeof(rom));
+        rom.id = request.rom_id;
+        rom.has_cover = true;
+        rom.path_cover_s = request.source;
+
+        bool deferred = false;
+        SDL_Surface* surface = cover_load_cached(&rom, request.size, &store->format);
+        if (!surface && download_queue_active(store->downloads) > 0) {
+            deferred = true;
+        } else if (!surface && cover_build(store->session, &rom, request.size, &store->format) == 0) {
+            surface = cover_load_cached(&rom, request.size, &store->format);
+        }
+
+        pthread_mutex_lock(&store->lock);
+        store->in_flight[0] = '\0';
+        if (deferred) {
+            // Back at the end of the queue unless the window has moved on meanwhile
+            request.needs_build = true;
+            if (store->in_flight_wanted && store->wanted_count < COVER_MAX_WANTED) {
+                store->wanted[store->wanted_count++] = request;
+            }
+            continue;
+        }
+
+        CoverResult* result = &store->results[store->result_count++];
+        snprintf(result->key, sizeof(result->key), "%s", request.key);
+        result->surface = surface;
+        pthread_mutex_unlock(&store->lock);
+
+        if (store->notify) store->notify(store->notify_userp);
+        pthread_mutex_lock(&store->lock);
+    }
+    pthread_mutex_unlock(&store->lock);
+    return NULL;
+}
+
+CoverStore* cover_store_init(HttpSession* session, DownloadQueue* downloads, size_t byte_budget,
+                             cover_notify_fn notify, void* userp) {
+    CoverStore* store = calloc(1, sizeof(struct CoverStore));
+    if (!store) return NULL;
+
+    store->session = session;
+    store->downloads = downloads;
+    store->notify = notify;
+    store->notify_userp = userp;
+    // The worker converts to this copy instead of calling SDL_DisplayFormat, which
+    // may allocate through the video driver while the main thread blits and flips
+    store->format = *SDL_GetVideoSurface()->format;
+    store->format.palette = NULL;
+    store->memory = surface_cache_init(byte_budget);
+    pthread_mutex_init(&store->lock, NULL);
+    pthread_cond_init(&store->wake, NULL);
+
+    if (!store->memory || pthread_create(&store->thread, NULL, cover_worker_main, store) != 0) {
+        fprintf(stderr, "Failed to start cover worker\n");
+        surface_cache_free(store->memory);
+        pthread_cond_destroy(&store->wake);
+        pthread_mutex_destroy(&store->lock);
+        free(store);
+        return NULL;
+    }
+    return store;
+}
+
+void cover_store_free(CoverStore* store) {
+    if (!store) return;
+
+    pthread_mutex_lock(&store->lock);
+    store->stopping = true;
+    pthread_cond_broadcast(&store->wake);
+    pthread_mutex_unlock(&store->lock);
+    pthread_join(store->thread, NULL);
+
+    for (int i = 0; i < store->result_count; i++) {
+        if (store->results[i].surface) SDL_FreeSurface(store->results[i].surface);
+    }
+    surface_cache_free(store->memory);
+    pthread_cond_destroy(&store->wake);
+    pthread_mutex_destroy(&store->lock);
+    free(store);
+}
+
+static bool is_missing(const CoverStore* store, uint32_t key_hash) {
+    for (int i = 0; i < store->missing_count; i++) {
+        if (store->missing[i] == key_hash) return true;
+    }
+    return false;
+}
+
+static void mark_missing(CoverStore* store, uint32_t key_hash) {
+    store->missing[store->missing_next] = key_hash;
+    store->missing_next = (store->missing_next + 1) % COVER_MISSING_MAX;
+    if (store->missing_count < COVER_MISSING_MAX) store->missing_count++;
+}
+
+// Move finished thumbnails into the memory cache, called with the lock held
+static void collect_results(CoverStore* store) {
+    for (int i = 0; i < store->result_count; i++) {
+        CoverResult* result = &store->results[i];
+        if (result->surface) {
+            surface_cache_put(store->memory, result->key, result->surface);
+        } else {
+            mark_missing(store, hash_text(result->key));
+        }
+    }
+    store->result_count = 0;
+}
+
+static const CoverRequest* find_request(const CoverRequest* requests, int count, const char* key) {
+    for (int i = 0; i < count; i++) {
+        if (strcmp(requests[i].key, key) == 0) return &requests[i];
+    }
+    return NULL;
+}
+
+void cover_store_set_window(CoverStore* store, const RomMRom* const* roms, int count, CoverSize size) {
+    CoverRequest wanted[COVER_MAX_WANTED];
+    int wanted_count = 0;
+
+    if (!store) return;
+
+    pthread_mutex_lock(&store->lock);
+    collect_results(store);
+    store->in_flight_wanted = false;
+
+    for (int i = 0; i < count && wanted_count < COVER_MAX_WANTED; i++) {
+        const RomMRom* rom = roms[i];
+        if (!rom_cover_available(rom, size) || strlen(cover_source(rom, size)) >= sizeof(wanted[0].source)) continue;
+
+        CoverRequest* request = &wanted[wanted_count];
+        cover_key(rom, size, request->key, sizeof(request->key));
+        if (strcmp(store->in_flight, request->key) == 0) {
+            store->in_flight_wanted = true;
+            continue;
+        }
+        if (surface_cache_get(store->memory, request->key) || is_missing(store, hash_text(request->key)) ||
+            find_request(wanted, wanted_count, request->key)) {
+            continue;
+        }
+
+        // Keep what the worker already learned about requests that are still wanted
+        const CoverRequest* previous = find_request(store->wanted, store->wanted_count, request->key);
+        request->rom_id = rom->id;
+        request->size = size;
+        snprintf(request->source, sizeof(request->source), "%s", cover_source(rom, size));
+        request->needs_build = previous ? previous->needs_build : false;
+        wanted_count++;
+    }
+
+    // Requests outside the new window are dropped, the worker only finishes the one in flight
+    memcpy(store->wanted, wanted, wanted_count * sizeof(CoverRequest));
+    store->wanted_count = wanted_count;
+    if (wanted_count > 0) pthread_cond_signal(&store->wake);
+    pthread_mutex_unlock(&store->lock);
+}
+
+SDL_Surface* cover_store_get(CoverStore* store, const RomMRom* rom, CoverSize size) {
+    char key[64];
+
+    if (!store || !rom_cover_available(rom, size)) return NULL;
+
+    cover_key(rom, size, key, sizeof(key));
+    return surface_cache_get(store->memory, key);
+}
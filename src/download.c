@@ -0,0 +1,477 @@
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include "download.h"
+#include "hash.h"
+#include "unzip.h"
+#include "file_writer.h"
+
+#define DOWNLOAD_PROGRESS_INTERVAL_MS 250
+#define DOWNLOAD_RATE_SMOOTHING 0.3         // Weight of the newest rate sample
+#define DOWNLOAD_MAX_ATTEMPTS 3             // Later attempts restart from zero after a bad range or hash mismatch
+#define HASH_STATE_MAGIC "RMHS"
+
+typedef struct {
+    FileWriter* writer;             // Receiving thread hands chunks over, a writer thread does the I/O
+    long long offset;               // Bytes already on disk when the request started
+    int status;                     // Status code of the last response line seen
+    long long range_total;          // Total size from "Content-Range: bytes */N", 0 if absent
+    long long range_start;          // First byte from "Content-Range: bytes START-END/N", -1 if absent
+    bool range_mismatch;            // A 206 body started elsewhere than the partial file ends
+    long long content_length;       // Body size of the current response, 0 if absent
+    bool reserved;                  // Space for the whole file was requested
+    bool write_failed;
+    bool cancelled;
+    bool hashing;                   // Expected hashes given, hash holds every byte in the file
+    HashState hash;
+    ZipExtractor* extractor;        // Set for archives: bytes are extracted instead of written to file
+    long long received;             // Archive bytes fed to the extractor
+    download_progress_fn on_progress;
+    void* userp;
+    double last_report_ms;
+    long long last_report_bytes;
+    double bytes_per_sec;
+} DownloadContext;
+
+static double now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+// Create every missing directory above path
+int make_parent_dirs(const char* path) {
+    char buffer[1024];
+    snprintf(buffer, sizeof(buffer), "%s", path);
+
+    for (char* p = buffer + 1; *p; p++) {
+        if (*p != '/') continue;
+        *p = '\0';
+        if (mkdir(buffer, 0755) != 0 && errno != EEXIST) {
+            fprintf(stderr, "Failed to create directory %s: %s\n", buffer, strerror(errno));
+            return -1;
+        }
+        *p = '/';
+    }
+    return 0;
+}
+
+static size_t download_header_callback(char* buffer, size_t size, size_t nitems, void* userp) {
+    size_t realsize = size * nitems;
+    DownloadContext* ctx = (DownloadContext*)userp;
+    char line[128];
+
+    size_t len = realsize < sizeof(line) - 1 ? realsize : sizeof(line) - 1;
+    memcpy(line, buffer, len);
+    line[len] = '\0';
+
+    // A new status line starts every response, including redirects
+    int status;
+    long long total;
+    if (sscanf(line, "HTTP/%*s %d", &status) == 1) {
+        ctx->status = status;
+        ctx->range_total = 0;
+        ctx->range_start = -1;
+        ctx->content_length = 0;
+    } else if (strncasecmp(line, "Content-Length:", 15) == 0 && sscanf(line + 15, "%lld", &total) == 1) {
+        ctx->content_length = total;
+    } else if (strncasecmp(line, "Content-Range: bytes */", 23) == 0 && sscanf(line + 23, "%lld", &total) == 1) {
+        ctx->range_total = total;
+    } else if (strncasecmp(line, "Content-Range: bytes ", 21) == 0 && sscanf(line + 21, "%lld-", &total) == 1) {
+        ctx->range_start = total;
+    }
+    return realsize;
+}
+
+static size_t download_write_callback(void* contents, size_t size, size_t nmemb, void* userp) {
+    size_t realsize = size * nmemb;
+    DownloadContext* ctx = (DownloadContext*)userp;
+
+    // Error bodies and redirect payloads never reach the file
+    if (ctx->status != 200 && ctx->status != 206) {
+        return realsize;
+    }
+
+    // A range that does not continue the partial file would be appended at the wrong
+    // offset; a proxy answering from byte 0 is taken like a 200, anything else retried
+    if (ctx->status == 206 && ctx->range_start >= 0 && ctx->range_start != ctx->offset && ctx->range_start != 0) {
+        ctx->range_mismatch = true;
+        return 0;
+    }
+
+    // The server ignored the Range header and is sending the whole file again
+    bool from_start = ctx->status == 200 || (ctx->status == 206 && ctx->range_start == 0);
+    if (from_start && ctx->offset > 0 && ctx->writer) {
+        if (file_writer_restart(ctx->writer) != 0) {
+            ctx->write_failed = true;
+            return 0;
+        }
+        ctx->offset = 0;
+        ctx->reserved = false;
+        if (ctx->hashing) hash_init(&ctx->hash, ctx->hash.flags);
+    }
+
+    // The body length is known with the first chunk: reserve the rest of the file in one go
+    if (ctx->writer && !ctx->reserved && ctx->content_length > 0) {
+        file_writer_reserve(ctx->writer, ctx->offset + ctx->content_length);
+        ctx->reserved = true;
+    }
+
+    if (ctx->extractor) {
+        if (zip_extractor_feed(ctx->extractor, contents, realsize) != 0) {
+            ctx->write_failed = true;
+            return 0;
+        }
+        ctx->received += (long long)realsize;
+    } else if (file_writer_write(ctx->writer, contents, realsize) != 0) {
+        ctx->write_failed = true;
+        return 0;
+    }
+
+    // Hash the chunk while it is still in cache, the file is never read back
+    if (ctx->hashing) hash_update(&ctx->hash, contents, realsize);
+    return realsize;
+}
+
+static int report_progress(DownloadContext* ctx, long long dltotal, long long dlnow, bool final) {
+    if (!ctx->on_progress) return 0;
+
+    double now = now_ms();
+    double elapsed = now - ctx->last_report_ms;
+    if (!final && elapsed < DOWNLOAD_PROGRESS_INTERVAL_MS) return 0;
+
+    if (elapsed > 0 && dlnow >= ctx->last_report_bytes) {
+        double sample = (dlnow - ctx->last_report_bytes) * 1000.0 / elapsed;
+        ctx->bytes_per_sec = ctx->bytes_per_sec > 0
+            ? ctx->bytes_per_sec + DOWNLOAD_RATE_SMOOTHING * (sample - ctx->bytes_per_sec)
+            : sample;
+    }
+    ctx->last_report_ms = now;
+    ctx->last_report_bytes = dlnow;
+
+    DownloadProgress progress;
+    progress.bytes_done = (unsigned long long)(ctx->offset + dlnow);
+    progress.bytes_total = dltotal > 0 ? (unsigned long long)(ctx->offset + dltotal) : 0;
+    progress.bytes_per_sec = ctx->bytes_per_sec;
+    progress.eta_seconds = -1;
+    if (final) {
+        progress.eta_seconds = 0;
+    } else if (progress.bytes_total > 0 && ctx->bytes_per_sec > 0) {
+        progress.eta_seconds = (int)((progress.bytes_total - progress.bytes_done) / ctx->bytes_per_sec);
+    }
+
+    if (ctx->on_progress(&progress, ctx->userp) != 0) {
+        ctx->cancelled = true;
+        return 1;
+    }
+    return 0;
+}
+
+static int download_progress_callback(void* userp, long long dltotal, long long dlnow) {
+    DownloadContext* ctx = (DownloadContext*)userp;
+    if (ctx->status != 200 && ctx->status != 206) return 0;
+    return report_progress(ctx, dltotal, dlnow, false);
+}
+
+static long long file_size(const char* path) {
+    struct stat st;
+    if (stat(path, &st) != 0) return 0;
+    return (long long)st.st_size;
+}
+
+static void hash_state_path(const char* destination, char* path, size_t path_size) {
+    snprintf(path, path_size, "%s.part.hash", destination);
+}
+
+void download_discard_partial(const char* destination) {
+    char path[1024];
+    snprintf(path, sizeof(path), "%s.part", destination);
+    unlink(path);
+    hash_state_path(destination, path, sizeof(path));
+    unlink(path);
+}
+
+// Keep the hash state next to a partial file so resuming does not have to reread it
+static void save_hash_state(const char* path, const HashState* state) {
+    FILE* file = fopen(path, "wb");
+    if (!file) return;
+
+    if (fwrite(HASH_STATE_MAGIC, 1, 4, file) != 4 || fwrite(state, sizeof(HashState), 1, file) != 1) {
+        fclose(file);
+        unlink(path);
+        return;
+    }
+    if (fclose(file) != 0) unlink(path);
+}
+
+// Hash state covering the first offset bytes of the partial file. Uses the saved
+// state when it matches; otherwise (crash, older partial) hashes the bytes on disk.
+static int resume_hash_state(const char* part_path, const char* state_path, long long offset,
+                             unsigned int flags, HashState* state) {
+    char magic[4];
+    FILE* file = fopen(state_path, "rb");
+    if (file) {
+        bool loaded = fread(magic, 1, 4, file) == 4 && memcmp(magic, HASH_STATE_MAGIC, 4) == 0 &&
+                      fread(state, sizeof(HashState), 1, file) == 1;
+        fclose(file);
+        if (loaded && state->flags == flags && state->length == (uint64_t)offset) return 0;
+    }
+
+    hash_init(state, flags);
+    if (offset == 0) return 0;
+
+    file = fopen(part_path, "rb");
+    if (!file) return -1;
+
+    char chunk[64 * 1024];
+    size_t read;
+    while ((read = fread(chunk, 1, sizeof(chunk), file)) > 0) {
+        hash_update(state, chunk, read);
+    }
+    fclose(file);
+    return state->length == (uint64_t)offset ? 0 : -1;
+}
+
+static unsigned int expected_hash_flags(const DownloadHashes* expected) {
+    unsigned int flags = 0;
+    if (!expected) return 0;
+    if (expected->crc32 && *expected->crc32) flags |= HASH_CRC32;
+    if (expected->md5 && *expected->md5) flags |= HASH_MD5;
+    if (expected->sha1 && *expected->sha1) flags |= HASH_SHA1;
+    return flags;
+}
+
+bool download_file_matches(const char* path, unsigned long long size, const DownloadHashes* expected) {
+    struct stat st;
+    if (stat(path, &st) != 0 || !S_ISREG(st.st_mode)) return false;
+    if (size > 0 && (unsigned long long)st.st_size != size) return false;
+
+    unsigned int flags = expected_hash_flags(expected);
+    if (!flags) return size > 0;
+
+    FILE* file = fopen(path, "rb");
+    if (!file) return false;
+
+    HashState state;
+    HashDigest digest;
+    char chunk[64 * 1024];
+    size_t read;
+    hash_init(&state, flags);
+    while ((read = fread(chunk, 1, sizeof(chunk), file)) > 0) {
+        hash_update(&state, chunk, read);
+    }
+    bool failed = ferror(file) != 0;
+    fclose(file);
+    if (failed) return false;
+
+    hash_final(&state, &digest);
+    return hash_verify(&digest, flags, expected->crc32, expected->md5, expected->sha1) == 0;
+}
+
+int download_file(HttpSession* session, const char* url, const char* destination,
+                  const DownloadHashes* expected, download_progress_fn on_progress, void* userp) {
+    if (!session || !url || !destination) return DOWNLOAD_ERROR;
+
+    char part_path[1024];
+    char state_path[1024];
+    snprintf(part_path, sizeof(part_path), "%s.part", destination);
+    hash_state_path(destination, state_path, sizeof(state_path));
+    unsigned int hash_flags = expected_hash_flags(expected);
+
+    if (make_parent_dirs(destination) != 0) return DOWNLOAD_ERROR;
+
+    int result = DOWNLOAD_ERROR;
+    for (int attempt = 0; attempt < DOWNLOAD_MAX_ATTEMPTS; attempt++) {
+        result = DOWNLOAD_ERROR;
+        DownloadContext ctx;
+        memset(&ctx, 0, sizeof(ctx));
+        ctx.offset = file_size(part_path);
+        ctx.range_start = -1;
+        ctx.on_progress = on_progress;
+        ctx.userp = userp;
+        ctx.last_report_ms = now_ms();
+
+        ctx.hashing = hash_flags != 0;
+        if (ctx.hashing && resume_hash_state(part_path, state_path, ctx.offset, hash_flags, &ctx.hash) != 0) {
+            download_discard_partial(destination);
+            ctx.offset = 0;
+            hash_init(&ctx.hash, hash_flags);
+        }
+
+        // Fixed ring of write buffers: memory use does not depend on the file size
+        ctx.writer = file_writer_open(part_path, ctx.offset);
+        if (!ctx.writer) break;
+
+        HttpRequest request = {
+            .path = url,
+            .range_start = ctx.offset,
+            .write_fn = download_write_callback,
+            .write_userp = &ctx,
+            .header_fn = download_header_callback,
+            .header_userp = &ctx,
+            .progress_fn = download_progress_callback,
+            .progress_userp = &ctx,
+        };
+        int status = http_request(session, &request);
+
+        // Synced only once every byte arrived, a partial file never pays for it
+        bool received = !ctx.cancelled && !ctx.write_failed && (status == 200 || status == 206);
+        if (file_writer_close(ctx.writer, received) != 0) {
+            ctx.write_failed = true;
+        }
+        if (ctx.hashing && !ctx.write_failed) {
+            save_hash_state(state_path, &ctx.hash);
+        }
+
+        if (ctx.cancelled) {
+            result = DOWNLOAD_CANCELLED;
+            break;
+        }
+        if (ctx.range_mismatch) {
+            fprintf(stderr, "Server resumed %s at the wrong offset, restarting\n", destination);
+            download_discard_partial(destination);
+            continue;
+        }
+        if (ctx.write_failed) {
+            break;
+        }
+
+        if (status == 416) {
+            // Nothing left to fetch when the partial file already has every byte
+            if (ctx.range_total > 0 && ctx.offset == ctx.range_total) {
+                status = 206;
+            } else {
+                fprintf(stderr, "Partial download of %s is stale, restarting\n", destination);
+                download_discard_partial(destination);
+                continue;
+            }
+        }
+
+        if (status != 200 && status != 206) {
+            fprintf(stderr, "Download of %s failed (HTTP status %d)\n", url, status);
+            break;
+        }
+
+        long long total = file_size(part_path);
+
+        if (ctx.hashing) {
+            HashDigest digest;
+            hash_final(&ctx.hash, &digest);
+            if (ctx.hash.length != (uint64_t)total ||
+                hash_verify(&digest, hash_flags, expected->crc32, expected->md5, expected->sha1) != 0) {
+                fprintf(stderr, "Download of %s failed verification, downloading it again\n", destination);
+                download_discard_partial(destination);
+                result = DOWNLOAD_CORRUPT;
+                continue;
+            }
+            unlink(state_path);
+        }
+
+        report_progress(&ctx, total - ctx.offset, total - ctx.offset, true);
+
+        if (rename(part_path, destination) != 0) {
+            fprintf(stderr, "Failed to move %s into place: %s\n", destination, strerror(errno));
+            break;
+        }
+        result = DOWNLOAD_OK;
+        break;
+    }
+
+    return result;
+}
+
+int download_archive(HttpSession* session, const char* url, const char* destination,
+                     const DownloadHashes* expected, download_progress_fn on_progress, void* userp) {
+    if (!session || !url || !destination) return DOWNLOAD_ERROR;
+
+    char directory[1024];
+    snprintf(directory, sizeof(directory), "%s", destination);
+    char* slash = strrchr(directory, '/');
+    if (slash && slash != directory) {
+        *slash = '\0';
+    } else {
+        snprintf(directory, sizeof(directory), slash ? "/" : ".");
+    }
+    unsigned int hash_flags = expected_hash_flags(expected);
+
+    int result = DOWNLOAD_ERROR;
+    for (int attempt = 0; attempt < DOWNLOAD_MAX_ATTEMPTS; attempt++) {
+        result = DOWNLOAD_ERROR;
+        DownloadContext ctx;
+        memset(&ctx, 0, sizeof(ctx));
+        ctx.on_progress = on_progress;
+        ctx.userp = userp;
+        ctx.last_report_ms = now_ms();
+        ctx.hashing = hash_flags != 0;
+        if (ctx.hashing) hash_init(&ctx.hash, hash_flags);
+
+        // No partial archive is kept, so every attempt starts from the first byte
+        ctx.extractor = zip_extractor_init(directory);
+        if (!ctx.extractor) {
+            fprintf(stderr, "Failed to start extracting into %s\n", directory);
+            break;
+        }
+
+        HttpRequest request = {
+            .path = url,
+            .write_fn = download_write_callback,
+            .write_userp = &ctx,
+            .header_fn = download_header_callback,
+            .header_userp = &ctx,
+            .progress_fn = download_progress_callback,
+            .progress_userp = &ctx,
+        };
+        int status = http_request(session, &request);
+
+        bool complete = !ctx.cancelled && !ctx.write_failed && (status == 200 || status == 206) &&
+                        zip_extractor_finish(ctx.extractor) == 0;
+        bool verified = complete;
+        if (complete && ctx.hashing) {
+            HashDigest digest;
+            hash_final(&ctx.hash, &digest);
+            verified = hash_verify(&digest, hash_flags, expected->crc32, expected->md5, expected->sha1) == 0;
+        }
+        // Entries replace files already on the card only once the whole archive checked out
+        bool committed = verified && zip_extractor_commit(ctx.extractor) == 0;
+        if (!verified) zip_extractor_discard(ctx.extractor);
+        zip_extractor_free(ctx.extractor);
+
+        if (ctx.cancelled) {
+            result = DOWNLOAD_CANCELLED;
+            break;
+        }
+        if (ctx.write_failed) {
+            break;
+        }
+        // A dropped connection (no status) is a cut-short archive like a truncated body
+        if (status >= 0 && status != 200 && status != 206) {
+            fprintf(stderr, "Download of %s failed (HTTP status %d)\n", url, status);
+            break;
+        }
+        if (!complete) {
+            fprintf(stderr, "Archive %s was cut short, downloading it again\n", url);
+            continue;
+        }
+        if (!verified) {
+            fprintf(stderr, "Archive %s failed verification, downloading it again\n", url);
+            result = DOWNLOAD_CORRUPT;
+            continue;
+        }
+        if (!committed) {
+            break;
+        }
+
+        report_progress(&ctx, ctx.received, ctx.received, true);
+        result = DOWNLOAD_OK;
+        break;
+    }
+
+    return result;
+}
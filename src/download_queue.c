@@ -0,0 +1,340 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <pthread.h>
+#include "download_queue.h"
+
+// Values of DownloadItem.control
+#define CONTROL_NONE 0
+#define CONTROL_PAUSE 1
+#define CONTROL_CANCEL 2
+
+struct DownloadQueue {
+    HttpSession* session;
+    pthread_mutex_t lock;       // Guards the item array and queued/paused transitions
+    pthread_cond_t wake;
+    pthread_t workers[DOWNLOAD_QUEUE_MAX_WORKERS];
+    int worker_count;
+    bool stopping;
+    DownloadItem** items;
+    int item_count;             // Read without the lock by the main thread
+    int item_capacity;
+    unsigned int generation;    // Bumped on every visible change
+    int active;                 // Transfers running, read from any thread
+    download_queue_notify_fn notify;
+    void* notify_userp;
+};
+
+static void touch(DownloadQueue* queue) {
+    __atomic_add_fetch(&queue->generation, 1, __ATOMIC_RELEASE);
+    if (queue->notify) queue->notify(queue->notify_userp);
+}
+
+static void set_state(DownloadQueue* queue, DownloadItem* item, DownloadItemState state) {
+    __atomic_store_n(&item->state, (int)state, __ATOMIC_RELEASE);
+    touch(queue);
+}
+
+static void free_item(DownloadItem* item) {
+    free(item->name);
+    free(item->url);
+    free(item->destination);
+    free(item->crc_hash);
+    free(item->md5_hash);
+    free(item->sha1_hash);
+    free(item);
+}
+
+static char* strdup_nullable(const char* text) {
+    return text ? strdup(text) : NULL;
+}
+
+typedef struct {
+    DownloadQueue* queue;
+    DownloadItem* item;
+} WorkerContext;
+
+static int on_item_progress(const DownloadProgress* progress, void* userp) {
+    WorkerContext* ctx = (WorkerContext*)userp;
+    DownloadItem* item = ctx->item;
+
+    __atomic_store_n(&item->bytes_done, progress->bytes_done, __ATOMIC_RELAXED);
+    __atomic_store_n(&item->bytes_total, progress->bytes_total, __ATOMIC_RELAXED);
+    __atomic_store_n(&item->bytes_per_sec, (unsigned int)progress->bytes_per_sec, __ATOMIC_RELAXED);
+    __atomic_store_n(&item->eta_seconds, progress->eta_seconds, __ATOMIC_RELAXED);
+    touch(ctx->queue);
+
+    return __atomic_load_n(&item->control, __ATOMIC_ACQUIRE) != CONTROL_NONE;
+}
+
+// Oldest queued item, called with the lock held
+static DownloadItem* next_queued(DownloadQueue* queue) {
+    for (int i = 0; i < queue->item_count; i++) {
+        if (queue->items[i]->state == DOWNLOAD_ITEM_QUEUED) return queue->items[i];
+    }
+    return NULL;
+}
+
+static void* worker_main(void* userp) {
+    DownloadQueue* queue = (DownloadQueue*)userp;
+
+    pthread_mutex_lock(&queue->lock);
+    while (!queue->stopping) {
+        DownloadItem* item = next_queued(queue);
+        if (!item) {
+            pthread_cond_wait(&queue->wake, &queue->lock);
+            continue;
+        }
+
+        __atomic_store_n(&item->control, CONTROL_NONE, __ATOMIC_RELEASE);
+        set_state(queue, item, DOWNLOAD_ITEM_ACTIVE);
+        __atomic_add_fetch(&queue->active, 1, __ATOMIC_RELEASE);
+        pthread_mutex_unlock(&queue->lock);
+
+        // Files already on the card with the right size and digests are not fetched again
+        WorkerContext ctx = { queue, item };
+        DownloadHashes hashes = { item->crc_hash, item->md5_hash, item->sha1_hash };
+        int result;
+        if (item->extract) {
+            result = download_archive(queue->session, item->url, item->destination, &hashes, on_item_progress, &ctx);
+        } else if (download_file_matches(item->destination, item->file_size, &hashes)) {
+            result = DOWNLOAD_OK;
+        } else {
+            result = download_file(queue->session, item->url, item->destination, &hashes, on_item_progress, &ctx);
+        }
+        __atomic_sub_fetch(&queue->active, 1, __ATOMIC_RELEASE);
+
+        pthread_mutex_lock(&queue->lock);
+        if (result == DOWNLOAD_OK) {
+            set_state(queue, item, DOWNLOAD_ITEM_DONE);
+        } else if (result == DOWNLOAD_CANCELLED &&
+                   __atomic_load_n(&item->control, __ATOMIC_ACQUIRE) == CONTROL_PAUSE) {
+            set_state(queue, item, DOWNLOAD_ITEM_PAUSED);
+        } else if (result == DOWNLOAD_CANCELLED) {
+            download_discard_partial(item->destination);
+            set_state(queue, item, DOWNLOAD_ITEM_CANCELLED);
+        } else {
+            set_state(queue, item, DOWNLOAD_ITEM_FAILED);
+        }
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return NULL;
+}
+
+DownloadQueue* download_queue_init(HttpSession* session, int max_workers,
+                                   download_queue_notify_fn notify, void* userp) {
+    DownloadQueue* queue = calloc(1, sizeof(struct DownloadQueue));
+    if (!queue) return NULL;
+
+    if (max_workers < 1) max_workers = DOWNLOAD_QUEUE_DEFAULT_WORKERS;
+    if (max_workers > DOWNLOAD_QUEUE_MAX_WORKERS) max_workers = DOWNLOAD_QUEUE_MAX_WORKERS;
+
+    queue->session = session;
+    queue->notify = notify;
+    queue->notify_userp = userp;
+    pthread_mutex_init(&queue->lock, NULL);
+    pthread_cond_init(&queue->wake, NULL);
+
+    for (int i = 0; i < max_workers; i++) {
+        if (pthread_create(&queue->workers[i], NULL, worker_main, queue) != 0) {
+            fprintf(stderr, "Failed to start download worker %d\n", i);
+            break;
+        }
+        queue->worker_count++;
+    }
+
+    if (queue->worker_count == 0) {
+        download_queue_free(queue);
+        return NULL;
+    }
+    return queue;
+}
+
+void download_queue_free(DownloadQueue* queue) {
+    if (!queue) return;
+
+    // Active transfers stop like a pause, so their partial files resume next time
+    pthread_mutex_lock(&queue->lock);
+    queue->stopping = true;
+    for (int i = 0; i < queue->item_count; i++) {
+        __atomic_store_n(&queue->items[i]->control, CONTROL_PAUSE, __ATOMIC_RELEASE);
+    }
+    pthread_cond_broadcast(&queue->wake);
+    pthread_mutex_unlock(&queue->lock);
+
+    for (int i = 0; i < queue->worker_count; i++) {
+        pthread_join(queue->workers[i], NULL);
+    }
+
+    for (int i = 0; i < queue->item_count; i++) {
+        free_item(queue->items[i]);
+    }
+    free(queue->items);
+
+    pthread_cond_destroy(&queue->wake);
+    pthread_mutex_destroy(&queue->lock);
+    free(queue);
+}
+
+// Append an item, taking ownership of url. An unfinished item for the same
+// destination is reused instead, so repeated requests never download twice.
+static int add_item(DownloadQueue* queue, int rom_id, const char* name, char* url, const char* destination,
+                    unsigned long long file_size, const DownloadHashes* hashes, bool extract) {
+    DownloadItem* item = calloc(1, sizeof(DownloadItem));
+    if (!item) {
+        free(url);
+        return -1;
+    }
+
+    item->rom_id = rom_id;
+    item->name = strdup(name);
+    item->url = url;
+    item->destination = strdup(destination);
+    item->file_size = file_size;
+    item->extract = extract;
+    item->state = DOWNLOAD_ITEM_QUEUED;
+    item->eta_seconds = -1;
+    if (hashes) {
+        item->crc_hash = strdup_nullable(hashes->crc32);
+        item->md5_hash = strdup_nullable(hashes->md5);
+        item->sha1_hash = strdup_nullable(hashes->sha1);
+    }
+    if (!item->name || !item->url || !item->destination) {
+        free_item(item);
+        return -1;
+    }
+
+    pthread_mutex_lock(&queue->lock);
+    for (int i = 0; i < queue->item_count; i++) {
+        DownloadItem* existing = queue->items[i];
+        if ((existing->state == DOWNLOAD_ITEM_QUEUED || existing->state == DOWNLOAD_ITEM_ACTIVE) &&
+            strcmp(existing->destination, item->destination) == 0) {
+            pthread_mutex_unlock(&queue->lock);
+            free_item(item);
+            return existing->id;
+        }
+    }
+
+    if (queue->item_count == queue->item_capacity) {
+        int new_capacity = queue->item_capacity ? queue->item_capacity * 2 : 16;
+        DownloadItem** new_items = realloc(queue->items, new_capacity * sizeof(DownloadItem*));
+        if (!new_items) {
+            pthread_mutex_unlock(&queue->lock);
+            free_item(item);
+            return -1;
+        }
+        queue->items = new_items;
+        queue->item_capacity = new_capacity;
+    }
+
+    item->id = queue->item_count;
+    queue->items[item->id] = item;
+    __atomic_store_n(&queue->item_count, queue->item_count + 1, __ATOMIC_RELEASE);
+    pthread_cond_signal(&queue->wake);
+    pthread_mutex_unlock(&queue->lock);
+
+    touch(queue);
+    return item->id;
+}
+
+int download_queue_add(DownloadQueue* queue, const RomMRom* rom, const RomMRomDetail* detail, const char* destination,
+                       bool extract) {
+    if (!queue || !rom || !destination) return -1;
+
+    DownloadHashes hashes;
+    rom_hashes(rom, detail, &hashes);
+    return add_item(queue, rom->id, rom->name ? rom->name : rom->file_name, rom_content_url(rom), destination,
+                    rom->multi ? 0 : rom->file_size_bytes, &hashes, extract && rom_is_zip(rom));
+}
+
+int download_queue_add_file(DownloadQueue* queue, const char* name, const char* url, const char* destination,
+                            unsigned long long file_size, const DownloadHashes* hashes) {
+    if (!queue || !name || !url || !destination) return -1;
+
+    return add_item(queue, -1, name, strdup(url), destination, file_size, hashes, false);
+}
+
+static DownloadItem* find_item(DownloadQueue* queue, int item_id) {
+    if (!queue || item_id < 0 || item_id >= queue->item_count) return NULL;
+    return queue->items[item_id];
+}
+
+int download_queue_pause(DownloadQueue* queue, int item_id) {
+    DownloadItem* item = find_item(queue, item_id);
+    if (!item) return -1;
+
+    int ret = 0;
+    pthread_mutex_lock(&queue->lock);
+    if (item->state == DOWNLOAD_ITEM_QUEUED) {
+        set_state(queue, item, DOWNLOAD_ITEM_PAUSED);
+    } else if (item->state == DOWNLOAD_ITEM_ACTIVE) {
+        __atomic_store_n(&item->control, CONTROL_PAUSE, __ATOMIC_RELEASE);
+    } else {
+        ret = -1;
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return ret;
+}
+
+int download_queue_resume(DownloadQueue* queue, int item_id) {
+    DownloadItem* item = find_item(queue, item_id);
+    if (!item) return -1;
+
+    int ret = 0;
+    pthread_mutex_lock(&queue->lock);
+    if (item->state == DOWNLOAD_ITEM_PAUSED || item->state == DOWNLOAD_ITEM_FAILED) {
+        set_state(queue, item, DOWNLOAD_ITEM_QUEUED);
+        pthread_cond_signal(&queue->wake);
+    } else {
+        ret = -1;
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return ret;
+}
+
+int download_queue_cancel(DownloadQueue* queue, int item_id) {
+    DownloadItem* item = find_item(queue, item_id);
+    if (!item) return -1;
+
+    int ret = 0;
+    pthread_mutex_lock(&queue->lock);
+    if (item->state == DOWNLOAD_ITEM_ACTIVE) {
+        __atomic_store_n(&item->control, CONTROL_CANCEL, __ATOMIC_RELEASE);
+    } else if (item->state == DOWNLOAD_ITEM_QUEUED || item->state == DOWNLOAD_ITEM_PAUSED ||
+               item->state == DOWNLOAD_ITEM_FAILED) {
+        download_discard_partial(item->destination);
+        set_state(queue, item, DOWNLOAD_ITEM_CANCELLED);
+    } else {
+        ret = -1;
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return ret;
+}
+
+int download_queue_count(DownloadQueue* queue) {
+    return queue ? __atomic_load_n(&queue->item_count, __ATOMIC_ACQUIRE) : 0;
+}
+
+const DownloadItem* download_queue_get(DownloadQueue* queue, int index) {
+    if (!queue || index < 0 || index >= download_queue_count(queue)) return NULL;
+    return queue->items[index];
+}
+
+unsigned int download_queue_generation(DownloadQueue* queue) {
+    return queue ? __atomic_load_n(&queue->generation, __ATOMIC_ACQUIRE) : 0;
+}
+
+DownloadItemState download_item_state(const DownloadItem* item) {
+    return (DownloadItemState)__atomic_load_n(&item->state, __ATOMIC_ACQUIRE);
+}
+
+void download_item_progress(const DownloadItem* item, DownloadProgress* progress) {
+    progress->bytes_done = __atomic_load_n(&item->bytes_done, __ATOMIC_RELAXED);
+    progress->bytes_total = __atomic_load_n(&item->bytes_total, __ATOMIC_RELAXED);
+    progress->bytes_per_sec = __atomic_load_n(&item->bytes_per_sec, __ATOMIC_RELAXED);
+    progress->eta_seconds = __atomic_load_n(&item->eta_seconds, __ATOMIC_RELAXED);
+}
+
+int download_queue_active(DownloadQueue* queue) {
+    return queue ? __atomic_load_n(&queue->active, __ATOMIC_ACQUIRE) : 0;
+}
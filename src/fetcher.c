@@ -0,0 +1,144 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <pthread.h>
+#include "fetcher.h"
+#include "catalog.h"
+
+enum {
+    JOB_NONE,
+    JOB_PENDING,   // Waiting for the worker
+    JOB_RUNNING,
+    JOB_FINISHED   // Result waiting for the main thread
+};
+
+struct Fetcher {
+    HttpSession* session;
+    pthread_t thread;
+    pthread_mutex_t lock;        // Guards the job fields, never held during I/O
+    pthread_cond_t wake;
+    bool stopping;
+    int job;
+    const RomMPlatform* current;
+    int current_count;
+    int result;
+    Arena* arena;                // Owns platforms
+    RomMPlatform* platforms;
+    int platform_count;
+    fetcher_notify_fn notify;
+    void* notify_userp;
+};
+
+static void* fetcher_main(void* userp) {
+    Fetcher* fetcher = (Fetcher*)userp;
+
+    pthread_mutex_lock(&fetcher->lock);
+    while (!fetcher->stopping) {
+        if (fetcher->job != JOB_PENDING) {
+            pthread_cond_wait(&fetcher->wake, &fetcher->lock);
+            continue;
+        }
+
+        fetcher->job = JOB_RUNNING;
+        pthread_mutex_unlock(&fetcher->lock);
+
+        RomMPlatform* platforms = NULL;
+        int platform_count = 0;
+        Arena* arena = arena_create(0);
+        int result = arena ? refresh_platform_list(fetcher->session, fetcher->current, fetcher->current_count,
+                                                   arena, &platforms, &platform_count)
+                           : CATALOG_ERROR;
+        if (result != CATALOG_FRESH) {
+            arena_release(arena);
+            arena = NULL;
+        }
+
+        pthread_mutex_lock(&fetcher->lock);
+        fetcher->result = result;
+        fetcher->arena = arena;
+        fetcher->platforms = platforms;
+        fetcher->platform_count = platform_count;
+        fetcher->job = JOB_FINISHED;
+        pthread_mutex_unlock(&fetcher->lock);
+
+        if (fetcher->notify) fetcher->notify(fetcher->notify_userp);
+        pthread_mutex_lock(&fetcher->lock);
+    }
+    pthread_mutex_unlock(&fetcher->lock);
+    return NULL;
+}
+
+Fetcher* fetcher_init(HttpSession* session, fetcher_notify_fn notify, void* userp) {
+    Fetcher* fetcher = calloc(1, sizeof(struct Fetcher));
+    if (!fetcher) return NULL;
+
+    fetcher->session = session;
+    fetcher->notify = notify;
+    fetcher->notify_userp = userp;
+    pthread_mutex_init(&fetcher->lock, NULL);
+    pthread_cond_init(&fetcher->wake, NULL);
+
+    if (pthread_create(&fetcher->thread, NULL, fetcher_main, fetcher) != 0) {
+        fprintf(stderr, "Failed to start fetch worker\n");
+        pthread_cond_destroy(&fetcher->wake);
+        pthread_mutex_destroy(&fetcher->lock);
+        free(fetcher);
+        return NULL;
+    }
+    return fetcher;
+}
+
+void fetcher_free(Fetcher* fetcher) {
+    if (!fetcher) return;
+
+    pthread_mutex_lock(&fetcher->lock);
+    fetcher->stopping = true;
+    pthread_cond_broadcast(&fetcher->wake);
+    pthread_mutex_unlock(&fetcher->lock);
+    pthread_join(fetcher->thread, NULL);
+
+    // A result nobody took
+    arena_release(fetcher->arena);
+
+    pthread_cond_destroy(&fetcher->wake);
+    pthread_mutex_destroy(&fetcher->lock);
+    free(fetcher);
+}
+
+int fetcher_refresh_platforms(Fetcher* fetcher, const RomMPlatform* current, int current_count) {
+    int ret = -1;
+
+    pthread_mutex_lock(&fetcher->lock);
+    if (fetcher->job == JOB_NONE) {
+        fetcher->current = current;
+        fetcher->current_count = current_count;
+        fetcher->job = JOB_PENDING;
+        pthread_cond_signal(&fetcher->wake);
+        ret = 0;
+    }
+    pthread_mutex_unlock(&fetcher->lock);
+    return ret;
+}
+
+bool fetcher_take_platforms(Fetcher* fetcher, int* result, Arena** arena,
+                            RomMPlatform** platform_list, int* platform_count) {
+    bool taken = false;
+
+    pthread_mutex_lock(&fetcher->lock);
+    if (fetcher->job == JOB_FINISHED) {
+        *result = fetcher->result;
+        if (fetcher->result == CATALOG_FRESH) {
+            *arena = fetcher->arena;
+            *platform_list = fetcher->platforms;
+            *platform_count = fetcher->platform_count;
+        }
+        fetcher->arena = NULL;
+        fetcher->platforms = NULL;
+        fetcher->platform_count = 0;
+        fetcher->current = NULL;
+        fetcher->job = JOB_NONE;
+        taken = true;
+    }
+    pthread_mutex_unlock(&fetcher->lock);
+    return taken;
+}
@@ -0,0 +1,227 @@
+#define _GNU_SOURCE  // fallocate
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "file_writer.h"
+#include "trace.h"
+
+#define FILE_WRITER_ALIGNMENT 4096
+
+struct FileWriter {
+    int fd;
+    pthread_t thread;
+    pthread_mutex_t lock;        // Guards the ring indexes and the fields below them
+    pthread_cond_t filled;       // A buffer was queued, or stopping was set
+    pthread_cond_t drained;      // A queued buffer was written
+    unsigned char* buffers[FILE_WRITER_BUFFERS];
+    size_t lengths[FILE_WRITER_BUFFERS];
+    int head;                    // Buffer the caller fills, never queued
+    int tail;                    // Oldest queued buffer, the one being written
+    int queued;
+    size_t fill;                 // Bytes in the head buffer, caller only
+    long long position;          // File offset of the next write, writer thread only while queued > 0
+    long long reserve_to;        // Pending reservation, 0 when none
+    bool stopping;
+    int error;                   // errno of the first failed write, 0 when none
+};
+
+static int write_fully(int fd, const unsigned char* data, size_t length, long long position) {
+    while (length > 0) {
+        ssize_t written = pwrite(fd, data, length, (off_t)position);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return errno;
+        }
+        data += written;
+        length -= (size_t)written;
+        position += written;
+    }
+    return 0;
+}
+
+static void* writer_main(void* userp) {
+    FileWriter* writer = (FileWriter*)userp;
+
+    pthread_mutex_lock(&writer->lock);
+    for (;;) {
+        if (writer->queued == 0) {
+            if (writer->stopping) break;
+            pthread_cond_wait(&writer->filled, &writer->lock);
+            continue;
+        }
+
+        // The buffer stays counted as queued while it is written, so the caller cannot refill it
+        int index = writer->tail;
+        long long position = writer->position;
+        long long reserve_to = writer->reserve_to;
+        writer->reserve_to = 0;
+        bool failed = writer->error != 0;
+        pthread_mutex_unlock(&writer->lock);
+
+        // Blocks allocated up front keep a large ROM contiguous on the card
+        if (reserve_to > position) {
+            fallocate(writer->fd, FALLOC_FL_KEEP_SIZE, (off_t)position, (off_t)(reserve_to - position));
+        }
+
+        int error = 0;
+        if (!failed) {
+            uint64_t start = trace_now_us();
+            error = write_fully(writer->fd, writer->buffers[index], writer->lengths[index], position);
+            trace_span(TRACE_DISK_WRITE, start, trace_now_us(), writer->lengths[index]);
+        }
+
+        pthread_mutex_lock(&writer->lock);
+        if (error && !writer->error) writer->error = error;
+        writer->position += (long long)writer->lengths[index];
+        writer->tail = (writer->tail + 1) % FILE_WRITER_BUFFERS;
+        writer->queued--;
+        pthread_cond_signal(&writer->drained);
+    }
+    pthread_mutex_unlock(&writer->lock);
+    return NULL;
+}
+
+static void free_writer(FileWriter* writer) {
+    for (int i = 0; i < FILE_WRITER_BUFFERS; i++) {
+        free(writer->buffers[i]);
+    }
+    pthread_cond_destroy(&writer->drained);
+    pthread_cond_destroy(&writer->filled);
+    pthread_mutex_destroy(&writer->lock);
+    free(writer);
+}
+
+FileWriter* file_writer_open(const char* path, long long offset) {
+    FileWriter* writer = calloc(1, sizeof(struct FileWriter));
+    if (!writer) return NULL;
+
+    pthread_mutex_init(&writer->lock, NULL);
+    pthread_cond_init(&writer->filled, NULL);
+    pthread_cond_init(&writer->drained, NULL);
+    writer->position = offset;
+
+    // Aligned to pages, so the card sees whole-page writes and no buffer straddles two pages
+    for (int i = 0; i < FILE_WRITER_BUFFERS; i++) {
+        void* buffer = NULL;
+        if (posix_memalign(&buffer, FILE_WRITER_ALIGNMENT, FILE_WRITER_BUFFER_SIZE) != 0) {
+            fprintf(stderr, "Failed to allocate write buffers for %s\n", path);
+            free_writer(writer);
+            return NULL;
+        }
+        writer->buffers[i] = buffer;
+    }
+
+    writer->fd = open(path, O_WRONLY | O_CREAT, 0644);
+    if (writer->fd < 0 || ftruncate(writer->fd, (off_t)offset) != 0) {
+        fprintf(stderr, "Failed to open %s: %s\n", path, strerror(errno));
+        if (writer->fd >= 0) close(writer->fd);
+        free_writer(writer);
+        return NULL;
+    }
+
+    if (pthread_create(&writer->thread, NULL, writer_main, writer) != 0) {
+        fprintf(stderr, "Failed to start writer for %s\n", path);
+        close(writer->fd);
+        free_writer(writer);
+        return NULL;
+    }
+    return writer;
+}
+
+// Queue the head buffer and take the next one, waiting only when the whole ring is queued
+static int hand_off(FileWriter* writer) {
+    pthread_mutex_lock(&writer->lock);
+    writer->lengths[writer->head] = writer->fill;
+    writer->head = (writer->head + 1) % FILE_WRITER_BUFFERS;
+    writer->queued++;
+    pthread_cond_signal(&writer->filled);
+
+    if (writer->queued == FILE_WRITER_BUFFERS) {
+        uint64_t start = trace_now_us();
+        while (writer->queued == FILE_WRITER_BUFFERS) {
+            pthread_cond_wait(&writer->drained, &writer->lock);
+        }
+        trace_span(TRACE_DISK_WAIT, start, trace_now_us(), 0);
+    }
+    int error = writer->error;
+    pthread_mutex_unlock(&writer->lock);
+
+    writer->fill = 0;
+    return error ? -1 : 0;
+}
+
+int file_writer_write(FileWriter* writer, const void* data, size_t length) {
+    const unsigned char* input = (const unsigned char*)data;
+
+    while (length > 0) {
+        size_t take = FILE_WRITER_BUFFER_SIZE - writer->fill;
+        if (take > length) take = length;
+
+        memcpy(writer->buffers[writer->head] + writer->fill, input, take);
+        writer->fill += take;
+        input += take;
+        length -= take;
+
+        if (writer->fill == FILE_WRITER_BUFFER_SIZE && hand_off(writer) != 0) return -1;
+    }
+    return 0;
+}
+
+void file_writer_reserve(FileWriter* writer, long long total_length) {
+    pthread_mutex_lock(&writer->lock);
+    writer->reserve_to = total_length;
+    pthread_mutex_unlock(&writer->lock);
+}
+
+// Queue the partial head buffer and wait until the writer is idle; returns with the lock held
+static void drain_locked(FileWriter* writer) {
+    if (writer->fill > 0) {
+        pthread_mutex_lock(&writer->lock);
+        writer->lengths[writer->head] = writer->fill;
+        writer->head = (writer->head + 1) % FILE_WRITER_BUFFERS;
+        writer->queued++;
+        pthread_cond_signal(&writer->filled);
+        pthread_mutex_unlock(&writer->lock);
+        writer->fill = 0;
+    }
+
+    pthread_mutex_lock(&writer->lock);
+    while (writer->queued > 0) {
+        pthread_cond_wait(&writer->drained, &writer->lock);
+    }
+}
+
+int file_writer_restart(FileWriter* writer) {
+    drain_locked(writer);
+    if (!writer->error && ftruncate(writer->fd, 0) != 0) writer->error = errno;
+    writer->position = 0;
+    writer->reserve_to = 0;
+    int error = writer->error;
+    pthread_mutex_unlock(&writer->lock);
+
+    if (error) fprintf(stderr, "Failed to restart file: %s\n", strerror(error));
+    return error ? -1 : 0;
+}
+
+int file_writer_close(FileWriter* writer, bool sync) {
+    if (!writer) return -1;
+
+    drain_locked(writer);
+    writer->stopping = true;
+    pthread_cond_signal(&writer->filled);
+    pthread_mutex_unlock(&writer->lock);
+    pthread_join(writer->thread, NULL);
+
+    // Only finished files are synced, a partial one is resumed from whatever reached the card
+    int error = writer->error;
+    if (!error && sync && fsync(writer->fd) != 0) error = errno;
+    if (close(writer->fd) != 0 && !error) error = errno;
+    if (error) fprintf(stderr, "Failed to write file: %s\n", strerror(error));
+
+    free_writer(writer);
+    return error ? -1 : 0;
+}
@@ -0,0 +1,284 @@
+#include "hash.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <pthread.h>
+
+/* CRC32 */
+
+// Slicing-by-8 tables: table[k][b] is the CRC of byte b followed by k zero bytes
+static uint32_t crc32_table[8][256];
+static pthread_once_t crc32_table_once = PTHREAD_ONCE_INIT;
+
+static void crc32_build_table(void) {
+    for (uint32_t b = 0; b < 256; b++) {
+        uint32_t crc = b;
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1)));
+        }
+        crc32_table[0][b] = crc;
+    }
+    for (uint32_t b = 0; b < 256; b++) {
+        for (int k = 1; k < 8; k++) {
+            uint32_t prev = crc32_table[k - 1][b];
+            crc32_table[k][b] = (prev >> 8) ^ crc32_table[0][prev & 0xff];
+        }
+    }
+}
+
+static uint32_t load_le32(const unsigned char* p) {
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+uint32_t crc32_update(uint32_t crc, const void* data, size_t length) {
+    const unsigned char* p = (const unsigned char*)data;
+    pthread_once(&crc32_table_once, crc32_build_table);
+
+    crc = ~crc;
+    // Eight bytes per step through eight independent table lookups
+    while (length >= 8) {
+        uint32_t low = load_le32(p) ^ crc;
+        uint32_t high = load_le32(p + 4);
+        crc = crc32_table[7][low & 0xff] ^ crc32_table[6][(low >> 8) & 0xff] ^
+              crc32_table[5][(low >> 16) & 0xff] ^ crc32_table[4][low >> 24] ^
+              crc32_table[3][high & 0xff] ^ crc32_table[2][(high >> 8) & 0xff] ^
+              crc32_table[1][(high >> 16) & 0xff] ^ crc32_table[0][high >> 24];
+        p += 8;
+        length -= 8;
+    }
+    while (length--) {
+        crc = (crc >> 8) ^ crc32_table[0][(crc ^ *p++) & 0xff];
+    }
+    return ~crc;
+}
+
+/* MD5 (RFC 1321) */
+
+static uint32_t rotl32(uint32_t value, int bits) {
+    return (value << bits) | (value >> (32 - bits));
+}
+
+static const uint32_t md5_k[64] = {
+    0xd76aa478, 0xe8c7b756, 0x242070db, 0xc1bdceee, 0xf57c0faf, 0x4787c62a, 0xa8304613, 0xfd469501,
+    0x698098d8, 0x8b44f7af, 0xffff5bb1, 0x895cd7be, 0x6b901122, 0xfd987193, 0xa679438e, 0x49b40821,
+    0xf61e2562, 0xc040b340, 0x265e5a51, 0xe9b6c7aa, 0xd62f105d, 0x02441453, 0xd8a1e681, 0xe7d3fbc8,
+    0x21e1cde6, 0xc33707d6, 0xf4d50d87, 0x455a14ed, 0xa9e3e905, 0xfcefa3f8, 0x676f02d9, 0x8d2a4c8a,
+    0xfffa3942, 0x8771f681, 0x6d9d6122, 0xfde5380c, 0xa4beea44, 0x4bdecfa9, 0xf6bb4b60, 0xbebfbc70,
+    0x289b7ec6, 0xeaa127fa, 0xd4ef3085, 0x04881d05, 0xd9d4d039, 0xe6db99e5, 0x1fa27cf8, 0xc4ac5665,
+    0xf4292244, 0x432aff97, 0xab9423a7, 0xfc93a039, 0x655b59c3, 0x8f0ccc92, 0xffeff47d, 0x85845dd1,
+    0x6fa87e4f, 0xfe2ce6e0, 0xa3014314, 0x4e0811a1, 0xf7537e82, 0xbd3af235, 0x2ad7d2bb, 0xeb86d391
+};
+
+static const int md5_r[64] = {
+    7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22,
+    5, 9, 14, 20, 5, 9, 14, 20, 5, 9, 14, 20, 5, 9, 14, 20,
+    4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23,
+    6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21
+};
+
+static void md5_block(uint32_t state[4], const unsigned char* block) {
+    uint32_t m[16];
+    for (int i = 0; i < 16; i++) m[i] = load_le32(block + i * 4);
+
+    uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+    for (int i = 0; i < 64; i++) {
+        uint32_t f;
+        int g;
+        if (i < 16) {
+            f = (b & c) | (~b & d);
+            g = i;
+        } else if (i < 32) {
+            f = (d & b) | (~d & c);
+            g = (5 * i + 1) & 15;
+        } else if (i < 48) {
+            f = b ^ c ^ d;
+            g = (3 * i + 5) & 15;
+        } else {
+            f = c ^ (b | ~d);
+            g = (7 * i) & 15;
+        }
+        uint32_t next = d;
+        d = c;
+        c = b;
+        b = b + rotl32(a + f + md5_k[i] + m[g], md5_r[i]);
+        a = next;
+    }
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+}
+
+/* SHA1 (FIPS 180-1) */
+
+static uint32_t load_be32(const unsigned char* p) {
+    return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | (uint32_t)p[3];
+}
+
+static void sha1_block(uint32_t state[5], const unsigned char* block) {
+    uint32_t w[80];
+    for (int i = 0; i < 16; i++) w[i] = load_be32(block + i * 4);
+    for (int i = 16; i < 80; i++) w[i] = rotl32(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+
+    uint32_t a = state[0], b = state[1], c = state[2], d = state[3], e = state[4];
+    for (int i = 0; i < 80; i++) {
+        uint32_t f, k;
+        if (i < 20) {
+            f = (b & c) | (~b & d);
+            k = 0x5a827999;
+        } else if (i < 40) {
+            f = b ^ c ^ d;
+            k = 0x6ed9eba1;
+        } else if (i < 60) {
+            f = (b & c) | (b & d) | (c & d);
+            k = 0x8f1bbcdc;
+        } else {
+            f = b ^ c ^ d;
+            k = 0xca62c1d6;
+        }
+        uint32_t next = rotl32(a, 5) + f + e + k + w[i];
+        e = d;
+        d = c;
+        c = rotl32(b, 30);
+        b = a;
+        a = next;
+    }
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+    state[4] += e;
+}
+
+/* Shared 64-byte block buffering of MD5 and SHA1 */
+
+typedef void (*block_fn)(uint32_t* state, const unsigned char* block);
+
+static void block_update(uint32_t* state, unsigned char* buffer, uint64_t* total,
+                         const unsigned char* data, size_t length, block_fn process) {
+    size_t used = (size_t)(*total & 63);
+    *total += length;
+
+    if (used > 0) {
+        size_t take = 64 - used < length ? 64 - used : length;
+        memcpy(buffer + used, data, take);
+        data += take;
+        length -= take;
+        if (used + take < 64) return;
+        process(state, buffer);
+    }
+    // Whole blocks straight from the caller's buffer
+    while (length >= 64) {
+        process(state, data);
+        data += 64;
+        length -= 64;
+    }
+    memcpy(buffer, data, length);
+}
+
+// Pad with 0x80, zeros and the bit length (little- or big-endian) and run the last blocks
+static void block_finish(uint32_t* state, const unsigned char* buffer, uint64_t total,
+                         block_fn process, int big_endian) {
+    unsigned char tail[128];
+    size_t used = (size_t)(total & 63);
+    size_t tail_length = used < 56 ? 64 : 128;
+    uint64_t bits = total * 8;
+
+    memset(tail, 0, sizeof(tail));
+    memcpy(tail, buffer, used);
+    tail[used] = 0x80;
+    for (int i = 0; i < 8; i++) {
+        int shift = big_endian ? 56 - i * 8 : i * 8;
+        tail[tail_length - 8 + i] = (unsigned char)(bits >> shift);
+    }
+    process(state, tail);
+    if (tail_length == 128) process(state, tail + 64);
+}
+
+/* Combined state */
+
+void hash_init(HashState* state, unsigned int flags) {
+    memset(state, 0, sizeof(HashState));
+    state->flags = flags;
+    state->md5.state[0] = 0x67452301;
+    state->md5.state[1] = 0xefcdab89;
+    state->md5.state[2] = 0x98badcfe;
+    state->md5.state[3] = 0x10325476;
+    state->sha1.state[0] = 0x67452301;
+    state->sha1.state[1] = 0xefcdab89;
+    state->sha1.state[2] = 0x98badcfe;
+    state->sha1.state[3] = 0x10325476;
+    state->sha1.state[4] = 0xc3d2e1f0;
+}
+
+void hash_update(HashState* state, const void* data, size_t length) {
+    state->length += length;
+    if (state->flags & HASH_CRC32) {
+        state->crc32 = crc32_update(state->crc32, data, length);
+    }
+    if (state->flags & HASH_MD5) {
+        block_update(state->md5.state, state->md5.block, &state->md5.length, data, length, md5_block);
+    }
+    if (state->flags & HASH_SHA1) {
+        block_update(state->sha1.state, state->sha1.block, &state->sha1.length, data, length, sha1_block);
+    }
+}
+
+void hash_final(const HashState* state, HashDigest* digest) {
+    memset(digest, 0, sizeof(HashDigest));
+    digest->crc32 = state->crc32;
+
+    if (state->flags & HASH_MD5) {
+        uint32_t md5[4];
+        memcpy(md5, state->md5.state, sizeof(md5));
+        block_finish(md5, state->md5.block, state->md5.length, md5_block, 0);
+        for (int i = 0; i < 16; i++) digest->md5[i] = (unsigned char)(md5[i / 4] >> ((i % 4) * 8));
+    }
+    if (state->flags & HASH_SHA1) {
+        uint32_t sha1[5];
+        memcpy(sha1, state->sha1.state, sizeof(sha1));
+        block_finish(sha1, state->sha1.block, state->sha1.length, sha1_block, 1);
+        for (int i = 0; i < 20; i++) digest->sha1[i] = (unsigned char)(sha1[i / 4] >> (24 - (i % 4) * 8));
+    }
+}
+
+static void to_hex(const unsigned char* bytes, size_t length, char* out) {
+    static const char digits[] = "0123456789abcdef";
+    for (size_t i = 0; i < length; i++) {
+        out[i * 2] = digits[bytes[i] >> 4];
+        out[i * 2 + 1] = digits[bytes[i] & 0xf];
+    }
+    out[length * 2] = '\0';
+}
+
+static int hex_matches(const char* expected, const char* actual, const char* kind) {
+    if (!expected || !*expected) return 0;
+    if (strcasecmp(expected, actual) == 0) return 0;
+    fprintf(stderr, "%s mismatch: expected %s, got %s\n", kind, expected, actual);
+    return -1;
+}
+
+int hash_verify(const HashDigest* digest, unsigned int flags,
+                const char* crc32_hex, const char* md5_hex, const char* sha1_hex) {
+    char hex[41];
+    int result = 0;
+
+    if (flags & HASH_CRC32) {
+        // Compared as a number, some servers drop the leading zeros
+        snprintf(hex, sizeof(hex), "%08x", (unsigned int)digest->crc32);
+        if (crc32_hex && *crc32_hex && strtoul(crc32_hex, NULL, 16) != digest->crc32) {
+            fprintf(stderr, "CRC32 mismatch: expected %s, got %s\n", crc32_hex, hex);
+            result = -1;
+        }
+    }
+    if (flags & HASH_MD5) {
+        to_hex(digest->md5, sizeof(digest->md5), hex);
+        if (hex_matches(md5_hex, hex, "MD5") != 0) result = -1;
+    }
+    if (flags & HASH_SHA1) {
+        to_hex(digest->sha1, sizeof(digest->sha1), hex);
+        if (hex_matches(sha1_hex, hex, "SHA1") != 0) result = -1;
+    }
+    return result;
+}
@@ -0,0 +1,599 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <strings.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <zlib.h>
+#include <json-c/json.h>
+#include "http.h"
+#include "transport.h"
+#include "trace.h"
+#include "base64.h"
+
+struct HttpSession {
+    char* server_url;
+    char* username;
+    char* password;
+    char* basic_header;                           // "Authorization: Basic ...", used while no token is available
+    pthread_mutex_t auth_lock;                    // Guards the token fields, held during a login so only one thread logs in
+    bool tokens_supported;                        // Cleared when the server has no token endpoint
+    char* access_token;
+    char* refresh_token;
+    double access_expires;                        // Monotonic seconds, 0 when unknown (token read from the card)
+    double login_retry_at;                        // A failed login is not tried again before this
+    unsigned int token_generation;                // Bumped whenever access_token changes
+    HttpTransport* transport;                     // libcurl on the device, a mock on the host
+    int aborted;                                  // Set once by http_session_abort, read by every transfer
+};
+
+#define HTTP_INFLATE_CHUNK 16384   // Inflated bytes handed to write_fn at most at a time
+#define HTTP_AUTH_HEADER_SIZE 2048
+#define HTTP_TOKEN_PATH "/api/token"
+#define HTTP_TOKEN_SCOPES "me.read roms.read platforms.read assets.read firmware.read collections.read"
+#define HTTP_TOKEN_MARGIN 60       // Seconds before its expiry an access token is renewed
+#define HTTP_LOGIN_RETRY 30        // Seconds on Basic auth after a failed login
+#define HTTP_NO_TOKEN -2           // token_request: the server answered without a token
+
+// Content-Encoding of the response being received
+enum {
+    ENCODING_IDENTITY,
+    ENCODING_GZIP,
+    ENCODING_DEFLATE,
+    ENCODING_UNSUPPORTED
+};
+
+// Per-transfer context of the progress and authorization callbacks
+typedef struct {
+    HttpSession* session;
+    const HttpRequest* request;
+    http_write_fn write_fn;    // Next body sink, the inflater or the caller's
+    void* write_userp;
+    http_header_fn header_fn;  // Next header sink, may be NULL
+    void* header_userp;
+    bool rejected;             // The token got a 401: the response is dropped and the request sent again
+} TransferContext;
+
+// Per-transfer context of a compressed request. The body is inflated as it
+// arrives, through one fixed output window, so it is never buffered whole.
+typedef struct {
+    const HttpRequest* request;
+    http_write_fn write_fn;
+    int encoding;
+    bool started;              // zlib stream initialized
+    bool finished;             // End of the compressed stream seen
+    bool raw;                  // Headerless deflate, as some servers send
+    z_stream zs;
+    unsigned char window[HTTP_INFLATE_CHUNK];
+} InflateContext;
+
+// Function to generate the Basic Authorization header from username and password
+char* generate_authorization_header(const char* username, const char* password) {
+    // Create a buffer large enough to hold the base64-encoded credentials
+    char* auth_header = malloc(512);
+    if (auth_header == NULL) {
+        fprintf(stderr, "Failed to allocate memory for authorization header\n");
+        return NULL;
+    }
+
+    // Format the username and password into the "username:password" format
+    char credentials[512];
+    snprintf(credentials, sizeof(credentials), "%s:%s", username, password);
+
+    // Base64 encode the credentials and get the encoded string
+    size_t encoded_len;
+    unsigned char* encoded_credentials = base64_encode((unsigned char*)credentials, strlen(credentials), &encoded_len);
+
+    if (encoded_credentials == NULL) {
+        fprintf(stderr, "Base64 encoding failed\n");
+        free(auth_header);
+        return NULL;
+    }
+
+    // base64_encode wraps its output with line feeds, which would end the header early
+    size_t packed_len = 0;
+    for (size_t i = 0; i < encoded_len; i++) {
+        if (encoded_credentials[i] != '\n') {
+            encoded_credentials[packed_len++] = encoded_credentials[i];
+        }
+    }
+    encoded_credentials[packed_len] = '\0';
+
+    // Format the Authorization header with "Basic <encoded_credentials>"
+    snprintf(auth_header, 512, "Authorization: Basic %s", encoded_credentials);
+
+    // Free the memory allocated by base64_encode
+    free(encoded_credentials);
+
+    return auth_header;
+}
+
+static double monotonic_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void set_string(char** field, const char* value) {
+    free(*field);
+    *field = value ? strdup(value) : NULL;
+}
+
+// Tokens go to the card with the server and user they belong to. Written to a
+// new file that only the owner can read, then moved over the old one.
+static void save_tokens(const HttpSession* session) {
+    char tmp_path[512];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", HTTP_TOKEN_FILE);
+
+    int fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    if (fd < 0) return;
+    fchmod(fd, 0600);  // An older file or the umask may have left it wider
+    FILE* file = fdopen(fd, "w");
+    if (!file) {
+        close(fd);
+        unlink(tmp_path);
+        return;
+    }
+
+    fprintf(file, "%s\n%s\n%s\n%s\n", session->server_url, session->username,
+            session->access_token ? session->access_token : "", session->refresh_token ? session->refresh_token : "");
+    if (fclose(file) != 0 || rename(tmp_path, HTTP_TOKEN_FILE) != 0) {
+        fprintf(stderr, "Failed to store session tokens\n");
+        unlink(tmp_path);
+    }
+}
+
+// Tokens of the last run, kept when they belong to the same server and user.
+// Their expiry is unknown (the device has no clock to trust), a 401 tells.
+static void load_tokens(HttpSession* session) {
+    FILE* file = fopen(HTTP_TOKEN_FILE, "r");
+    if (!file) return;
+
+    char lines[4][HTTP_AUTH_HEADER_SIZE];
+    int count = 0;
+    while (count < 4 && fgets(lines[count], sizeof(lines[count]), file)) {
+        lines[count][strcspn(lines[count], "\r\n")] = '\0';
+        count++;
+    }
+    fclose(file);
+
+    if (count < 4 || strcmp(lines[0], session->server_url) != 0 || strcmp(lines[1], session->username) != 0) return;
+    if (lines[2][0]) set_string(&session->access_token, lines[2]);
+    if (lines[3][0]) set_string(&session->refresh_token, lines[3]);
+    session->access_expires = 0;
+    session->token_generation++;
+}
+
+// Take the tokens out of a /api/token response
+static int store_tokens(HttpSession* session, const char* body) {
+    struct json_object* root = body ? json_tokener_parse(body) : NULL;
+    struct json_object* value;
+    const char* access = root && json_object_object_get_ex(root, "access_token", &value) ? json_object_get_string(value) : NULL;
+    if (!access || !*access) {
+        if (root) json_object_put(root);
+        return -1;
+    }
+
+    set_string(&session->access_token, access);
+    if (json_object_object_get_ex(root, "refresh_token", &value) && json_object_get_string(value)) {
+        set_string(&session->refresh_token, json_object_get_string(value));
+    }
+    int expires = json_object_object_get_ex(root, "expires", &value) ? json_object_get_int(value) : 0;
+    session->access_expires = expires > HTTP_TOKEN_MARGIN ? monotonic_seconds() + expires - HTTP_TOKEN_MARGIN : 0;
+    session->token_generation++;
+    json_object_put(root);
+
+    save_tokens(session);
+    return 0;
+}
+
+static int transfer_progress(void* userp, long long dltotal, long long dlnow);
+
+// POST a form to the token endpoint; returns the HTTP status, -1 on failure,
+// or HTTP_NO_TOKEN when a 200 carried no token
+static int token_request(HttpSession* session, const char* form) {
+    char url[2048];
+    snprintf(url, sizeof(url), "%s%s", session->server_url, HTTP_TOKEN_PATH);
+    const char* headers[] = { "Content-Type: application/x-www-form-urlencoded", "Accept: application/json", NULL };
+
+    Response* resp = response_init();
+    if (!resp) return -1;
+
+    HttpRequest request = { .path = HTTP_TOKEN_PATH };
+    TransferContext ctx = { .session = session, .request = &request };
+    HttpTransfer transfer = {
+        .url = url,
+        .headers = headers,
+        .body = form,
+        .body_length = strlen(form),
+        .write_fn = response_write_callback,
+        .write_userp = resp,
+        .progress_fn = transfer_progress,
+        .progress_userp = &ctx,
+    };
+    int status = session->transport->ops->perform(session->transport, &transfer);
+    if (status == 200 && store_tokens(session, response_get_memory(resp)) != 0) {
+        status = HTTP_NO_TOKEN;
+    }
+    response_free(resp);
+    return status;
+}
+
+// With auth_lock held: renew or obtain the access token when there is none or it
+// is about to expire. Tries the refresh token first, then the password.
+static void ensure_token(HttpSession* session) {
+    if (!session->tokens_supported) return;
+
+    double now = monotonic_seconds();
+    if (session->access_token && (session->access_expires == 0 || now < session->access_expires)) return;
+    if (now < session->login_retry_at) return;
+
+    char form[2048];
+    if (session->refresh_token) {
+        char* refresh = http_escape(session->refresh_token);
+        if (refresh) {
+            snprintf(form, sizeof(form), "grant_type=refresh_token&refresh_token=%s", refresh);
+            free(refresh);
+            int status = token_request(session, form);
+            if (status == 200) return;
+            if (status >= 400 && status < 500) set_string(&session->refresh_token, NULL);
+        }
+    }
+
+    char* username = http_escape(session->username);
+    char* password = http_escape(session->password);
+    char* scopes = http_escape(HTTP_TOKEN_SCOPES);
+    int status = -1;
+    if (username && password && scopes) {
+        snprintf(form, sizeof(form), "grant_type=password&username=%s&password=%s&scope=%s", username, password, scopes);
+        status = token_request(session, form);
+    }
+    free(username);
+    free(password);
+    free(scopes);
+    if (status == 200) return;
+
+    // An expired token would only earn another 401
+    set_string(&session->access_token, NULL);
+    if (status == 404 || status == 405 || status == HTTP_NO_TOKEN) {
+        fprintf(stderr, "Server has no token endpoint, using Basic auth\n");
+        session->tokens_supported = false;
+    } else {
+        fprintf(stderr, "Login failed (HTTP status %d), using Basic auth for now\n", status);
+        session->login_retry_at = now + HTTP_LOGIN_RETRY;
+    }
+}
+
+// Authorization header line for the next request. Returns the generation of
+// the token it carries, or 0 for Basic auth.
+static unsigned int session_auth_header(HttpSession* session, char* header, size_t header_size) {
+    pthread_mutex_lock(&session->auth_lock);
+    ensure_token(session);
+    unsigned int generation = 0;
+    if (session->access_token) {
+        snprintf(header, header_size, "Authorization: Bearer %s", session->access_token);
+        generation = session->token_generation;
+    } else {
+        snprintf(header, header_size, "%s", session->basic_header);
+    }
+    pthread_mutex_unlock(&session->auth_lock);
+    return generation;
+}
+
+// The server refused the token of that generation. Only the first of several
+// requests refused at once drops it, the others find the renewed one.
+static void session_token_rejected(HttpSession* session, unsigned int generation) {
+    pthread_mutex_lock(&session->auth_lock);
+    if (generation == session->token_generation) {
+        set_string(&session->access_token, NULL);
+        session->access_expires = 0;
+    }
+    pthread_mutex_unlock(&session->auth_lock);
+}
+
+HttpSession* http_session_init(const char* server_url, const char* username, const char* password) {
+    HttpTransport* transport = curl_transport_create();
+    if (!transport) return NULL;
+    return http_session_init_transport(server_url, username, password, transport);
+}
+
+HttpSession* http_session_init_transport(const char* server_url, const char* username, const char* password,
+                                         HttpTransport* transport) {
+    HttpSession* session = calloc(1, sizeof(struct HttpSession));
+    if (!session) {
+        transport->ops->destroy(transport);
+        return NULL;
+    }
+
+    // Strip trailing slashes so paths can always start with one
+    session->server_url = strdup(server_url);
+    size_t url_len = session->server_url ? strlen(session->server_url) : 0;
+    while (url_len > 0 && session->server_url[url_len - 1] == '/') {
+        session->server_url[--url_len] = '\0';
+    }
+
+    pthread_mutex_init(&session->auth_lock, NULL);
+    session->username = strdup(username ? username : "");
+    session->password = strdup(password ? password : "");
+    session->basic_header = generate_authorization_header(session->username ? session->username : "",
+                                                          session->password ? session->password : "");
+    session->transport = transport;
+    if (!session->server_url || !session->username || !session->password || !session->basic_header) {
+        http_session_free(session);
+        return NULL;
+    }
+
+    // Without a user there is nothing to log in with; the first request logs in otherwise
+    session->tokens_supported = session->username[0] != '\0';
+    if (session->tokens_supported) load_tokens(session);
+    return session;
+}
+
+void http_session_free(HttpSession* session) {
+    if (!session) return;
+
+    if (session->transport) session->transport->ops->destroy(session->transport);
+    pthread_mutex_destroy(&session->auth_lock);
+    free(session->server_url);
+    free(session->username);
+    free(session->password);
+    free(session->basic_header);
+    free(session->access_token);
+    free(session->refresh_token);
+    free(session);
+}
+
+// Percent-encode a path segment, caller frees the result
+char* http_escape(const char* text) {
+    static const char hex[] = "0123456789ABCDEF";
+    size_t len = strlen(text);
+    char* escaped = malloc(len * 3 + 1);
+    if (!escaped) return NULL;
+
+    char* pos = escaped;
+    for (const unsigned char* c = (const unsigned char*)text; *c; c++) {
+        if ((*c >= 'A' && *c <= 'Z') || (*c >= 'a' && *c <= 'z') || (*c >= '0' && *c <= '9') ||
+            *c == '-' || *c == '_' || *c == '.' || *c == '~') {
+            *pos++ = (char)*c;
+        } else {
+            *pos++ = '%';
+            *pos++ = hex[*c >> 4];
+            *pos++ = hex[*c & 0x0f];
+        }
+    }
+    *pos = '\0';
+    return escaped;
+}
+
+// Runs while connecting or stalled too, so an aborted session stops within a second
+static int transfer_progress(void* userp, long long dltotal, long long dlnow) {
+    TransferContext* ctx = (TransferContext*)userp;
+
+    if (__atomic_load_n(&ctx->session->aborted, __ATOMIC_RELAXED)) return 1;
+    if (!ctx->request->progress_fn) return 0;
+    return ctx->request->progress_fn(ctx->request->progress_userp, dltotal, dlnow);
+}
+
+// A 401 to a token means it expired or was revoked; the request is sent again
+// with a renewed one, so that response never reaches the caller
+static size_t auth_header_callback(char* buffer, size_t size, size_t nitems, void* userp) {
+    TransferContext* ctx = (TransferContext*)userp;
+    size_t length = size * nitems;
+
+    if (length >= 5 && strncmp(buffer, "HTTP/", 5) == 0) {
+        char line[64];
+        size_t line_length = length < sizeof(line) - 1 ? length : sizeof(line) - 1;
+        memcpy(line, buffer, line_length);
+        line[line_length] = '\0';
+        int status;
+        ctx->rejected = sscanf(line, "HTTP/%*s %d", &status) == 1 && status == 401;
+    }
+
+    if (ctx->rejected || !ctx->header_fn) return length;
+    return ctx->header_fn(buffer, size, nitems, ctx->header_userp);
+}
+
+static size_t auth_write_callback(void* contents, size_t size, size_t nmemb, void* userp) {
+    TransferContext* ctx = (TransferContext*)userp;
+    if (ctx->rejected) return size * nmemb;
+    return ctx->write_fn(contents, size, nmemb, ctx->write_userp);
+}
+
+// Tracks Content-Encoding; every status line starts a new response (redirects)
+static size_t inflate_header_callback(char* buffer, size_t size, size_t nitems, void* userp) {
+    InflateContext* ctx = (InflateContext*)userp;
+    size_t length = size * nitems;
+
+    if (length >= 5 && strncmp(buffer, "HTTP/", 5) == 0) {
+        ctx->encoding = ENCODING_IDENTITY;
+    } else if (length > 17 && strncasecmp(buffer, "Content-Encoding:", 17) == 0) {
+        const char* value = buffer + 17;
+        size_t value_length = length - 17;
+        while (value_length > 0 && (*value == ' ' || *value == '\t')) {
+            value++;
+            value_length--;
+        }
+        while (value_length > 0 && (value[value_length - 1] == '\r' || value[value_length - 1] == '\n' ||
+                                    value[value_length - 1] == ' ')) {
+            value_length--;
+        }
+
+        if ((value_length == 4 && strncasecmp(value, "gzip", 4) == 0) ||
+            (value_length == 6 && strncasecmp(value, "x-gzip", 6) == 0)) {
+            ctx->encoding = ENCODING_GZIP;
+        } else if (value_length == 7 && strncasecmp(value, "deflate", 7) == 0) {
+            ctx->encoding = ENCODING_DEFLATE;
+        } else if (!(value_length == 8 && strncasecmp(value, "identity", 8) == 0)) {
+            ctx->encoding = ENCODING_UNSUPPORTED;
+        }
+    }
+
+    if (!ctx->request->header_fn) return length;
+    return ctx->request->header_fn(buffer, size, nitems, ctx->request->header_userp);
+}
+
+static int inflate_start(InflateContext* ctx, bool raw) {
+    memset(&ctx->zs, 0, sizeof(ctx->zs));
+    // 15 + 32 detects a gzip or zlib header; -15 is raw deflate without one
+    if (inflateInit2(&ctx->zs, raw ? -15 : 15 + 32) != Z_OK) return -1;
+    ctx->started = true;
+    ctx->raw = raw;
+    return 0;
+}
+
+static size_t inflate_write_callback(void* contents, size_t size, size_t nmemb, void* userp) {
+    InflateContext* ctx = (InflateContext*)userp;
+    size_t length = size * nmemb;
+    void* write_userp = ctx->request->write_userp;
+
+    if (ctx->encoding == ENCODING_IDENTITY) return ctx->write_fn(contents, size, nmemb, write_userp);
+    if (ctx->encoding == ENCODING_UNSUPPORTED) {
+        fprintf(stderr, "Unsupported Content-Encoding in response\n");
+        return 0;
+    }
+    if (!ctx->started && inflate_start(ctx, false) != 0) return 0;
+
+    ctx->zs.next_in = (unsigned char*)contents;
+    ctx->zs.avail_in = (uInt)length;
+    while (ctx->zs.avail_in > 0 && !ctx->finished) {
+        ctx->zs.next_out = ctx->window;
+        ctx->zs.avail_out = sizeof(ctx->window);
+        int rc = inflate(&ctx->zs, Z_NO_FLUSH);
+
+        // "deflate" is meant to be zlib-wrapped, but some servers send it raw
+        if (rc == Z_DATA_ERROR && ctx->encoding == ENCODING_DEFLATE && !ctx->raw && ctx->zs.total_out == 0 &&
+            ctx->zs.total_in < length) {
+            inflateEnd(&ctx->zs);
+            if (inflate_start(ctx, true) != 0) return 0;
+            ctx->zs.next_in = (unsigned char*)contents;
+            ctx->zs.avail_in = (uInt)length;
+            continue;
+        }
+        if (rc != Z_OK && rc != Z_STREAM_END && rc != Z_BUF_ERROR) {
+            fprintf(stderr, "Failed to inflate response: %s\n", ctx->zs.msg ? ctx->zs.msg : "corrupt data");
+            return 0;
+        }
+
+        size_t produced = sizeof(ctx->window) - ctx->zs.avail_out;
+        if (produced > 0 && ctx->write_fn(ctx->window, 1, produced, write_userp) != produced) return 0;
+        if (rc == Z_STREAM_END) ctx->finished = true;
+        if (rc == Z_BUF_ERROR && produced == 0) break;
+    }
+    return length;
+}
+
+void http_session_abort(HttpSession* session) {
+    if (session) __atomic_store_n(&session->aborted, 1, __ATOMIC_RELAXED);
+}
+
+int http_request(HttpSession* session, const HttpRequest* request) {
+    if (!session || !request || !request->path) return -1;
+    if (__atomic_load_n(&session->aborted, __ATOMIC_RELAXED)) return -1;
+
+    char url[2048];
+    if (strncmp(request->path, "http://", 7) == 0 || strncmp(request->path, "https://", 8) == 0) {
+        snprintf(url, sizeof(url), "%s", request->path);
+    } else {
+        snprintf(url, sizeof(url), "%s%s", session->server_url, request->path);
+    }
+
+    // Credentials only go to the configured server, never to an absolute url on another host
+    size_t server_length = strlen(session->server_url);
+    bool own_server = strncmp(url, session->server_url, server_length) == 0 && url[server_length] == '/';
+
+    // Authorization, the caller's headers, Range, Accept-Encoding and the terminating NULL
+    int extra_count = 0;
+    while (request->headers && request->headers[extra_count]) extra_count++;
+    const char** headers = malloc((extra_count + 4) * sizeof(char*));
+    if (!headers) return -1;
+
+    char auth_header[HTTP_AUTH_HEADER_SIZE];
+    int header_count = 0;
+    if (own_server) headers[header_count++] = auth_header;
+    for (int i = 0; i < extra_count; i++) {
+        headers[header_count++] = request->headers[i];
+    }
+
+    // Sent as a plain header so a 200 reply (no range support) reaches the caller instead of failing
+    char range[64];
+    if (request->range_start > 0) {
+        snprintf(range, sizeof(range), "Range: bytes=%lld-", request->range_start);
+        headers[header_count++] = range;
+    }
+
+    InflateContext* inflater = NULL;
+    if (request->compressed) {
+        inflater = calloc(1, sizeof(InflateContext));
+        if (!inflater) {
+            free(headers);
+            return -1;
+        }
+        inflater->request = request;
+        inflater->write_fn = request->write_fn ? request->write_fn : response_write_callback;
+        headers[header_count++] = "Accept-Encoding: gzip, deflate";
+    }
+    headers[header_count] = NULL;
+
+    TransferContext ctx = {
+        .session = session,
+        .request = request,
+        .write_fn = request->write_fn ? request->write_fn : response_write_callback,
+        .write_userp = request->write_userp,
+        .header_fn = request->header_fn,
+        .header_userp = request->header_userp,
+    };
+    if (inflater) {
+        ctx.write_fn = inflate_write_callback;
+        ctx.write_userp = inflater;
+        ctx.header_fn = inflate_header_callback;
+        ctx.header_userp = inflater;
+    }
+    HttpTransfer transfer = {
+        .url = url,
+        .headers = headers,
+        .progress_fn = transfer_progress,
+        .progress_userp = &ctx,
+    };
+
+    uint64_t start = trace_now_us();
+    int status = -1;
+    for (int attempt = 0; attempt < 2; attempt++) {
+        unsigned int generation = own_server ? session_auth_header(session, auth_header, sizeof(auth_header)) : 0;
+
+        // Basic auth cannot be renewed, so its responses go straight through, as do other hosts'
+        ctx.rejected = false;
+        transfer.write_fn = generation ? auth_write_callback : ctx.write_fn;
+        transfer.write_userp = generation ? (void*)&ctx : ctx.write_userp;
+        transfer.header_fn = generation ? auth_header_callback : ctx.header_fn;
+        transfer.header_userp = generation ? (void*)&ctx : ctx.header_userp;
+
+        status = session->transport->ops->perform(session->transport, &transfer);
+        if (!ctx.rejected) break;
+        session_token_rejected(session, generation);
+    }
+    trace_span(TRACE_HTTP_REQUEST, start, trace_now_us(), 0);
+
+    if (inflater) {
+        // A body cut short inside the compressed stream is a failed transfer
+        if (inflater->started && !inflater->finished && status >= 200 && status < 300) {
+            fprintf(stderr, "Compressed response from %s ended early\n", url);
+            status = -1;
+        }
+        if (inflater->started) inflateEnd(&inflater->zs);
+        free(inflater);
+    }
+    free(headers);
+    return status;
+}
+
+int http_get(HttpSession* session, const char* path, Response* resp) {
+    HttpRequest request = {
+        .path = path,
+        .write_fn = response_write_callback,
+        .write_userp = resp,
+    };
+    return http_request(session, &request);
+}
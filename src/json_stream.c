@@ -0,0 +1,280 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <json-c/json.h>
+#include "json_stream.h"
+#include "response.h"
+#include "trace.h"
+
+#define JSON_STREAM_MAX_KEY 64
+
+enum {
+    STREAM_SEEKING,   // Before the array being split
+    STREAM_IN_ARRAY,  // Inside it, element bytes go to the element buffer
+    STREAM_DONE       // After it, only the envelope remains
+};
+
+struct JsonStream {
+    char* array_key;
+    json_element_fn on_element;
+    void* userp;
+    json_tokener* tokener;
+    Response* element;   // Bytes of the element currently being received
+    Response* skeleton;  // Everything outside the split array
+    int state;
+    int depth;
+    int array_depth;
+    bool in_string;
+    bool escaped;
+    bool expect_key;     // Next string at depth 1 is an object key
+    bool capturing_key;
+    char key[JSON_STREAM_MAX_KEY];
+    size_t key_len;
+    int count;
+    bool failed;
+    uint64_t decode_start;   // First feed, for the decode span
+    uint64_t decode_us;      // Time spent inside feed, excluding waits for the network
+    uint64_t decode_bytes;
+};
+
+JsonStream* json_stream_init(const char* array_key, json_element_fn on_element, void* userp) {
+    JsonStream* stream = calloc(1, sizeof(struct JsonStream));
+    if (!stream) return NULL;
+
+    stream->array_key = array_key ? strdup(array_key) : NULL;
+    stream->on_element = on_element;
+    stream->userp = userp;
+    stream->tokener = json_tokener_new();
+    stream->element = response_init();
+    stream->skeleton = response_init();
+    stream->state = STREAM_SEEKING;
+
+    if ((array_key && !stream->array_key) || !stream->tokener || !stream->element || !stream->skeleton) {
+        json_stream_free(stream);
+        return NULL;
+    }
+    return stream;
+}
+
+void json_stream_free(JsonStream* stream) {
+    if (!stream) return;
+
+    free(stream->array_key);
+    if (stream->tokener) json_tokener_free(stream->tokener);
+    response_free(stream->element);
+    response_free(stream->skeleton);
+    free(stream);
+}
+
+static void append(Response* sink, const char* data, size_t len) {
+    if (len > 0) response_write_callback((void*)data, 1, len, sink);
+}
+
+static bool is_blank(const char* data, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        if (data[i] != ' ' && data[i] != '\t' && data[i] != '\n' && data[i] != '\r') return false;
+    }
+    return true;
+}
+
+// Parse the buffered element, hand it to the callback and reset the buffer
+static int emit_element(JsonStream* stream) {
+    const char* data = response_get_memory(stream->element);
+    size_t len = response_get_size(stream->element);
+    int ret = 0;
+
+    if (is_blank(data, len)) {
+        response_clear(stream->element);
+        return 0;
+    }
+
+    // Including the terminator lets json-c finish trailing scalars
+    json_tokener_reset(stream->tokener);
+    struct json_object* element = json_tokener_parse_ex(stream->tokener, data, (int)len + 1);
+    if (!element || json_tokener_get_error(stream->tokener) != json_tokener_success) {
+        fprintf(stderr, "Failed to parse JSON array element: %s\n",
+                json_tokener_error_desc(json_tokener_get_error(stream->tokener)));
+        ret = -1;
+    } else {
+        stream->count++;
+        if (stream->on_element && stream->on_element(element, stream->userp) != 0) {
+            ret = -1;
+        }
+    }
+
+    if (element) json_object_put(element);
+    response_clear(stream->element);
+    return ret;
+}
+
+// A bare top-level array is accepted even when a key was requested, which
+// covers servers that answer paginated endpoints without an envelope
+static bool is_target_array(const JsonStream* stream) {
+    if (stream->depth == 0) return true;
+    return stream->array_key && stream->depth == 1 && !stream->expect_key && strcmp(stream->key, stream->array_key) == 0;
+}
+
+static int feed_bytes(JsonStream* stream, const char* data, size_t len) {
+    if (!stream || stream->failed) return -1;
+
+    // Consecutive bytes bound for the same buffer are appended as one run
+    size_t run_start = 0;
+    Response* run_sink = stream->state == STREAM_IN_ARRAY ? stream->element : stream->skeleton;
+
+    for (size_t i = 0; i < len; i++) {
+        char c = data[i];
+
+        if (stream->in_string) {
+            if (stream->escaped) {
+                stream->escaped = false;
+            } else if (c == '\\') {
+                stream->escaped = true;
+            } else if (c == '"') {
+                stream->in_string = false;
+                if (stream->capturing_key) {
+                    stream->capturing_key = false;
+                    stream->expect_key = false;
+                    stream->key[stream->key_len] = '\0';
+                }
+                continue;
+            }
+            if (stream->capturing_key && stream->key_len < JSON_STREAM_MAX_KEY - 1) {
+                stream->key[stream->key_len++] = c;
+            }
+            continue;
+        }
+
+        bool array_boundary = false;
+        switch (c) {
+            case '"':
+                stream->in_string = true;
+                if (stream->state == STREAM_SEEKING && stream->depth == 1 && stream->expect_key) {
+                    stream->capturing_key = true;
+                    stream->key_len = 0;
+                }
+                break;
+
+            case '{':
+            case '[':
+                if (stream->state == STREAM_SEEKING && c == '[' && is_target_array(stream)) {
+                    array_boundary = true;
+                } else if (stream->state == STREAM_SEEKING && c == '{' && stream->depth == 0) {
+                    stream->expect_key = true;
+                }
+                stream->depth++;
+                break;
+
+            case '}':
+            case ']':
+                if (stream->state == STREAM_IN_ARRAY && stream->depth == stream->array_depth) {
+                    array_boundary = true;
+                }
+                stream->depth--;
+                break;
+
+            case ',':
+                if (stream->state == STREAM_IN_ARRAY && stream->depth == stream->array_depth) {
+                    array_boundary = true;
+                } else if (stream->depth == 1) {
+                    stream->expect_key = true;
+                }
+                break;
+
+            default:
+                break;
+        }
+
+        if (!array_boundary) continue;
+
+        // Flush the run up to (not including) the boundary byte
+        append(run_sink, data + run_start, i - run_start);
+        run_start = i + 1;
+
+        if (stream->state == STREAM_SEEKING) {
+            append(stream->skeleton, "[", 1);
+            stream->state = STREAM_IN_ARRAY;
+            stream->array_depth = stream->depth;
+            run_sink = stream->element;
+        } else {
+            if (emit_element(stream) != 0) {
+                stream->failed = true;
+                return -1;
+            }
+            if (c == ']') {
+                append(stream->skeleton, "]", 1);
+                stream->state = STREAM_DONE;
+                run_sink = stream->skeleton;
+            }
+        }
+    }
+
+    append(run_sink, data + run_start, len - run_start);
+    return 0;
+}
+
+int json_stream_feed(JsonStream* stream, const char* data, size_t len) {
+    uint64_t start = trace_now_us();
+    int result = feed_bytes(stream, data, len);
+
+    if (stream) {
+        if (!stream->decode_start) stream->decode_start = start;
+        stream->decode_us += trace_now_us() - start;
+        stream->decode_bytes += len;
+    }
+    return result;
+}
+
+size_t json_stream_write_callback(void* contents, size_t size, size_t nmemb, void* userp) {
+    size_t realsize = size * nmemb;
+    JsonStream* stream = (JsonStream*)userp;
+
+    if (json_stream_feed(stream, (const char*)contents, realsize) != 0) {
+        return 0;  // Aborts the transfer
+    }
+    return realsize;
+}
+
+int json_stream_finish(JsonStream* stream, struct json_object** envelope) {
+    if (envelope) *envelope = NULL;
+    if (!stream) return -1;
+
+    // Parsing is spread over the transfer; the span covers only the time spent in it
+    if (stream->decode_start) {
+        trace_span(TRACE_JSON_DECODE, stream->decode_start, stream->decode_start + stream->decode_us,
+                   stream->decode_bytes);
+    }
+    if (stream->failed) return -1;
+
+    // An object without the named member (or with it null) simply has no elements
+    bool seen_array = stream->state == STREAM_DONE ||
+                      (stream->state == STREAM_SEEKING && stream->array_key && response_get_size(stream->skeleton) > 0);
+    if (!seen_array || stream->depth != 0 || stream->in_string) {
+        fprintf(stderr, "Truncated or unexpected JSON document\n");
+        return -1;
+    }
+
+    if (envelope) {
+        *envelope = json_tokener_parse(response_get_memory(stream->skeleton));
+        if (!*envelope) {
+            fprintf(stderr, "Failed to parse JSON envelope\n");
+            return -1;
+        }
+    }
+    return stream->count;
+}
+
+char* json_get_string_dup(Arena* arena, struct json_object* obj, const char* key) {
+    struct json_object* value = json_object_object_get(obj, key);
+    if (!value || json_object_is_type(value, json_type_null)) return NULL;
+    return arena_strdup(arena, json_object_get_string(value));
+}
+
+int* json_get_int_dup(Arena* arena, struct json_object* obj, const char* key) {
+    struct json_object* value = json_object_object_get(obj, key);
+    if (!value || json_object_is_type(value, json_type_null)) return NULL;
+
+    int* copy = arena_alloc(arena, sizeof(int));
+    if (copy) *copy = json_object_get_int(value);
+    return copy;
+}
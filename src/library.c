@@ -0,0 +1,607 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <errno.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "library.h"
+#include "catalog.h"
+
+#define LIBRARY_INDEX_NAME "library"
+#define LIBRARY_MAGIC "RMLB"
+#define LIBRARY_VERSION 1
+#define LIBRARY_FOLDER_NAME_SIZE 64
+#define LIBRARY_NOTE_BUCKETS 64
+
+// Bits of LibraryFile.flags
+#define LIBRARY_FILE_DIR (1u << 0)   // Multi-file ROMs are folders
+
+/*
+ * Index file layout (native byte order, the file never leaves the device):
+ *
+ *   LibraryHeader
+ *   LibraryFolder[folder_count]   one per scanned ROM folder, with its mtime
+ *   LibraryFile[file_count]       entries of every folder, grouped by folder
+ *   names                         names_size bytes of NUL-terminated file names
+ */
+
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    uint32_t folder_count;
+    uint32_t file_count;
+    uint32_t names_size;
+} LibraryHeader;
+
+typedef struct {
+    char name[LIBRARY_FOLDER_NAME_SIZE];
+    int64_t mtime;               // Of the directory itself, -1 when it does not exist
+    uint32_t first_file;
+    uint32_t file_count;
+} LibraryFolder;
+
+typedef struct {
+    uint64_t size;
+    int64_t mtime;
+    uint32_t folder;
+    uint32_t name;               // Offset into names
+    uint32_t flags;
+} LibraryFile;
+
+// Immutable once built; the scan thread reads the current one while building the next
+typedef struct {
+    LibraryFolder* folders;
+    uint32_t folder_count;
+    LibraryFile* files;
+    uint32_t file_count;
+    char* names;
+    uint32_t names_size;
+    uint32_t* slots;             // Open addressing over files, file index + 1, 0 when empty
+    uint32_t* stem_slots;        // Same, keyed on the name without its extension
+    uint32_t slot_count;
+} LibraryIndex;
+
+// File recorded by the main thread since the last scan
+typedef struct LibraryNote {
+    struct LibraryNote* next;
+    uint64_t size;
+    uint32_t flags;
+    char key[];                  // "FOLDER/name"
+} LibraryNote;
+
+struct LocalLibrary {
+    LibraryIndex* index;         // Swapped only by the main thread
+    LibraryNote* notes[LIBRARY_NOTE_BUCKETS];
+    pthread_t thread;
+    bool scanning;               // Thread started and not joined yet, main thread only
+    int scan_finished;           // Set by the scan thread
+    int stopping;
+    char (*scan_folders)[LIBRARY_FOLDER_NAME_SIZE];
+    int scan_folder_count;
+    char (*pending_folders)[LIBRARY_FOLDER_NAME_SIZE];  // Scan requested while one was running
+    int pending_folder_count;
+    LibraryIndex* scanned;       // Result waiting for library_update
+    library_notify_fn notify;
+    void* notify_userp;
+};
+
+static uint32_t fnv1a_update(uint32_t hash, const char* text) {
+    for (const unsigned char* p = (const unsigned char*)text; *p; p++) {
+        hash ^= *p;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static uint32_t file_key_hash(const char* folder, const char* name) {
+    return fnv1a_update(fnv1a_update(fnv1a_update(2166136261u, folder), "/"), name);
+}
+
+// Length of name without its extension, the whole name when it has none
+static size_t stem_length(const char* name) {
+    const char* dot = strrchr(name, '.');
+    return dot && dot != name ? (size_t)(dot - name) : strlen(name);
+}
+
+static uint32_t stem_key_hash(const char* folder, const char* name, size_t length) {
+    uint32_t hash = fnv1a_update(fnv1a_update(2166136261u, folder), "/");
+    for (size_t i = 0; i < length; i++) {
+        hash ^= (unsigned char)name[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static void index_free(LibraryIndex* index) {
+    if (!index) return;
+    free(index->folders);
+    free(index->files);
+    free(index->names);
+    free(index->slots);
+    free(index->stem_slots);
+    free(index);
+}
+
+// Hash every file of the index, at most half the slots used
+static int index_build_slots(LibraryIndex* index) {
+    uint32_t slot_count = 64;
+    while (slot_count < index->file_count * 2) slot_count *= 2;
+
+    index->slots = calloc(slot_count, sizeof(uint32_t));
+    index->stem_slots = calloc(slot_count, sizeof(uint32_t));
+    if (!index->slots || !index->stem_slots) return -1;
+    index->slot_count = slot_count;
+
+    for (uint32_t i = 0; i < index->file_count; i++) {
+        const LibraryFile* file = &index->files[i];
+        const char* folder = index->folders[file->folder].name;
+        const char* name = index->names + file->name;
+
+        uint32_t slot = file_key_hash(folder, name) & (slot_count - 1);
+        while (index->slots[slot]) slot = (slot + 1) & (slot_count - 1);
+        index->slots[slot] = i + 1;
+
+        slot = stem_key_hash(folder, name, stem_length(name)) & (slot_count - 1);
+        while (index->stem_slots[slot]) slot = (slot + 1) & (slot_count - 1);
+        index->stem_slots[slot] = i + 1;
+    }
+    return 0;
+}
+
+static const LibraryFolder* index_find_folder(const LibraryIndex* index, const char* folder) {
+    for (uint32_t i = 0; index && i < index->folder_count; i++) {
+        if (strcmp(index->folders[i].name, folder) == 0) return &index->folders[i];
+    }
+    return NULL;
+}
+
+static const LibraryFile* index_find_file(const LibraryIndex* index, const char* folder, const char* name) {
+    if (!index || !index->slot_count) return NULL;
+
+    uint32_t slot = file_key_hash(folder, name) & (index->slot_count - 1);
+    while (index->slots[slot]) {
+        const LibraryFile* file = &index->files[index->slots[slot] - 1];
+        if (strcmp(index->names + file->name, name) == 0 && strcmp(index->folders[file->folder].name, folder) == 0) {
+            return file;
+        }
+        slot = (slot + 1) & (index->slot_count - 1);
+    }
+    return NULL;
+}
+
+// Any file whose name without extension matches, e.g. the ROM unpacked from an archive
+static const LibraryFile* index_find_stem(const LibraryIndex* index, const char* folder, const char* name, size_t length) {
+    if (!index || !index->slot_count) return NULL;
+
+    uint32_t slot = stem_key_hash(folder, name, length) & (index->slot_count - 1);
+    while (index->stem_slots[slot]) {
+        const LibraryFile* file = &index->files[index->stem_slots[slot] - 1];
+        const char* file_name = index->names + file->name;
+        if (stem_length(file_name) == length && strncmp(file_name, name, length) == 0 &&
+            strcmp(index->folders[file->folder].name, folder) == 0) {
+            return file;
+        }
+        slot = (slot + 1) & (index->slot_count - 1);
+    }
+    return NULL;
+}
+
+/* Persistence */
+
+static void index_path(char* path, size_t path_size, const char* extension) {
+    snprintf(path, path_size, "%s/%s.%s", CATALOG_CACHE_DIR, LIBRARY_INDEX_NAME, extension);
+}
+
+static LibraryIndex* index_load(void) {
+    char path[512];
+    index_path(path, sizeof(path), "idx");
+
+    FILE* file = fopen(path, "rb");
+    if (!file) return NULL;
+
+    LibraryHeader header;
+    LibraryIndex* index = calloc(1, sizeof(LibraryIndex));
+    if (!index || fread(&header, sizeof(header), 1, file) != 1 ||
+        memcmp(header.magic, LIBRARY_MAGIC, 4) != 0 || header.version != LIBRARY_VERSION) {
+        goto fail;
+    }
+
+    index->folder_count = header.folder_count;
+    index->file_count = header.file_count;
+    index->names_size = header.names_size;
+    index->folders = malloc((header.folder_count + 1) * sizeof(LibraryFolder));
+    index->files = malloc((header.file_count + 1) * sizeof(LibraryFile));
+    index->names = malloc(header.names_size + 1);
+    if (!index->folders || !index->files || !index->names ||
+        fread(index->folders, sizeof(LibraryFolder), header.folder_count, file) != header.folder_count ||
+        fread(index->files, sizeof(LibraryFile), header.file_count, file) != header.file_count ||
+        fread(index->names, 1, header.names_size, file) != header.names_size) {
+        goto fail;
+    }
+    fclose(file);
+    file = NULL;
+
+    // Never trust offsets read from the card
+    for (uint32_t i = 0; i < index->folder_count; i++) {
+        index->folders[i].name[LIBRARY_FOLDER_NAME_SIZE - 1] = '\0';
+    }
+    for (uint32_t i = 0; i < index->file_count; i++) {
+        if (index->files[i].folder >= index->folder_count || index->files[i].name >= index->names_size) goto fail;
+    }
+    if (index->names_size == 0 || index->names[index->names_size - 1] != '\0') goto fail;
+
+    if (index_build_slots(index) != 0) goto fail;
+    return index;
+
+fail:
+    fprintf(stderr, "Ignoring invalid library index %s\n", path);
+    if (file) fclose(file);
+    index_free(index);
+    return NULL;
+}
+
+static void index_save(const LibraryIndex* index) {
+    char path[512], tmp_path[512];
+    index_path(path, sizeof(path), "idx");
+    index_path(tmp_path, sizeof(tmp_path), "idx.tmp");
+
+    if (mkdir(CATALOG_CACHE_DIR, 0755) != 0 && errno != EEXIST) return;
+
+    FILE* file = fopen(tmp_path, "wb");
+    if (!file) {
+        fprintf(stderr, "Failed to write library index: %s\n", strerror(errno));
+        return;
+    }
+
+    LibraryHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, LIBRARY_MAGIC, 4);
+    header.version = LIBRARY_VERSION;
+    header.folder_count = index->folder_count;
+    header.file_count = index->file_count;
+    header.names_size = index->names_size;
+
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+              fwrite(index->folders, sizeof(LibraryFolder), index->folder_count, file) == index->folder_count &&
+              fwrite(index->files, sizeof(LibraryFile), index->file_count, file) == index->file_count &&
+              fwrite(index->names, 1, index->names_size, file) == index->names_size;
+    if (fclose(file) != 0) ok = false;
+
+    if (!ok || rename(tmp_path, path) != 0) {
+        fprintf(stderr, "Failed to write library index\n");
+        unlink(tmp_path);
+    }
+}
+
+/* Scanning */
+
+typedef struct {
+    LibraryIndex* index;
+    uint32_t folder_capacity;
+    uint32_t file_capacity;
+    uint32_t names_capacity;
+    bool failed;
+} IndexBuilder;
+
+static uint32_t builder_add_name(IndexBuilder* builder, const char* name) {
+    LibraryIndex* index = builder->index;
+    size_t length = strlen(name) + 1;
+
+    if (index->names_size + length > builder->names_capacity) {
+        uint32_t capacity = builder->names_capacity ? builder->names_capacity : 4096;
+        while (capacity < index->names_size + length) capacity *= 2;
+        char* names = realloc(index->names, capacity);
+        if (!names) {
+            builder->failed = true;
+            return 0;
+        }
+        index->names = names;
+        builder->names_capacity = capacity;
+    }
+
+    uint32_t offset = index->names_size;
+    memcpy(index->names + offset, name, length);
+    index->names_size += length;
+    return offset;
+}
+
+static void builder_add_file(IndexBuilder* builder, uint32_t folder, const char* name,
+                             uint64_t size, int64_t mtime, uint32_t flags) {
+    LibraryIndex* index = builder->index;
+
+    if (index->file_count == builder->file_capacity) {
+        uint32_t capacity = builder->file_capacity ? builder->file_capacity * 2 : 256;
+        LibraryFile* files = realloc(index->files, capacity * sizeof(LibraryFile));
+        if (!files) {
+            builder->failed = true;
+            return;
+        }
+        index->files = files;
+        builder->file_capacity = capacity;
+    }
+
+    LibraryFile* file = &index->files[index->file_count];
+    file->size = size;
+    file->mtime = mtime;
+    file->folder = folder;
+    file->flags = flags;
+    file->name = builder_add_name(builder, name);
+    if (!builder->failed) index->file_count++;
+}
+
+static uint32_t builder_add_folder(IndexBuilder* builder, const char* name, int64_t mtime) {
+    LibraryIndex* index = builder->index;
+
+    if (index->folder_count == builder->folder_capacity) {
+        uint32_t capacity = builder->folder_capacity ? builder->folder_capacity * 2 : 32;
+        LibraryFolder* folders = realloc(index->folders, capacity * sizeof(LibraryFolder));
+        if (!folders) {
+            builder->failed = true;
+            return 0;
+        }
+        index->folders = folders;
+        builder->folder_capacity = capacity;
+    }
+
+    LibraryFolder* folder = &index->folders[index->folder_count];
+    memset(folder, 0, sizeof(LibraryFolder));
+    snprintf(folder->name, sizeof(folder->name), "%s", name);
+    folder->mtime = mtime;
+    folder->first_file = index->file_count;
+    return index->folder_count++;
+}
+
+// Leftovers of interrupted downloads are not part of the library
+static bool is_partial_download(const char* name) {
+    size_t length = strlen(name);
+    return (length > 5 && strcmp(name + length - 5, ".part") == 0) ||
+           (length > 10 && strcmp(name + length - 10, ".part.hash") == 0);
+}
+
+static void scan_folder(LocalLibrary* library, IndexBuilder* builder, uint32_t folder_index, const char* folder_path) {
+    DIR* dir = opendir(folder_path);
+    if (!dir) return;
+
+    struct dirent* entry;
+    char path[1024];
+    while ((entry = readdir(dir)) && !__atomic_load_n(&library->stopping, __ATOMIC_ACQUIRE)) {
+        if (entry->d_name[0] == '.' || is_partial_download(entry->d_name)) continue;
+
+        struct stat st;
+        snprintf(path, sizeof(path), "%s/%s", folder_path, entry->d_name);
+        if (stat(path, &st) != 0) continue;
+
+        uint32_t flags = S_ISDIR(st.st_mode) ? LIBRARY_FILE_DIR : 0;
+        if (!flags && !S_ISREG(st.st_mode)) continue;
+        builder_add_file(builder, folder_index, entry->d_name, (uint64_t)st.st_size, (int64_t)st.st_mtime, flags);
+    }
+    closedir(dir);
+}
+
+static void* scan_main(void* userp) {
+    LocalLibrary* library = (LocalLibrary*)userp;
+    const LibraryIndex* previous = library->index;
+    bool changed = !previous || previous->folder_count != (uint32_t)library->scan_folder_count;
+
+    IndexBuilder builder;
+    memset(&builder, 0, sizeof(builder));
+    builder.index = calloc(1, sizeof(LibraryIndex));
+    builder.failed = builder.index == NULL;
+    if (!builder.failed) builder_add_name(&builder, "");
+
+    for (int i = 0; i < library->scan_folder_count && !builder.failed; i++) {
+        const char* name = library->scan_folders[i];
+        char folder_path[512];
+        snprintf(folder_path, sizeof(folder_path), "%s/%s", ROMS_ROOT, name);
+
+        struct stat st;
+        int64_t mtime = stat(folder_path, &st) == 0 && S_ISDIR(st.st_mode) ? (int64_t)st.st_mtime : -1;
+        uint32_t folder_index = builder_add_folder(&builder, name, mtime);
+        if (builder.failed) break;
+
+        // Adding or removing a file bumps the directory mtime, so an unchanged
+        // folder keeps its entries without a single stat of its files
+        const LibraryFolder* known = index_find_folder(previous, name);
+        if (known && known->mtime == mtime) {
+            for (uint32_t j = 0; j < known->file_count; j++) {
+                const LibraryFile* file = &previous->files[known->first_file + j];
+                builder_add_file(&builder, folder_index, previous->names + file->name, file->size, file->mtime, file->flags);
+            }
+        } else {
+            changed = true;
+            if (mtime >= 0) scan_folder(library, &builder, folder_index, folder_path);
+        }
+        builder.index->folders[folder_index].file_count = builder.index->file_count - builder.index->folders[folder_index].first_file;
+    }
+
+    LibraryIndex* result = NULL;
+    if (!builder.failed && !__atomic_load_n(&library->stopping, __ATOMIC_ACQUIRE) &&
+        index_build_slots(builder.index) == 0) {
+        result = builder.index;
+        if (changed) index_save(result);
+    } else {
+        index_free(builder.index);
+    }
+
+    library->scanned = result;
+    __atomic_store_n(&library->scan_finished, 1, __ATOMIC_RELEASE);
+    if (library->notify) library->notify(library->notify_userp);
+    return NULL;
+}
+
+/* Public interface */
+
+LocalLibrary* library_init(library_notify_fn notify, void* userp) {
+    LocalLibrary* library = calloc(1, sizeof(struct LocalLibrary));
+    if (!library) return NULL;
+
+    library->notify = notify;
+    library->notify_userp = userp;
+    library->index = index_load();
+    return library;
+}
+
+static void free_notes(LocalLibrary* library) {
+    for (int i = 0; i < LIBRARY_NOTE_BUCKETS; i++) {
+        LibraryNote* note = library->notes[i];
+        while (note) {
+            LibraryNote* next = note->next;
+            free(note);
+            note = next;
+        }
+        library->notes[i] = NULL;
+    }
+}
+
+void library_free(LocalLibrary* library) {
+    if (!library) return;
+
+    if (library->scanning) {
+        __atomic_store_n(&library->stopping, 1, __ATOMIC_RELEASE);
+        pthread_join(library->thread, NULL);
+        index_free(library->scanned);
+    }
+    free(library->scan_folders);
+    free(library->pending_folders);
+    free_notes(library);
+    index_free(library->index);
+    free(library);
+}
+
+static int start_scan(LocalLibrary* library) {
+    library->scanned = NULL;
+    library->scan_finished = 0;
+    if (pthread_create(&library->thread, NULL, scan_main, library) != 0) {
+        fprintf(stderr, "Failed to start library scan\n");
+        return -1;
+    }
+    library->scanning = true;
+    return 0;
+}
+
+int library_scan(LocalLibrary* library, const RomMPlatform* platforms, int count) {
+    if (!library) return -1;
+
+    // Several platforms can share one Onion folder
+    char (*folders)[LIBRARY_FOLDER_NAME_SIZE] = malloc((count + 1) * sizeof(*folders));
+    if (!folders) return -1;
+    int folder_count = 0;
+    for (int i = 0; i < count; i++) {
+        const char* folder = platform_rom_folder(&platforms[i]);
+        if (!folder) continue;
+        bool seen = false;
+        for (int j = 0; j < folder_count; j++) {
+            if (strcmp(folders[j], folder) == 0) seen = true;
+        }
+        if (!seen) snprintf(folders[folder_count++], LIBRARY_FOLDER_NAME_SIZE, "%s", folder);
+    }
+
+    // The running scan reads scan_folders, the request waits for library_update
+    if (library->scanning) {
+        free(library->pending_folders);
+        library->pending_folders = folders;
+        library->pending_folder_count = folder_count;
+        return 0;
+    }
+
+    free(library->scan_folders);
+    library->scan_folders = folders;
+    library->scan_folder_count = folder_count;
+    return start_scan(library);
+}
+
+bool library_update(LocalLibrary* library) {
+    if (!library || !library->scanning || !__atomic_load_n(&library->scan_finished, __ATOMIC_ACQUIRE)) return false;
+
+    pthread_join(library->thread, NULL);
+    library->scanning = false;
+
+    // Notes stay: a download may have finished after its folder was read
+    bool changed = library->scanned != NULL;
+    if (changed) {
+        index_free(library->index);
+        library->index = library->scanned;
+        library->scanned = NULL;
+    }
+
+    if (library->pending_folders) {
+        free(library->scan_folders);
+        library->scan_folders = library->pending_folders;
+        library->scan_folder_count = library->pending_folder_count;
+        library->pending_folders = NULL;
+        start_scan(library);
+    }
+    return changed;
+}
+
+static const LibraryNote* find_note(const LocalLibrary* library, const char* folder, const char* name) {
+    const LibraryNote* note = library->notes[file_key_hash(folder, name) % LIBRARY_NOTE_BUCKETS];
+    size_t folder_length = strlen(folder);
+
+    for (; note; note = note->next) {
+        if (strncmp(note->key, folder, folder_length) == 0 && note->key[folder_length] == '/' &&
+            strcmp(note->key + folder_length + 1, name) == 0) {
+            return note;
+        }
+    }
+    return NULL;
+}
+
+LibraryStatus library_rom_status(LocalLibrary* library, const RomMPlatform* platform, const RomMRom* rom) {
+    if (!library || !platform || !rom || !rom->file_name) return LIBRARY_UNKNOWN;
+
+    const char* folder = platform_rom_folder(platform);
+    if (!folder) return LIBRARY_UNKNOWN;
+    uint64_t size;
+    uint32_t flags;
+
+    const LibraryNote* note = find_note(library, folder, rom->file_name);
+    const LibraryFile* file = note ? NULL : index_find_file(library->index, folder, rom->file_name);
+    if (note) {
+        size = note->size;
+        flags = note->flags;
+    } else if (file) {
+        size = file->size;
+        flags = file->flags;
+    } else if (rom_is_zip(rom) && index_find_stem(library->index, folder, rom->file_name, stem_length(rom->file_name))) {
+        // Unpacked while downloading, the archive size says nothing about its contents
+        return LIBRARY_PRESENT;
+    } else {
+        return index_find_folder(library->index, folder) ? LIBRARY_MISSING : LIBRARY_UNKNOWN;
+    }
+
+    // Multi-file ROMs arrive as folders whose size says nothing
+    if ((flags & LIBRARY_FILE_DIR) || rom->multi || rom->file_size_bytes == 0) return LIBRARY_PRESENT;
+    return size == rom->file_size_bytes ? LIBRARY_PRESENT : LIBRARY_OUTDATED;
+}
+
+void library_note_file(LocalLibrary* library, const char* path) {
+    size_t root_length = strlen(ROMS_ROOT);
+    if (!library || !path || strncmp(path, ROMS_ROOT "/", root_length + 1) != 0) return;
+
+    // Only direct children of a ROM folder are indexed
+    const char* key = path + root_length + 1;
+    const char* slash = strchr(key, '/');
+    if (!slash || strchr(slash + 1, '/') || slash - key >= LIBRARY_FOLDER_NAME_SIZE) return;
+
+    struct stat st;
+    if (stat(path, &st) != 0) return;
+
+    char folder[LIBRARY_FOLDER_NAME_SIZE];
+    snprintf(folder, sizeof(folder), "%.*s", (int)(slash - key), key);
+
+    LibraryNote* note = (LibraryNote*)find_note(library, folder, slash + 1);
+    if (!note) {
+        note = malloc(sizeof(LibraryNote) + strlen(key) + 1);
+        if (!note) return;
+        strcpy(note->key, key);
+        uint32_t bucket = file_key_hash(folder, slash + 1) % LIBRARY_NOTE_BUCKETS;
+        note->next = library->notes[bucket];
+        library->notes[bucket] = note;
+    }
+    note->size = (uint64_t)st.st_size;
+    note->flags = S_ISDIR(st.st_mode) ? LIBRARY_FILE_DIR : 0;
+}
@@ -3,163 +3,436 @@
 #include <stdio.h>
 #include <json-c/json.h>
 #include "platform.h"
-#include "base64.h"
-#include "response.h"
-
-// Free memory for a single firmware
-void free_firmware(RomMPlatformFirmware* firmware) {
-    if (!firmware) return;
-
-    free(firmware->file_name);
-    free(firmware->file_name_no_tags);
-    free(firmware->file_name_no_ext);
-    free(firmware->file_extension);
-    free(firmware->file_path);
-    free(firmware->full_path);
-    free(firmware->crc_hash);
-    free(firmware->md5_hash);
-    free(firmware->sha1_hash);
-    free(firmware->created_at);
-    free(firmware->updated_at);
-}
-
-// Free memory for a platform, including its firmware
-void free_platform(RomMPlatform* platform) {
-    if (!platform) return;
-
-    free(platform->slug);
-    free(platform->fs_slug);
-    free(platform->name);
-    free(platform->logo_path);
-    free(platform->created_at);
-    free(platform->updated_at);
-}
-
-// Free an array of platforms
-void free_platform_list(RomMPlatform* platforms, int count) {
-    for (int i = 0; i < count; i++) {
-        free_platform(&platforms[i]);
+#include "http.h"
+#include "json_stream.h"
+#include "catalog.h"
+
+#define PLATFORM_CACHE_NAME "platforms"
+#define FIRMWARE_CACHE_NAME "firmware"   // Firmware of every platform, in platform order
+
+// RomM fs_slug to Onion OS ROM folder name
+static const struct {
+    const char* fs_slug;
+    const char* folder;
+} rom_folders[] = {
+    { "nes", "FC" },
+    { "famicom", "FC" },
+    { "fds", "FDS" },
+    { "snes", "SFC" },
+    { "sfam", "SFC" },
+    { "gb", "GB" },
+    { "gbc", "GBC" },
+    { "gba", "GBA" },
+    { "n64", "N64" },
+    { "virtualboy", "VB" },
+    { "pokemon-mini", "POKE" },
+    { "genesis", "MD" },
+    { "megadrive", "MD" },
+    { "genesis-slash-megadrive", "MD" },
+    { "sms", "MS" },
+    { "gamegear", "GG" },
+    { "gg", "GG" },
+    { "segacd", "SEGACD" },
+    { "sega32", "THIRTYTWOX" },
+    { "sg1000", "SEGASGONE" },
+    { "psx", "PS" },
+    { "ps", "PS" },
+    { "tg16", "PCE" },
+    { "pce", "PCE" },
+    { "turbografx16--1", "PCE" },
+    { "turbografx-16-slash-pc-engine-cd", "PCECD" },
+    { "neogeoaes", "NEOGEO" },
+    { "neogeomvs", "NEOGEO" },
+    { "neo-geo-pocket", "NGP" },
+    { "neo-geo-pocket-color", "NGP" },
+    { "ngp", "NGP" },
+    { "ngpc", "NGP" },
+    { "wonderswan", "WS" },
+    { "wonderswan-color", "WS" },
+    { "lynx", "LYNX" },
+    { "atari2600", "ATARI" },
+    { "atari5200", "FIFTYTWOHUNDRED" },
+    { "atari7800", "SEVEN" },
+    { "colecovision", "COLECO" },
+    { "intellivision", "INTELLIVISION" },
+    { "msx", "MSX" },
+    { "c64", "COMMODORE" },
+    { "amiga", "AMIGA" },
+    { "dos", "DOS" },
+    { "arcade", "ARCADE" },
+    { "cps1", "CPS1" },
+    { "cps2", "CPS2" },
+    { "cps3", "CPS3" },
+    { "pico-8", "PICO" },
+};
+
+// Names from the server become paths on the card, only a single component stays in its folder
+static bool single_component(const char* name) {
+    return name[0] && !strchr(name, '/') && strcmp(name, ".") != 0 && strcmp(name, "..") != 0;
+}
+
+// Onion folder for a platform's ROMs, falling back to the RomM folder name
+const char* platform_rom_folder(const RomMPlatform* platform) {
+    const char* fs_slug = platform->fs_slug ? platform->fs_slug : platform->slug;
+    if (!fs_slug) return "UNKNOWN";
+
+    for (size_t i = 0; i < sizeof(rom_folders) / sizeof(rom_folders[0]); i++) {
+        if (strcmp(rom_folders[i].fs_slug, fs_slug) == 0) return rom_folders[i].folder;
     }
-    free(platforms);
+    return single_component(fs_slug) ? fs_slug : NULL;
 }
 
+// Arcade cores load romsets as zip archives, extracting them breaks the set
+static const char* archive_folders[] = { "ARCADE", "CPS1", "CPS2", "CPS3", "NEOGEO" };
 
-// Function to generate the Basic Authorization header from username and password
-char* generate_authorization_header(const char* username, const char* password) {
-    // Create a buffer large enough to hold the base64-encoded credentials
-    char* auth_header = malloc(512);
-    if (auth_header == NULL) {
-        fprintf(stderr, "Failed to allocate memory for authorization header\n");
-        return NULL;
+bool platform_keeps_archives(const RomMPlatform* platform) {
+    const char* folder = platform_rom_folder(platform);
+    if (!folder) return false;
+    for (size_t i = 0; i < sizeof(archive_folders) / sizeof(archive_folders[0]); i++) {
+        if (strcmp(archive_folders[i], folder) == 0) return true;
     }
+    return false;
+}
 
-    // Format the username and password into the "username:password" format
-    char credentials[512];
-    snprintf(credentials, sizeof(credentials), "%s:%s", username, password);
+// Build the destination path of a ROM file on the SD card
+int platform_rom_path(const RomMPlatform* platform, const char* file_name, char* path, size_t path_size) {
+    const char* folder = platform_rom_folder(platform);
+    if (!folder || !file_name || !single_component(file_name)) return -1;
 
-    // Base64 encode the credentials and get the encoded string
-    size_t encoded_len;
-    unsigned char* encoded_credentials = base64_encode((unsigned char*)credentials, strlen(credentials), &encoded_len);
+    snprintf(path, path_size, "%s/%s/%s", ROMS_ROOT, folder, file_name);
+    return 0;
+}
+
+static void parse_firmware(Arena* arena, struct json_object* firmware_obj, RomMPlatformFirmware* firmware) {
+    memset(firmware, 0, sizeof(RomMPlatformFirmware));
+
+    firmware->id = json_object_get_int(json_object_object_get(firmware_obj, "id"));
+    firmware->file_name = json_get_string_dup(arena, firmware_obj, "file_name");
+    firmware->file_name_no_tags = json_get_string_dup(arena, firmware_obj, "file_name_no_tags");
+    firmware->file_name_no_ext = json_get_string_dup(arena, firmware_obj, "file_name_no_ext");
+    firmware->file_extension = json_get_string_dup(arena, firmware_obj, "file_extension");
+    firmware->file_path = json_get_string_dup(arena, firmware_obj, "file_path");
+    firmware->file_size_bytes = json_object_get_int(json_object_object_get(firmware_obj, "file_size_bytes"));
+    firmware->full_path = json_get_string_dup(arena, firmware_obj, "full_path");
+    firmware->is_verified = json_object_get_boolean(json_object_object_get(firmware_obj, "is_verified"));
+    firmware->crc_hash = json_get_string_dup(arena, firmware_obj, "crc_hash");
+    firmware->md5_hash = json_get_string_dup(arena, firmware_obj, "md5_hash");
+    firmware->sha1_hash = json_get_string_dup(arena, firmware_obj, "sha1_hash");
+    firmware->created_at = json_get_string_dup(arena, firmware_obj, "created_at");
+    firmware->updated_at = json_get_string_dup(arena, firmware_obj, "updated_at");
+}
 
-    if (encoded_credentials == NULL) {
-        fprintf(stderr, "Base64 encoding failed\n");
-        free(auth_header);
-        return NULL;
+// Populate a platform from its JSON object
+static void parse_platform(Arena* arena, struct json_object* platform_obj, RomMPlatform* platform) {
+    memset(platform, 0, sizeof(RomMPlatform));
+
+    platform->id = json_object_get_int(json_object_object_get(platform_obj, "id"));
+    platform->slug = json_get_string_dup(arena, platform_obj, "slug");
+    platform->fs_slug = json_get_string_dup(arena, platform_obj, "fs_slug");
+    platform->name = json_get_string_dup(arena, platform_obj, "name");
+    platform->rom_count = json_object_get_int(json_object_object_get(platform_obj, "rom_count"));
+    platform->logo_path = json_get_string_dup(arena, platform_obj, "logo_path");
+    platform->created_at = json_get_string_dup(arena, platform_obj, "created_at");
+    platform->updated_at = json_get_string_dup(arena, platform_obj, "updated_at");
+
+    // Handle nullable fields with NULL checks
+    struct json_object *igdb_id_obj = json_object_object_get(platform_obj, "igdb_id");
+    platform->igdb_id = igdb_id_obj == NULL ? -1 : json_object_get_int(igdb_id_obj);
+    struct json_object *sgdb_id_obj = json_object_object_get(platform_obj, "sgdb_id");
+    platform->sgdb_id = sgdb_id_obj == NULL ? -1 : json_object_get_int(sgdb_id_obj);
+    struct json_object *moby_id_obj = json_object_object_get(platform_obj, "moby_id");
+    platform->moby_id = moby_id_obj == NULL ? -1 : json_object_get_int(moby_id_obj);
+
+    struct json_object* firmware_array = json_object_object_get(platform_obj, "firmware");
+    int firmware_count = json_object_is_type(firmware_array, json_type_array) ?
+                         (int)json_object_array_length(firmware_array) : 0;
+    platform->firmware = firmware_count > 0 ? arena_alloc(arena, firmware_count * sizeof(RomMPlatformFirmware*)) : NULL;
+    for (int i = 0; platform->firmware && i < firmware_count; i++) {
+        RomMPlatformFirmware* firmware = arena_alloc(arena, sizeof(RomMPlatformFirmware));
+        if (!firmware) break;
+        parse_firmware(arena, json_object_array_get_idx(firmware_array, i), firmware);
+        platform->firmware[platform->firmware_count++] = firmware;
     }
+}
 
-    // Format the Authorization header with "Basic <encoded_credentials>"
-    snprintf(auth_header, 512, "Authorization: Basic %s", encoded_credentials);
+typedef struct {
+    Arena* arena;
+    platform_fn on_platform;
+    void* userp;
+} PlatformStreamContext;
 
-    // Free the memory allocated by base64_encode
-    free(encoded_credentials);
+static int on_platform_element(struct json_object* element, void* userp) {
+    PlatformStreamContext* ctx = (PlatformStreamContext*)userp;
+    RomMPlatform platform;
 
-    return auth_header;
+    parse_platform(ctx->arena, element, &platform);
+    return ctx->on_platform(&platform, ctx->userp);
 }
 
-// Function to fetch the platform list from the server
-int fetch_platform_list(const char* server_host, const char* username, const char* password, RomMPlatform** platform_list, int* platform_count) {
-    Response* resp = response_init();
-    char url[1024];
-    char auth_header[1024];
-    char command[2100];
-    FILE *fp;
-    char *line = NULL;
-    size_t len = 0;
-    ssize_t read;
-
-    if (!resp) {
-        fprintf(stderr, "Failed to initialize response\n");
+// Function to stream the platform list from the server, one record per completed array element
+int fetch_platform_list_stream(HttpSession* session, Arena* arena, platform_fn on_platform, void* userp) {
+    PlatformStreamContext ctx = { arena, on_platform, userp };
+    JsonStream* stream = json_stream_init(NULL, on_platform_element, &ctx);
+
+    if (!stream) {
+        fprintf(stderr, "Failed to initialize JSON stream\n");
+        return -1;
+    }
+
+    // Records are parsed inside the receive callback while the transfer runs
+    HttpRequest request = {
+        .path = "/api/platforms",
+        .compressed = true,
+        .write_fn = json_stream_write_callback,
+        .write_userp = stream,
+    };
+    int status = http_request(session, &request);
+    if (status != 200) {
+        fprintf(stderr, "Failed to fetch platform list (HTTP status %d)\n", status);
+        json_stream_free(stream);
         return -1;
     }
 
-    // Build the URL for the request
-    snprintf(url, sizeof(url), "%s/api/platforms", server_host);
+    int count = json_stream_finish(stream, NULL);
+    json_stream_free(stream);
+    return count;
+}
+
+typedef struct {
+    Arena* arena;
+    RomMPlatform* platforms;
+    int count;
+    int capacity;
+} PlatformListBuilder;
+
+static int append_platform(const RomMPlatform* platform, void* userp) {
+    PlatformListBuilder* builder = (PlatformListBuilder*)userp;
+
+    // Outgrown arrays stay in the arena, at most doubling the space the list needs
+    if (builder->count == builder->capacity) {
+        int new_capacity = builder->capacity ? builder->capacity * 2 : 32;
+        RomMPlatform* new_platforms = arena_alloc(builder->arena, new_capacity * sizeof(RomMPlatform));
+        if (!new_platforms) return -1;
+        if (builder->count) memcpy(new_platforms, builder->platforms, builder->count * sizeof(RomMPlatform));
+        builder->platforms = new_platforms;
+        builder->capacity = new_capacity;
+    }
+
+    builder->platforms[builder->count++] = *platform;
+    return 0;
+}
 
-    // Create the Authorization header
-    snprintf(auth_header, sizeof(auth_header), "%s", generate_authorization_header(username, password));
+// Function to fetch the platform list from the server
+int fetch_platform_list(HttpSession* session, Arena* arena, RomMPlatform** platform_list, int* platform_count) {
+    PlatformListBuilder builder = { arena, NULL, 0, 0 };
 
-    // Build the curl command
-    snprintf(command, sizeof(command), "/mnt/SDCARD/.tmp_update/bin/curl -s -H \"%s\" %s", auth_header, url);
+    if (fetch_platform_list_stream(session, arena, append_platform, &builder) < 0) return -1;
 
-    // Execute curl and capture the response
-    fp = popen(command, "r");
-    if (fp == NULL) {
-        fprintf(stderr, "Failed to run curl command\n");
-        response_free(resp);
+    *platform_list = builder.platforms;
+    *platform_count = builder.count;
+    return 0;
+}
+
+// Copy firmware decoded from a catalog mapping into the arena
+static RomMPlatformFirmware* copy_firmware(Arena* arena, const RomMPlatformFirmware* record) {
+    RomMPlatformFirmware* firmware = arena_alloc(arena, sizeof(RomMPlatformFirmware));
+    if (!firmware) return NULL;
+
+    *firmware = *record;
+    firmware->file_name = arena_strdup(arena, record->file_name);
+    firmware->file_name_no_tags = arena_strdup(arena, record->file_name_no_tags);
+    firmware->file_name_no_ext = arena_strdup(arena, record->file_name_no_ext);
+    firmware->file_extension = arena_strdup(arena, record->file_extension);
+    firmware->file_path = arena_strdup(arena, record->file_path);
+    firmware->full_path = arena_strdup(arena, record->full_path);
+    firmware->crc_hash = arena_strdup(arena, record->crc_hash);
+    firmware->md5_hash = arena_strdup(arena, record->md5_hash);
+    firmware->sha1_hash = arena_strdup(arena, record->sha1_hash);
+    firmware->created_at = arena_strdup(arena, record->created_at);
+    firmware->updated_at = arena_strdup(arena, record->updated_at);
+    return firmware;
+}
+
+// Attach the cached firmware to a list loaded from the platform catalog
+static void load_firmware_cache(Arena* arena, RomMPlatform* platforms, int count) {
+    CatalogFile* catalog = catalog_open(FIRMWARE_CACHE_NAME, CATALOG_KIND_FIRMWARE);
+    if (!catalog) return;
+
+    // Records were written platform by platform, so each platform's firmware is one run
+    int total = catalog_count(catalog);
+    int run_start = 0;
+    while (run_start < total) {
+        RomMPlatformFirmware record;
+        int platform_id = catalog_get_firmware(catalog, run_start, &record);
+        int run_end = run_start + 1;
+        while (run_end < total && catalog_get_firmware(catalog, run_end, &record) == platform_id) run_end++;
+
+        RomMPlatform* platform = NULL;
+        for (int i = 0; i < count; i++) {
+            if (platforms[i].id == platform_id) platform = &platforms[i];
+        }
+        if (platform) {
+            platform->firmware = arena_alloc(arena, (run_end - run_start) * sizeof(RomMPlatformFirmware*));
+            platform->firmware_count = 0;
+            for (int i = run_start; platform->firmware && i < run_end; i++) {
+                catalog_get_firmware(catalog, i, &record);
+                RomMPlatformFirmware* firmware = copy_firmware(arena, &record);
+                if (!firmware) break;
+                platform->firmware[platform->firmware_count++] = firmware;
+            }
+        }
+        run_start = run_end;
+    }
+    catalog_close(catalog);
+}
+
+// Load the platform list saved by the last successful refresh, without any network access.
+// The list is small, so records are copied out of the catalog mapping into the arena.
+int load_platform_list_cache(Arena* arena, RomMPlatform** platform_list, int* platform_count) {
+    CatalogFile* catalog = catalog_open(PLATFORM_CACHE_NAME, CATALOG_KIND_PLATFORMS);
+    if (!catalog) return -1;
+
+    int count = catalog_count(catalog);
+    RomMPlatform* platforms = arena_alloc(arena, count * sizeof(RomMPlatform));
+    if (!platforms) {
+        catalog_close(catalog);
         return -1;
     }
 
-    // Read the output of the curl command into a string buffer
-    while ((read = getline(&line, &len, fp)) != -1) {
-        response_append(resp, line);
+    for (int i = 0; i < count; i++) {
+        RomMPlatform record;
+        catalog_get_platform(catalog, i, &record);
+
+        platforms[i] = record;
+        platforms[i].slug = arena_strdup(arena, record.slug);
+        platforms[i].fs_slug = arena_strdup(arena, record.fs_slug);
+        platforms[i].name = arena_strdup(arena, record.name);
+        platforms[i].logo_path = arena_strdup(arena, record.logo_path);
+        platforms[i].created_at = arena_strdup(arena, record.created_at);
+        platforms[i].updated_at = arena_strdup(arena, record.updated_at);
+    }
+    catalog_close(catalog);
+    load_firmware_cache(arena, platforms, count);
+
+    *platform_list = platforms;
+    *platform_count = count;
+    return 0;
+}
+
+// Newest updated_at of a list; ISO 8601 strings compare chronologically
+const char* platform_list_newest_update(const RomMPlatform* platforms, int count) {
+    const char* newest = NULL;
+
+    for (int i = 0; i < count; i++) {
+        if (platforms[i].updated_at && (!newest || strcmp(platforms[i].updated_at, newest) > 0)) {
+            newest = platforms[i].updated_at;
+        }
     }
+    return newest;
+}
+
+static bool same_string(const char* a, const char* b) {
+    return a && b ? strcmp(a, b) == 0 : a == b;
+}
+
+static bool firmware_match(const RomMPlatformFirmware* a, const RomMPlatformFirmware* b) {
+    return a->id == b->id && a->file_size_bytes == b->file_size_bytes && a->is_verified == b->is_verified &&
+           same_string(a->file_name, b->file_name) && same_string(a->file_name_no_tags, b->file_name_no_tags) &&
+           same_string(a->file_name_no_ext, b->file_name_no_ext) &&
+           same_string(a->file_extension, b->file_extension) && same_string(a->file_path, b->file_path) &&
+           same_string(a->full_path, b->full_path) && same_string(a->crc_hash, b->crc_hash) &&
+           same_string(a->md5_hash, b->md5_hash) && same_string(a->sha1_hash, b->sha1_hash) &&
+           same_string(a->created_at, b->created_at) && same_string(a->updated_at, b->updated_at);
+}
 
-    fclose(fp);
-    if (line) {
-        free(line);
+// Change detection for servers that ignore conditional requests: every field the
+// catalogs store, so a rename or a new firmware hash reaches the UI
+static bool platform_lists_match(const RomMPlatform* a, int a_count, const RomMPlatform* b, int b_count) {
+    if (a_count != b_count) return false;
+
+    for (int i = 0; i < a_count; i++) {
+        if (a[i].id != b[i].id || a[i].rom_count != b[i].rom_count || a[i].igdb_id != b[i].igdb_id ||
+            a[i].sgdb_id != b[i].sgdb_id || a[i].moby_id != b[i].moby_id) {
+            return false;
+        }
+        if (!same_string(a[i].slug, b[i].slug) || !same_string(a[i].fs_slug, b[i].fs_slug) ||
+            !same_string(a[i].name, b[i].name) || !same_string(a[i].logo_path, b[i].logo_path) ||
+            !same_string(a[i].created_at, b[i].created_at) || !same_string(a[i].updated_at, b[i].updated_at)) {
+            return false;
+        }
+        if (a[i].firmware_count != b[i].firmware_count) return false;
+        for (int j = 0; j < a[i].firmware_count; j++) {
+            if (!firmware_match(a[i].firmware[j], b[i].firmware[j])) return false;
+        }
     }
+    return true;
+}
 
-    // Parse the JSON response
-    struct json_object *parsed_json;
-    parsed_json = json_tokener_parse(response_get_memory(resp));
+// Revalidate a (cached) platform list against the server.
+// Returns CATALOG_FRESH with a new list only when something changed, otherwise
+// CATALOG_UNCHANGED, CATALOG_OFFLINE or CATALOG_ERROR and leaves the outputs untouched.
+// Parsed records land in arena whatever the outcome; the caller releases it.
+int refresh_platform_list(HttpSession* session, const RomMPlatform* current, int current_count,
+                          Arena* arena, RomMPlatform** platform_list, int* platform_count) {
+    PlatformListBuilder builder = { arena, NULL, 0, 0 };
+    PlatformStreamContext ctx = { arena, append_platform, &builder };
+    JsonStream* stream = json_stream_init(NULL, on_platform_element, &ctx);
+    if (!stream) return CATALOG_ERROR;
 
-    if (parsed_json == NULL) {
-        fprintf(stderr, "Failed to parse JSON response\n");
-        response_free(resp);
-        return -1;
+    // Without a list in memory the cached copy is no use as a 304 target, and
+    // neither is one whose firmware catalog is missing or from another revision
+    CatalogValidators validators;
+    CatalogValidators received;
+    CatalogFile* catalog = current ? catalog_open(PLATFORM_CACHE_NAME, CATALOG_KIND_PLATFORMS) : NULL;
+    CatalogFile* firmware_catalog = catalog ? catalog_open(FIRMWARE_CACHE_NAME, CATALOG_KIND_FIRMWARE) : NULL;
+    bool cached = firmware_catalog && strcmp(catalog_stamp(catalog), catalog_stamp(firmware_catalog)) == 0;
+    if (cached) {
+        validators = *catalog_validators(catalog);
     }
+    catalog_close(firmware_catalog);
+    catalog_close(catalog);
 
-    // Get the array of platforms
-    struct json_object *platform_array = parsed_json;
-
-    *platform_count = json_object_array_length(platform_array);
-    *platform_list = malloc(*platform_count * sizeof(RomMPlatform));  // Allocate memory for platforms
-
-    // Loop through each platform and populate the platform_list
-    for (int i = 0; i < *platform_count; i++) {
-        struct json_object *platform_obj = json_object_array_get_idx(platform_array, i);
-
-        (*platform_list)[i].id = json_object_get_int(json_object_object_get(platform_obj, "id"));
-        (*platform_list)[i].slug = strdup(json_object_get_string(json_object_object_get(platform_obj, "slug")));
-        (*platform_list)[i].fs_slug = strdup(json_object_get_string(json_object_object_get(platform_obj, "fs_slug")));
-        (*platform_list)[i].name = strdup(json_object_get_string(json_object_object_get(platform_obj, "name")));
-        (*platform_list)[i].rom_count = json_object_get_int(json_object_object_get(platform_obj, "rom_count"));
-        (*platform_list)[i].logo_path = strdup(json_object_get_string(json_object_object_get(platform_obj, "logo_path")));
-        (*platform_list)[i].created_at = strdup(json_object_get_string(json_object_object_get(platform_obj, "created_at")));
-        (*platform_list)[i].updated_at = strdup(json_object_get_string(json_object_object_get(platform_obj, "updated_at")));
-
-        // Handle nullable fields with NULL checks
-        struct json_object *igdb_id_obj = json_object_object_get(platform_obj, "igdb_id");
-        (*platform_list)[i].igdb_id = igdb_id_obj == NULL ? -1 : json_object_get_int(igdb_id_obj);
-        struct json_object *sgdb_id_obj = json_object_object_get(platform_obj, "sgdb_id");
-        (*platform_list)[i].sgdb_id = sgdb_id_obj == NULL ? -1 : json_object_get_int(sgdb_id_obj);
-        struct json_object *moby_id_obj = json_object_object_get(platform_obj, "moby_id");
-        (*platform_list)[i].moby_id = moby_id_obj == NULL ? -1 : json_object_get_int(moby_id_obj);
+    int result = catalog_fetch(session, "/api/platforms", cached ? &validators : NULL,
+                               platform_list_newest_update(current, current_count),
+                               json_stream_write_callback, stream, &received);
+    if (result == CATALOG_FRESH && json_stream_finish(stream, NULL) < 0) {
+        result = CATALOG_ERROR;
     }
+    json_stream_free(stream);
 
-    // Clean up
-    response_free(resp);
-    json_object_put(parsed_json);
+    if (result == CATALOG_FRESH) {
+        // Rewrite the catalogs even when nothing visible changed, to pick up new validators.
+        // Firmware goes first: a platform catalog is only trusted with a firmware
+        // catalog of the same stamp.
+        const char* stamp = platform_list_newest_update(builder.platforms, builder.count);
+        CatalogWriter* firmware_writer = catalog_writer_init(FIRMWARE_CACHE_NAME, CATALOG_KIND_FIRMWARE);
+        for (int i = 0; firmware_writer && i < builder.count; i++) {
+            for (int j = 0; j < builder.platforms[i].firmware_count; j++) {
+                catalog_writer_add_firmware(firmware_writer, builder.platforms[i].id, builder.platforms[i].firmware[j]);
+            }
+        }
+        if (!firmware_writer || catalog_writer_commit(firmware_writer, stamp, NULL) != 0) {
+            fprintf(stderr, "Failed to cache firmware list\n");
+        }
 
-    return 0;
+        CatalogWriter* writer = catalog_writer_init(PLATFORM_CACHE_NAME, CATALOG_KIND_PLATFORMS);
+        for (int i = 0; writer && i < builder.count; i++) {
+            catalog_writer_add_platform(writer, &builder.platforms[i]);
+        }
+        if (!writer || catalog_writer_commit(writer, stamp, &received) != 0) {
+            fprintf(stderr, "Failed to cache platform list\n");
+        }
+
+        if (current && platform_lists_match(current, current_count, builder.platforms, builder.count)) {
+            result = CATALOG_UNCHANGED;
+        }
+    }
+
+    if (result == CATALOG_FRESH) {
+        *platform_list = builder.platforms;
+        *platform_count = builder.count;
+    } else if (result == CATALOG_ERROR) {
+        fprintf(stderr, "Failed to refresh platform list\n");
+    }
+    return result;
 }
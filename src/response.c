@@ -22,6 +22,7 @@ Response* response_init(void) {
         return NULL;
     }
     
+    resp->memory[0] = '\0';
     resp->size = 0;
     resp->capacity = RESPONSE_INITIAL_SIZE;
     return resp;
@@ -61,6 +62,13 @@ void response_append(Response* resp, const char* data) {
     }
 }
 
+void response_clear(Response* resp) {
+    if (resp) {
+        resp->size = 0;
+        resp->memory[0] = '\0';
+    }
+}
+
 size_t response_write_callback(void* contents, size_t size, size_t nmemb, void* userp) {
     size_t realsize = size * nmemb;
     Response* resp = (Response*)userp;
@@ -1,42 +1,268 @@
 #include "rom.h"
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 #include <stdio.h>
 #include <stdbool.h>
+#include <json-c/json.h>
+#include "json_stream.h"
 
-// Free memory for a single ROM
-void free_rom(RomMRom* rom) {
-    if (!rom) return;
-
-    free(rom->platform_slug);
-    free(rom->platform_name);
-    free(rom->file_name);
-    free(rom->file_name_no_tags);
-    free(rom->file_name_no_ext);
-    free(rom->file_extension);
-    free(rom->file_path);
-    free(rom->name);
-    free(rom->slug);
-    free(rom->summary);
-    free(rom->path_cover_s);
-    free(rom->path_cover_l);
-    free(rom->url_cover);
-    free(rom->revision);
-    free(rom->full_path);
-    free(rom->created_at);
-    free(rom->updated_at);
-
-    free(rom); // Free the structure itself
-}
-
-// Download a ROM file from a URL to a destination path
-int download_rom(const char* url, const char* destination) {
-    if (!url || !destination) return -1;
-
-    // Simulate downloading the ROM file
-    printf("Downloading ROM from %s to %s\n", url, destination);
-
-    // In a real implementation, you would use a library like libcurl to download the file
-    // For the sake of this example, we'll just return a success code
+// Release every ROM of a page and reset it
+void free_rom_page(RomMRomPage* page) {
+    if (!page) return;
+
+    arena_release(page->arena);
+    memset(page, 0, sizeof(RomMRomPage));
+}
+
+// Fields of a list record, asked for with the list request. Servers that cannot
+// project fields ignore the parameter and the rest of each object is dropped.
+#define ROM_LIST_FIELDS "id,platform_id,name,file_name,file_name_no_tags,file_size_bytes,path_cover_s,has_cover,multi"
+
+void free_rom_detail(RomMRomDetail* detail) {
+    if (!detail) return;
+
+    arena_release(detail->arena);
+    memset(detail, 0, sizeof(RomMRomDetail));
+}
+
+// Populate a list record from its JSON object
+static void parse_rom(Arena* arena, struct json_object* rom_obj, RomMRom* rom) {
+    memset(rom, 0, sizeof(RomMRom));
+
+    rom->id = json_object_get_int(json_object_object_get(rom_obj, "id"));
+    rom->platform_id = json_object_get_int(json_object_object_get(rom_obj, "platform_id"));
+    rom->name = json_get_string_dup(arena, rom_obj, "name");
+    rom->file_name = json_get_string_dup(arena, rom_obj, "file_name");
+    rom->file_name_no_tags = json_get_string_dup(arena, rom_obj, "file_name_no_tags");
+    rom->file_size_bytes = (unsigned long long)json_object_get_int64(json_object_object_get(rom_obj, "file_size_bytes"));
+    rom->path_cover_s = json_get_string_dup(arena, rom_obj, "path_cover_s");
+    rom->has_cover = json_object_get_boolean(json_object_object_get(rom_obj, "has_cover"));
+    rom->multi = json_object_get_boolean(json_object_object_get(rom_obj, "multi"));
+}
+
+// Populate the heavy fields of a ROM, files are parsed separately while they stream
+static void parse_rom_detail(Arena* arena, struct json_object* rom_obj, RomMRomDetail* detail) {
+    detail->igdb_id = json_get_int_dup(arena, rom_obj, "igdb_id");
+    detail->sgdb_id = json_get_int_dup(arena, rom_obj, "sgdb_id");
+    detail->moby_id = json_get_int_dup(arena, rom_obj, "moby_id");
+    detail->platform_slug = json_get_string_dup(arena, rom_obj, "platform_slug");
+    detail->platform_name = json_get_string_dup(arena, rom_obj, "platform_name");
+    detail->file_name_no_ext = json_get_string_dup(arena, rom_obj, "file_name_no_ext");
+    detail->file_extension = json_get_string_dup(arena, rom_obj, "file_extension");
+    detail->file_path = json_get_string_dup(arena, rom_obj, "file_path");
+    detail->full_path = json_get_string_dup(arena, rom_obj, "full_path");
+    detail->crc_hash = json_get_string_dup(arena, rom_obj, "crc_hash");
+    detail->md5_hash = json_get_string_dup(arena, rom_obj, "md5_hash");
+    detail->sha1_hash = json_get_string_dup(arena, rom_obj, "sha1_hash");
+    detail->slug = json_get_string_dup(arena, rom_obj, "slug");
+    detail->summary = json_get_string_dup(arena, rom_obj, "summary");
+    detail->first_release_date = json_get_int_dup(arena, rom_obj, "first_release_date");
+    detail->path_cover_l = json_get_string_dup(arena, rom_obj, "path_cover_l");
+    detail->url_cover = json_get_string_dup(arena, rom_obj, "url_cover");
+    detail->revision = json_get_string_dup(arena, rom_obj, "revision");
+    detail->created_at = json_get_string_dup(arena, rom_obj, "created_at");
+    detail->updated_at = json_get_string_dup(arena, rom_obj, "updated_at");
+}
+
+typedef struct {
+    RomMRomPage* page;
+    int capacity;
+} RomPageBuilder;
+
+static int append_rom_element(struct json_object* element, void* userp) {
+    RomPageBuilder* builder = (RomPageBuilder*)userp;
+    RomMRomPage* page = builder->page;
+
+    // Sized for the requested limit, so this only grows for servers that ignore it
+    if (page->count == builder->capacity) {
+        int new_capacity = builder->capacity ? builder->capacity * 2 : 64;
+        RomMRom* new_roms = arena_alloc(page->arena, new_capacity * sizeof(RomMRom));
+        if (!new_roms) return -1;
+        if (page->count) memcpy(new_roms, page->roms, page->count * sizeof(RomMRom));
+        page->roms = new_roms;
+        builder->capacity = new_capacity;
+    }
+
+    parse_rom(page->arena, element, &page->roms[page->count++]);
     return 0;
 }
+
+// Fetch one page of a platform's ROMs, sorted by name, parsing records while they download
+int fetch_rom_page(HttpSession* session, int platform_id, int offset, int limit, RomMRomPage* page) {
+    memset(page, 0, sizeof(RomMRomPage));
+    page->offset = offset;
+    page->arena = arena_create(0);
+    page->roms = arena_alloc(page->arena, limit * sizeof(RomMRom));
+    if (!page->roms) {
+        free_rom_page(page);
+        return -1;
+    }
+
+    RomPageBuilder builder = { page, limit };
+    JsonStream* stream = json_stream_init("items", append_rom_element, &builder);
+    if (!stream) {
+        fprintf(stderr, "Failed to initialize JSON stream\n");
+        free_rom_page(page);
+        return -1;
+    }
+
+    char path[256];
+    snprintf(path, sizeof(path), "/api/roms?platform_id=%d&offset=%d&limit=%d&order_by=name&order_dir=asc&fields=%s",
+             platform_id, offset, limit, ROM_LIST_FIELDS);
+
+    HttpRequest request = {
+        .path = path,
+        .compressed = true,
+        .write_fn = json_stream_write_callback,
+        .write_userp = stream,
+    };
+    int status = http_request(session, &request);
+
+    struct json_object* envelope = NULL;
+    if (status != 200 || json_stream_finish(stream, &envelope) < 0) {
+        fprintf(stderr, "Failed to fetch ROMs of platform %d at offset %d (HTTP status %d)\n",
+                platform_id, offset, status);
+        json_stream_free(stream);
+        free_rom_page(page);
+        return -1;
+    }
+    json_stream_free(stream);
+
+    // Servers without pagination answer with a bare array holding every ROM
+    struct json_object* total_obj = NULL;
+    if (json_object_is_type(envelope, json_type_object) && json_object_object_get_ex(envelope, "total", &total_obj)) {
+        page->total = json_object_get_int(total_obj);
+    } else {
+        page->offset = 0;
+        page->total = page->count;
+    }
+    json_object_put(envelope);
+
+    return 0;
+}
+
+typedef struct {
+    RomMRomDetail* detail;
+    int capacity;
+} RomFilesBuilder;
+
+static int append_file_element(struct json_object* element, void* userp) {
+    RomFilesBuilder* builder = (RomFilesBuilder*)userp;
+    RomMRomDetail* detail = builder->detail;
+
+    if (detail->files_count == builder->capacity) {
+        int new_capacity = builder->capacity ? builder->capacity * 2 : 8;
+        RomMRomFile* new_files = arena_alloc(detail->arena, new_capacity * sizeof(RomMRomFile));
+        if (!new_files) return -1;
+        if (detail->files_count) memcpy(new_files, detail->files, detail->files_count * sizeof(RomMRomFile));
+        detail->files = new_files;
+        builder->capacity = new_capacity;
+    }
+
+    RomMRomFile* file = &detail->files[detail->files_count++];
+    file->file_name = json_get_string_dup(detail->arena, element, "file_name");
+    file->file_size_bytes = (unsigned long long)json_object_get_int64(json_object_object_get(element, "file_size_bytes"));
+    return 0;
+}
+
+// Fetch the full record of one ROM. The files array is split off while it streams,
+// the remaining object holds the other heavy fields.
+int fetch_rom_detail(HttpSession* session, int rom_id, RomMRomDetail* detail) {
+    memset(detail, 0, sizeof(RomMRomDetail));
+    detail->arena = arena_create(0);
+    if (!detail->arena) return -1;
+
+    RomFilesBuilder builder = { detail, 0 };
+    JsonStream* stream = json_stream_init("files", append_file_element, &builder);
+    if (!stream) {
+        fprintf(stderr, "Failed to initialize JSON stream\n");
+        free_rom_detail(detail);
+        return -1;
+    }
+
+    char path[64];
+    snprintf(path, sizeof(path), "/api/roms/%d", rom_id);
+
+    HttpRequest request = {
+        .path = path,
+        .compressed = true,
+        .write_fn = json_stream_write_callback,
+        .write_userp = stream,
+    };
+    int status = http_request(session, &request);
+
+    struct json_object* rom_obj = NULL;
+    if (status != 200 || json_stream_finish(stream, &rom_obj) < 0 || !json_object_is_type(rom_obj, json_type_object)) {
+        fprintf(stderr, "Failed to fetch details of ROM %d (HTTP status %d)\n", rom_id, status);
+        if (rom_obj) json_object_put(rom_obj);
+        json_stream_free(stream);
+        free_rom_detail(detail);
+        return -1;
+    }
+    json_stream_free(stream);
+
+    detail->id = rom_id;
+    parse_rom_detail(detail->arena, rom_obj, detail);
+    json_object_put(rom_obj);
+    return 0;
+}
+
+// Build the server path of a ROM's content, caller frees the result
+char* rom_content_url(const RomMRom* rom) {
+    if (!rom || !rom->file_name) return NULL;
+
+    char* escaped_name = http_escape(rom->file_name);
+    if (!escaped_name) return NULL;
+
+    size_t len = strlen(escaped_name) + 64;
+    char* url = malloc(len);
+    if (url) {
+        snprintf(url, len, "/api/roms/%d/content/%s", rom->id, escaped_name);
+    }
+    free(escaped_name);
+    return url;
+}
+
+// Digests to verify a download of the ROM against, none until its detail is known.
+// Multi-file ROMs are served as an archive built on the fly, so their hashes never
+// describe the received bytes.
+void rom_hashes(const RomMRom* rom, const RomMRomDetail* detail, DownloadHashes* hashes) {
+    memset(hashes, 0, sizeof(DownloadHashes));
+    if (!rom || !detail || rom->multi) return;
+
+    hashes->crc32 = detail->crc_hash;
+    hashes->md5 = detail->md5_hash;
+    hashes->sha1 = detail->sha1_hash;
+}
+
+// Single-file ROM stored as a zip archive on the server
+bool rom_is_zip(const RomMRom* rom) {
+    if (!rom || rom->multi || !rom->file_name) return false;
+
+    const char* extension = strrchr(rom->file_name, '.');
+    return extension && strcasecmp(extension, ".zip") == 0;
+}
+
+// Download a ROM file's content to a destination path, resuming a previous partial download.
+// With extract set a zip ROM is unpacked into the destination's folder while it arrives
+// and the archive itself is never written.
+int download_rom(HttpSession* session, const RomMRom* rom, const RomMRomDetail* detail, const char* destination,
+                 bool extract, download_progress_fn on_progress, void* userp) {
+    if (!session || !destination) return DOWNLOAD_ERROR;
+
+    char* url = rom_content_url(rom);
+    if (!url) return DOWNLOAD_ERROR;
+
+    DownloadHashes hashes;
+    rom_hashes(rom, detail, &hashes);
+
+    int result;
+    if (extract && rom_is_zip(rom)) {
+        result = download_archive(session, url, destination, &hashes, on_progress, userp);
+    } else {
+        result = download_file(session, url, destination, &hashes, on_progress, userp);
+    }
+    free(url);
+    return result;
+}
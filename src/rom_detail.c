@@ -0,0 +1,169 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <pthread.h>
+#include "rom_detail.h"
+
+struct RomDetailCache {
+    HttpSession* session;
+    pthread_t thread;
+    pthread_mutex_t lock;        // Guards the request and result fields, never held during I/O
+    pthread_cond_t wake;
+    bool stopping;
+    int wanted_id;               // Next ROM for the worker, -1 for none
+    int running_id;              // ROM being fetched, -1 for none
+    int failed_id;               // Last ROM whose fetch failed, -1 for none
+    RomMRomDetail landed;        // Finished fetch waiting for the main thread
+    bool has_landed;
+    RomMRomDetail entries[ROM_DETAIL_CACHE_SIZE];   // Main thread only from here on
+    unsigned int last_used[ROM_DETAIL_CACHE_SIZE];
+    int entry_count;
+    unsigned int clock;
+    rom_detail_notify_fn notify;
+    void* notify_userp;
+};
+
+static void* rom_detail_main(void* userp) {
+    RomDetailCache* cache = (RomDetailCache*)userp;
+
+    pthread_mutex_lock(&cache->lock);
+    while (!cache->stopping) {
+        if (cache->wanted_id < 0) {
+            pthread_cond_wait(&cache->wake, &cache->lock);
+            continue;
+        }
+
+        int rom_id = cache->wanted_id;
+        cache->wanted_id = -1;
+        cache->running_id = rom_id;
+        pthread_mutex_unlock(&cache->lock);
+
+        RomMRomDetail detail;
+        int result = fetch_rom_detail(cache->session, rom_id, &detail);
+
+        pthread_mutex_lock(&cache->lock);
+        cache->running_id = -1;
+        if (result == 0) {
+            // A result the main thread never took is dropped, it can be fetched again
+            if (cache->has_landed) free_rom_detail(&cache->landed);
+            cache->landed = detail;
+            cache->has_landed = true;
+            if (cache->failed_id == rom_id) cache->failed_id = -1;
+        } else {
+            cache->failed_id = rom_id;
+        }
+        pthread_mutex_unlock(&cache->lock);
+
+        if (cache->notify) cache->notify(cache->notify_userp);
+        pthread_mutex_lock(&cache->lock);
+    }
+    pthread_mutex_unlock(&cache->lock);
+    return NULL;
+}
+
+RomDetailCache* rom_detail_cache_init(HttpSession* session, rom_detail_notify_fn notify, void* userp) {
+    RomDetailCache* cache = calloc(1, sizeof(struct RomDetailCache));
+    if (!cache) return NULL;
+
+    cache->session = session;
+    cache->wanted_id = -1;
+    cache->running_id = -1;
+    cache->failed_id = -1;
+    cache->notify = notify;
+    cache->notify_userp = userp;
+    pthread_mutex_init(&cache->lock, NULL);
+    pthread_cond_init(&cache->wake, NULL);
+
+    if (pthread_create(&cache->thread, NULL, rom_detail_main, cache) != 0) {
+        fprintf(stderr, "Failed to start detail worker\n");
+        pthread_cond_destroy(&cache->wake);
+        pthread_mutex_destroy(&cache->lock);
+        free(cache);
+        return NULL;
+    }
+    return cache;
+}
+
+void rom_detail_cache_free(RomDetailCache* cache) {
+    if (!cache) return;
+
+    pthread_mutex_lock(&cache->lock);
+    cache->stopping = true;
+    pthread_cond_broadcast(&cache->wake);
+    pthread_mutex_unlock(&cache->lock);
+    pthread_join(cache->thread, NULL);
+
+    if (cache->has_landed) free_rom_detail(&cache->landed);
+    for (int i = 0; i < cache->entry_count; i++) {
+        free_rom_detail(&cache->entries[i]);
+    }
+
+    pthread_cond_destroy(&cache->wake);
+    pthread_mutex_destroy(&cache->lock);
+    free(cache);
+}
+
+static int find_entry(const RomDetailCache* cache, int rom_id) {
+    for (int i = 0; i < cache->entry_count; i++) {
+        if (cache->entries[i].id == rom_id) return i;
+    }
+    return -1;
+}
+
+// Move a landed detail into the cache, evicting the least recently used one when full
+static void store_entry(RomDetailCache* cache, RomMRomDetail* detail) {
+    int index = find_entry(cache, detail->id);
+
+    if (index < 0 && cache->entry_count < ROM_DETAIL_CACHE_SIZE) {
+        index = cache->entry_count++;
+    } else {
+        if (index < 0) {
+            index = 0;
+            for (int i = 1; i < cache->entry_count; i++) {
+                if (cache->last_used[i] < cache->last_used[index]) index = i;
+            }
+        }
+        free_rom_detail(&cache->entries[index]);
+    }
+
+    cache->entries[index] = *detail;
+    cache->last_used[index] = ++cache->clock;
+}
+
+const RomMRomDetail* rom_detail_cache_get(RomDetailCache* cache, int rom_id) {
+    if (!cache) return NULL;
+
+    pthread_mutex_lock(&cache->lock);
+    if (cache->has_landed) {
+        store_entry(cache, &cache->landed);
+        cache->has_landed = false;
+    }
+
+    int index = find_entry(cache, rom_id);
+    if (index < 0 && cache->failed_id != rom_id && cache->running_id != rom_id && cache->wanted_id != rom_id) {
+        cache->wanted_id = rom_id;
+        pthread_cond_signal(&cache->wake);
+    }
+    pthread_mutex_unlock(&cache->lock);
+
+    if (index < 0) return NULL;
+    cache->last_used[index] = ++cache->clock;
+    return &cache->entries[index];
+}
+
+bool rom_detail_cache_failed(RomDetailCache* cache, int rom_id) {
+    if (!cache) return false;
+
+    pthread_mutex_lock(&cache->lock);
+    bool failed = cache->failed_id == rom_id;
+    pthread_mutex_unlock(&cache->lock);
+    return failed;
+}
+
+void rom_detail_cache_retry(RomDetailCache* cache, int rom_id) {
+    if (!cache) return;
+
+    pthread_mutex_lock(&cache->lock);
+    if (cache->failed_id == rom_id) cache->failed_id = -1;
+    pthread_mutex_unlock(&cache->lock);
+}
@@ -0,0 +1,417 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <time.h>
+#include <pthread.h>
+#include "rom_list.h"
+#include "catalog.h"
+
+#define ROM_LIST_MAX_WANTED 8
+#define ROM_LIST_RETRY_DELAY_SEC 2
+#define ROM_LIST_SYNC_PAGE_SIZE 250
+
+enum {
+    PAGE_EMPTY,
+    PAGE_PENDING,
+    PAGE_LOADED
+};
+
+struct RomList {
+    HttpSession* session;
+    int platform_id;
+    char* stamp;                 // Platform updated_at the local catalog must match
+    pthread_t thread;
+    pthread_mutex_t lock;        // Guards everything below, held only briefly
+    pthread_cond_t wake;
+    bool stopping;
+    int count;
+    int page_count;
+    RomMRomPage* pages;
+    int* page_states;
+    RomMRomPage all;             // Whole list when the server does not paginate
+    bool unpaginated;
+    int wanted[ROM_LIST_MAX_WANTED];  // Pages to fetch, most urgent first
+    int wanted_count;
+    bool failed;
+    CatalogFile* catalog;        // Local catalog backing every page, NULL when paging from the server
+    CatalogWriter* sync;         // Background copy of the whole list into a new local catalog
+    int sync_offset;
+    int sync_total;
+    bool sync_done;
+    bool total_known;            // A page arrived, so count is the server's total
+    Arena** retired;             // Arenas of pages dropped by the fetch thread, freed on the main thread
+    int retired_count;
+    int retired_capacity;
+    rom_list_notify_fn notify;
+    void* notify_userp;
+};
+
+static void catalog_name(int platform_id, char* name, size_t name_size) {
+    snprintf(name, name_size, "roms_%d", platform_id);
+}
+
+// Decode a page from the local catalog, called with the lock held
+static void load_catalog_page(RomList* list, int page_index) {
+    RomMRomPage* page = &list->pages[page_index];
+    int offset = page_index * ROM_LIST_PAGE_SIZE;
+    int count = list->count - offset < ROM_LIST_PAGE_SIZE ? list->count - offset : ROM_LIST_PAGE_SIZE;
+
+    // Only the record array is allocated, strings point into the mapping
+    page->arena = arena_create(count * sizeof(RomMRom));
+    page->roms = arena_alloc(page->arena, count * sizeof(RomMRom));
+    if (!page->roms) {
+        free_rom_page(page);
+        return;
+    }
+
+    for (int i = 0; i < count; i++) {
+        catalog_get_rom(list->catalog, offset + i, &page->roms[i]);
+    }
+    page->count = count;
+    page->offset = offset;
+    page->total = list->count;
+    list->page_states[page_index] = PAGE_LOADED;
+}
+
+// Drop a page without freeing it, as the main thread may still point into it.
+// Its arena is released by the next rom_list_set_window; called with the lock held.
+static void retire_page(RomList* list, RomMRomPage* page) {
+    if (page->arena && list->retired_count == list->retired_capacity) {
+        int capacity = list->retired_capacity ? list->retired_capacity * 2 : 8;
+        Arena** retired = realloc(list->retired, capacity * sizeof(Arena*));
+        if (retired) {
+            list->retired = retired;
+            list->retired_capacity = capacity;
+        }
+    }
+    // Out of memory the arena is leaked rather than freed under a reader
+    if (page->arena && list->retired_count < list->retired_capacity) {
+        list->retired[list->retired_count++] = page->arena;
+    }
+    memset(page, 0, sizeof(RomMRomPage));
+}
+
+// Free retired pages, main thread only with the lock held
+static void release_retired(RomList* list) {
+    for (int i = 0; i < list->retired_count; i++) {
+        arena_release(list->retired[i]);
+    }
+    list->retired_count = 0;
+}
+
+// Grow or shrink the page slots to cover count ROMs, called with the lock held.
+// Records stay in their arenas, so moving the slots leaves RomMRom pointers valid.
+static int resize_pages(RomList* list, int count) {
+    int page_count = (count + ROM_LIST_PAGE_SIZE - 1) / ROM_LIST_PAGE_SIZE;
+
+    for (int i = page_count; i < list->page_count; i++) {
+        retire_page(list, &list->pages[i]);
+    }
+
+    RomMRomPage* pages = realloc(list->pages, (page_count ? page_count : 1) * sizeof(RomMRomPage));
+    int* states = realloc(list->page_states, (page_count ? page_count : 1) * sizeof(int));
+    if (pages) list->pages = pages;
+    if (states) list->page_states = states;
+    if (!pages || !states) return -1;
+
+    for (int i = list->page_count; i < page_count; i++) {
+        memset(&list->pages[i], 0, sizeof(RomMRomPage));
+        list->page_states[i] = PAGE_EMPTY;
+    }
+    list->page_count = page_count;
+    list->count = count;
+    return 0;
+}
+
+// Most urgent wanted page that is neither loaded nor in flight, called with the lock held
+static int next_wanted_page(RomList* list) {
+    if (list->unpaginated || list->catalog) return -1;
+
+    for (int i = 0; i < list->wanted_count; i++) {
+        int page = list->wanted[i];
+        if (page < list->page_count && list->page_states[page] == PAGE_EMPTY) return page;
+    }
+    return -1;
+}
+
+// Whether the idle thread should copy the list into a local catalog, called with the lock held
+static bool sync_pending(RomList* list) {
+    return !list->catalog && !list->sync_done && list->stamp && list->total_known && list->count > 0;
+}
+
+// Fetch the next chunk of the background catalog sync, called with the lock held.
+// Pages wanted by the UI always go first, so this only runs while the thread is idle.
+static void sync_step(RomList* list) {
+    if (!list->sync) {
+        char name[32];
+        catalog_name(list->platform_id, name, sizeof(name));
+        list->sync = catalog_writer_init(name, CATALOG_KIND_ROMS);
+        list->sync_offset = 0;
+        list->sync_total = list->count;
+        if (!list->sync) {
+            list->sync_done = true;
+            return;
+        }
+    }
+
+    int offset = list->sync_offset;
+    pthread_mutex_unlock(&list->lock);
+
+    RomMRomPage page;
+    int rc = fetch_rom_page(list->session, list->platform_id, offset, ROM_LIST_SYNC_PAGE_SIZE, &page);
+
+    pthread_mutex_lock(&list->lock);
+    bool whole_list = rc == 0 && (page.count > ROM_LIST_SYNC_PAGE_SIZE || (page.offset == 0 && offset > 0));
+    if (rc != 0 || (!whole_list && page.total != list->sync_total)) {
+        // Failed or the list changed underneath, try again next time the list is opened
+        if (rc == 0) free_rom_page(&page);
+        catalog_writer_abort(list->sync);
+        list->sync = NULL;
+        list->sync_done = true;
+        return;
+    }
+
+    if (whole_list) {
+        // Restart from scratch with the complete list the server sent
+        char name[32];
+        catalog_name(list->platform_id, name, sizeof(name));
+        catalog_writer_abort(list->sync);
+        list->sync = catalog_writer_init(name, CATALOG_KIND_ROMS);
+        list->sync_total = page.count;
+    }
+
+    int count = page.count;
+    for (int i = 0; list->sync && i < count; i++) {
+        catalog_writer_add_rom(list->sync, &page.roms[i]);
+    }
+    list->sync_offset = offset + count;
+    free_rom_page(&page);
+
+    if (list->sync && (whole_list || count == 0 || list->sync_offset >= list->sync_total)) {
+        if (catalog_writer_count(list->sync) == list->sync_total) {
+            catalog_writer_commit(list->sync, list->stamp, NULL);
+        } else {
+            catalog_writer_abort(list->sync);
+        }
+        list->sync = NULL;
+        list->sync_done = true;
+    } else if (!list->sync) {
+        list->sync_done = true;
+    }
+}
+
+static void* fetch_thread_main(void* userp) {
+    RomList* list = (RomList*)userp;
+
+    pthread_mutex_lock(&list->lock);
+    while (!list->stopping) {
+        int page_index = next_wanted_page(list);
+        if (page_index < 0) {
+            if (sync_pending(list) && !list->failed) {
+                sync_step(list);
+            } else {
+                pthread_cond_wait(&list->wake, &list->lock);
+            }
+            continue;
+        }
+
+        list->page_states[page_index] = PAGE_PENDING;
+        pthread_mutex_unlock(&list->lock);
+
+        RomMRomPage page;
+        int rc = fetch_rom_page(list->session, list->platform_id,
+                                page_index * ROM_LIST_PAGE_SIZE, ROM_LIST_PAGE_SIZE, &page);
+
+        pthread_mutex_lock(&list->lock);
+        if (page_index < list->page_count) list->page_states[page_index] = PAGE_EMPTY;
+
+        if (rc < 0) {
+            list->failed = true;
+            pthread_mutex_unlock(&list->lock);
+            if (list->notify) list->notify(list->notify_userp);
+            pthread_mutex_lock(&list->lock);
+
+            // Back off before retrying so a dead server does not spin the thread
+            struct timespec deadline;
+            clock_gettime(CLOCK_REALTIME, &deadline);
+            deadline.tv_sec += ROM_LIST_RETRY_DELAY_SEC;
+            if (!list->stopping) pthread_cond_timedwait(&list->wake, &list->lock, &deadline);
+            continue;
+        }
+        list->failed = false;
+        list->total_known = true;
+
+        if (page.count > ROM_LIST_PAGE_SIZE || (page.offset == 0 && page_index > 0)) {
+            // The server ignored offset/limit and sent everything at once
+            resize_pages(list, 0);
+            retire_page(list, &list->all);
+            list->all = page;
+            list->unpaginated = true;
+            list->count = page.count;
+        } else {
+            if (page.total != list->count) resize_pages(list, page.total);
+            if (page_index < list->page_count) {
+                list->pages[page_index] = page;
+                list->page_states[page_index] = PAGE_LOADED;
+            } else {
+                free_rom_page(&page);
+            }
+        }
+
+        pthread_mutex_unlock(&list->lock);
+        if (list->notify) list->notify(list->notify_userp);
+        pthread_mutex_lock(&list->lock);
+    }
+    pthread_mutex_unlock(&list->lock);
+    return NULL;
+}
+
+CatalogFile* rom_catalog_open(int platform_id, int expected_count, const char* updated_at) {
+    if (!updated_at) return NULL;
+
+    char name[32];
+    catalog_name(platform_id, name, sizeof(name));
+    CatalogFile* catalog = catalog_open(name, CATALOG_KIND_ROMS);
+    if (catalog && catalog_count(catalog) > 0 && catalog_count(catalog) == expected_count &&
+        strcmp(catalog_stamp(catalog), updated_at) == 0) {
+        return catalog;
+    }
+    catalog_close(catalog);
+    return NULL;
+}
+
+RomList* rom_list_init(HttpSession* session, int platform_id, int expected_count, const char* updated_at,
+                       rom_list_notify_fn notify, void* userp) {
+    RomList* list = calloc(1, sizeof(struct RomList));
+    if (!list) return NULL;
+
+    list->session = session;
+    list->platform_id = platform_id;
+    list->notify = notify;
+    list->notify_userp = userp;
+    list->stamp = updated_at ? strdup(updated_at) : NULL;
+
+    // A catalog written for the same platform revision makes the list fully local
+    list->catalog = rom_catalog_open(platform_id, expected_count, updated_at);
+
+    pthread_mutex_init(&list->lock, NULL);
+    pthread_cond_init(&list->wake, NULL);
+
+    // At least one page is needed to learn the real total
+    if (resize_pages(list, expected_count > 0 ? expected_count : 1) != 0 ||
+        pthread_create(&list->thread, NULL, fetch_thread_main, list) != 0) {
+        fprintf(stderr, "Failed to start ROM list of platform %d\n", platform_id);
+        free(list->pages);
+        free(list->page_states);
+        catalog_close(list->catalog);
+        free(list->stamp);
+        pthread_cond_destroy(&list->wake);
+        pthread_mutex_destroy(&list->lock);
+        free(list);
+        return NULL;
+    }
+    return list;
+}
+
+void rom_list_free(RomList* list) {
+    if (!list) return;
+
+    pthread_mutex_lock(&list->lock);
+    list->stopping = true;
+    pthread_cond_broadcast(&list->wake);
+    pthread_mutex_unlock(&list->lock);
+    pthread_join(list->thread, NULL);
+
+    for (int i = 0; i < list->page_count; i++) {
+        free_rom_page(&list->pages[i]);
+    }
+    free(list->pages);
+    free(list->page_states);
+    free_rom_page(&list->all);
+    release_retired(list);
+    free(list->retired);
+    catalog_writer_abort(list->sync);
+    catalog_close(list->catalog);
+    free(list->stamp);
+
+    pthread_cond_destroy(&list->wake);
+    pthread_mutex_destroy(&list->lock);
+    free(list);
+}
+
+int rom_list_count(RomList* list) {
+    if (!list) return 0;
+
+    pthread_mutex_lock(&list->lock);
+    int count = list->count;
+    pthread_mutex_unlock(&list->lock);
+    return count;
+}
+
+// Pages are only released from the main thread (eviction, retired pages, free),
+// so the returned pointer stays valid until the next rom_list_set_window call
+const RomMRom* rom_list_get(RomList* list, int index) {
+    if (!list || index < 0) return NULL;
+
+    const RomMRom* rom = NULL;
+    pthread_mutex_lock(&list->lock);
+    if (list->unpaginated) {
+        if (index < list->all.count) rom = &list->all.roms[index];
+    } else if (index < list->count) {
+        int page_index = index / ROM_LIST_PAGE_SIZE;
+        int slot = index % ROM_LIST_PAGE_SIZE;
+        if (list->catalog && list->page_states[page_index] == PAGE_EMPTY) load_catalog_page(list, page_index);
+        if (list->page_states[page_index] == PAGE_LOADED && slot < list->pages[page_index].count) {
+            rom = &list->pages[page_index].roms[slot];
+        }
+    }
+    pthread_mutex_unlock(&list->lock);
+    return rom;
+}
+
+bool rom_list_failed(RomList* list) {
+    if (!list) return false;
+
+    pthread_mutex_lock(&list->lock);
+    bool failed = list->failed;
+    pthread_mutex_unlock(&list->lock);
+    return failed;
+}
+
+void rom_list_set_window(RomList* list, int first_visible, int visible_count, int direction) {
+    if (!list) return;
+
+    pthread_mutex_lock(&list->lock);
+    release_retired(list);
+    if (list->unpaginated || list->page_count == 0) {
+        pthread_mutex_unlock(&list->lock);
+        return;
+    }
+
+    int first_page = first_visible / ROM_LIST_PAGE_SIZE;
+    int last_page = (first_visible + (visible_count > 0 ? visible_count - 1 : 0)) / ROM_LIST_PAGE_SIZE;
+    if (first_page >= list->page_count) first_page = list->page_count - 1;
+    if (last_page >= list->page_count) last_page = list->page_count - 1;
+
+    // Visible pages first, then read-ahead in the scroll direction; older wishes are dropped
+    list->wanted_count = 0;
+    for (int page = first_page; page <= last_page && list->wanted_count < ROM_LIST_MAX_WANTED; page++) {
+        list->wanted[list->wanted_count++] = page;
+    }
+    for (int i = 1; i <= ROM_LIST_PREFETCH_PAGES && list->wanted_count < ROM_LIST_MAX_WANTED; i++) {
+        int page = direction < 0 ? first_page - i : last_page + i;
+        if (page >= 0 && page < list->page_count) list->wanted[list->wanted_count++] = page;
+    }
+
+    // Keep memory bounded on huge platforms by dropping pages far from the window
+    for (int page = 0; page < list->page_count; page++) {
+        if (list->page_states[page] != PAGE_LOADED) continue;
+        if (page >= first_page - ROM_LIST_KEEP_PAGES && page <= last_page + ROM_LIST_KEEP_PAGES) continue;
+        free_rom_page(&list->pages[page]);
+        list->page_states[page] = PAGE_EMPTY;
+    }
+
+    pthread_cond_signal(&list->wake);
+    pthread_mutex_unlock(&list->lock);
+}
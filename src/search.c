@@ -0,0 +1,247 @@
+#include "search.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TRIGRAM_ALPHABET 37   // Space, a-z, 0-9
+#define TRIGRAM_COUNT (TRIGRAM_ALPHABET * TRIGRAM_ALPHABET * TRIGRAM_ALPHABET)
+#define FIELD_SEPARATOR '|'   // Between name and file name, never part of a query
+
+// Matches of one query, kept for every prefix of the current query so typing
+// filters the previous level and deleting pops back to it
+typedef struct {
+    char query[SEARCH_MAX_QUERY];
+    int* results;
+    int count;
+} SearchLevel;
+
+struct SearchIndex {
+    int count;
+    char* texts;              // Normalized "name|file name" of every record, NUL separated
+    int* text_offsets;
+    uint64_t* symbol_masks;   // Bit per trigram symbol present in each record's text
+    int* trigram_starts;      // Postings of trigram t are postings[starts[t] .. starts[t + 1])
+    int* postings;            // Record indices, ascending within each trigram
+    SearchLevel levels[SEARCH_MAX_QUERY + 1];
+    int depth;                // levels[0] is the empty query, matching every record
+};
+
+// Lowercase letters and digits, every run of anything else becomes one space
+static size_t normalize(const char* text, char* out, size_t out_size) {
+    size_t length = 0;
+    bool pending_space = false;
+
+    if (!text || out_size == 0) {
+        if (out_size) out[0] = '\0';
+        return 0;
+    }
+
+    for (const unsigned char* p = (const unsigned char*)text; *p; p++) {
+        char c = 0;
+        if (*p >= 'a' && *p <= 'z') c = *p;
+        else if (*p >= 'A' && *p <= 'Z') c = *p - 'A' + 'a';
+        else if (*p >= '0' && *p <= '9') c = *p;
+
+        if (!c) {
+            pending_space = length > 0;
+            continue;
+        }
+        if (pending_space && length + 1 < out_size) out[length++] = ' ';
+        pending_space = false;
+        if (length + 1 < out_size) out[length++] = c;
+    }
+    out[length] = '\0';
+    return length;
+}
+
+static int trigram_symbol(char c) {
+    if (c == ' ') return 0;
+    if (c >= 'a' && c <= 'z') return 1 + c - 'a';
+    if (c >= '0' && c <= '9') return 27 + c - '0';
+    return -1;
+}
+
+// Trigram id of text[0..2], or -1 when it spans the field separator
+static int trigram_at(const char* text) {
+    int a = trigram_symbol(text[0]), b = trigram_symbol(text[1]), c = trigram_symbol(text[2]);
+    if (a < 0 || b < 0 || c < 0) return -1;
+    return (a * TRIGRAM_ALPHABET + b) * TRIGRAM_ALPHABET + c;
+}
+
+static uint64_t symbol_mask(const char* text) {
+    uint64_t mask = 0;
+    for (const char* p = text; *p; p++) {
+        int symbol = trigram_symbol(*p);
+        if (symbol >= 0) mask |= (uint64_t)1 << symbol;
+    }
+    return mask;
+}
+
+// Visit each distinct trigram of a record once; last_seen dedups per record
+static void for_each_trigram(const char* text, int record, int* last_seen,
+                             void (*visit)(SearchIndex*, int, int), SearchIndex* index) {
+    for (const char* p = text; p[0] && p[1] && p[2]; p++) {
+        int trigram = trigram_at(p);
+        if (trigram < 0 || last_seen[trigram] == record) continue;
+        last_seen[trigram] = record;
+        visit(index, trigram, record);
+    }
+}
+
+static void count_trigram(SearchIndex* index, int trigram, int record) {
+    (void)record;
+    index->trigram_starts[trigram + 1]++;
+}
+
+static void add_posting(SearchIndex* index, int trigram, int record) {
+    // trigram_starts[t] doubles as the fill cursor and ends up at the next list's start
+    index->postings[index->trigram_starts[trigram]++] = record;
+}
+
+SearchIndex* search_index_build(const CatalogFile* catalog) {
+    SearchIndex* index = calloc(1, sizeof(struct SearchIndex));
+    if (!index) return NULL;
+
+    int count = catalog_count(catalog);
+    size_t texts_size = 0, texts_capacity = (size_t)count * 64 + 1;
+    int* last_seen = malloc(TRIGRAM_COUNT * sizeof(int));
+    index->texts = malloc(texts_capacity);
+    index->text_offsets = malloc((count + 1) * sizeof(int));
+    index->symbol_masks = malloc((count + 1) * sizeof(uint64_t));
+    index->trigram_starts = calloc(TRIGRAM_COUNT + 1, sizeof(int));
+    if (!last_seen || !index->texts || !index->text_offsets || !index->symbol_masks ||
+        !index->trigram_starts) goto fail;
+
+    // Normalize every record once; queries only ever touch these strings
+    for (int i = 0; i < count; i++) {
+        RomMRom rom;
+        char name[256], file_name[256];
+        catalog_get_rom(catalog, i, &rom);
+        size_t name_length = normalize(rom.name, name, sizeof(name));
+        size_t file_length = normalize(rom.file_name_no_tags, file_name, sizeof(file_name));
+
+        size_t needed = name_length + 1 + file_length + 1;
+        if (texts_size + needed > texts_capacity) {
+            texts_capacity = (texts_capacity + needed) * 2;
+            char* grown = realloc(index->texts, texts_capacity);
+            if (!grown) goto fail;
+            index->texts = grown;
+        }
+        index->text_offsets[i] = (int)texts_size;
+        texts_size += sprintf(index->texts + texts_size, "%s%c%s", name, FIELD_SEPARATOR, file_name) + 1;
+        index->symbol_masks[i] = symbol_mask(index->texts + index->text_offsets[i]);
+    }
+    index->count = count;
+
+    // Two passes over the texts: size every posting list, then fill them in record order
+    memset(last_seen, 0xff, TRIGRAM_COUNT * sizeof(int));
+    for (int i = 0; i < count; i++) {
+        for_each_trigram(index->texts + index->text_offsets[i], i, last_seen, count_trigram, index);
+    }
+    for (int t = 0; t < TRIGRAM_COUNT; t++) {
+        index->trigram_starts[t + 1] += index->trigram_starts[t];
+    }
+
+    index->postings = malloc((index->trigram_starts[TRIGRAM_COUNT] + 1) * sizeof(int));
+    if (!index->postings) goto fail;
+
+    memset(last_seen, 0xff, TRIGRAM_COUNT * sizeof(int));
+    for (int i = 0; i < count; i++) {
+        for_each_trigram(index->texts + index->text_offsets[i], i, last_seen, add_posting, index);
+    }
+    memmove(index->trigram_starts + 1, index->trigram_starts, TRIGRAM_COUNT * sizeof(int));
+    index->trigram_starts[0] = 0;
+
+    free(last_seen);
+    index->depth = 0;
+    index->levels[0].count = count;
+    return index;
+
+fail:
+    fprintf(stderr, "Failed to build search index of %d ROMs\n", count);
+    free(last_seen);
+    search_index_free(index);
+    return NULL;
+}
+
+void search_index_free(SearchIndex* index) {
+    if (!index) return;
+
+    for (int i = 1; i <= index->depth; i++) {
+        free(index->levels[i].results);
+    }
+    free(index->texts);
+    free(index->text_offsets);
+    free(index->symbol_masks);
+    free(index->trigram_starts);
+    free(index->postings);
+    free(index);
+}
+
+// Matches of query among candidates (every record when candidates is NULL). The
+// symbol mask rejects most records of short, broad queries without touching text
+// and answers single-character queries on its own.
+static int filter_records(const SearchIndex* index, const char* query, const int* candidates,
+                          int candidate_count, int* out) {
+    uint64_t query_mask = symbol_mask(query);
+    bool mask_decides = query[0] && !query[1];
+    int count = 0;
+
+    for (int i = 0; i < candidate_count; i++) {
+        int record = candidates ? candidates[i] : i;
+        if ((index->symbol_masks[record] & query_mask) != query_mask) continue;
+        if (mask_decides || strstr(index->texts + index->text_offsets[record], query)) out[count++] = record;
+    }
+    return count;
+}
+
+int search_index_query(SearchIndex* index, const char* text) {
+    if (!index) return 0;
+
+    char query[SEARCH_MAX_QUERY];
+    size_t length = normalize(text, query, sizeof(query));
+
+    // Drop the levels that are not a prefix of the new query; deleting a character
+    // lands on a level that is already computed
+    while (index->depth > 0) {
+        SearchLevel* top = &index->levels[index->depth];
+        if (strncmp(top->query, query, strlen(top->query)) == 0) break;
+        free(top->results);
+        top->results = NULL;
+        index->depth--;
+    }
+
+    SearchLevel* base = &index->levels[index->depth];
+    if (strcmp(base->query, query) == 0) return base->count;
+    if (index->depth == SEARCH_MAX_QUERY) return base->count;
+
+    // Verify the smallest superset of the answer: the previous matches, or the
+    // posting list of the query's rarest trigram when that one is shorter
+    const int* candidates = base->results;  // NULL on level 0, meaning every record
+    int candidate_count = base->count;
+    for (size_t i = 0; i + 2 < length; i++) {
+        int trigram = trigram_at(query + i);
+        int postings = index->trigram_starts[trigram + 1] - index->trigram_starts[trigram];
+        if (postings < candidate_count) {
+            candidates = index->postings + index->trigram_starts[trigram];
+            candidate_count = postings;
+        }
+    }
+
+    int* results = malloc((candidate_count + 1) * sizeof(int));
+    if (!results) return base->count;
+
+    SearchLevel* level = &index->levels[++index->depth];
+    memcpy(level->query, query, length + 1);
+    level->results = results;
+    level->count = filter_records(index, query, candidates, candidate_count, results);
+    return level->count;
+}
+
+int search_index_result(const SearchIndex* index, int i) {
+    const SearchLevel* level = &index->levels[index->depth];
+    if (i < 0 || i >= level->count) return -1;
+    return level->results ? level->results[i] : i;
+}
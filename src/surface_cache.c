@@ -0,0 +1,161 @@
+#include "surface_cache.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#define SURFACE_CACHE_BUCKETS 256   // Power of two, a screenful of text is a few dozen entries
+
+typedef struct SurfaceEntry {
+    char* key;
+    uint32_t hash;
+    SDL_Surface* surface;
+    size_t bytes;
+    struct SurfaceEntry* bucket_next;
+    struct SurfaceEntry* newer;   // LRU list neighbours
+    struct SurfaceEntry* older;
+} SurfaceEntry;
+
+struct SurfaceCache {
+    SurfaceEntry* buckets[SURFACE_CACHE_BUCKETS];
+    SurfaceEntry* newest;
+    SurfaceEntry* oldest;
+    size_t byte_budget;
+    size_t bytes;
+    size_t entries;
+    size_t hits;
+    size_t misses;
+    size_t evictions;
+};
+
+static uint32_t hash_key(const char* key) {
+    uint32_t hash = 2166136261u;
+    for (const unsigned char* c = (const unsigned char*)key; *c; c++) {
+        hash ^= *c;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static void lru_unlink(SurfaceCache* cache, SurfaceEntry* entry) {
+    if (entry->newer) entry->newer->older = entry->older;
+    else cache->newest = entry->older;
+    if (entry->older) entry->older->newer = entry->newer;
+    else cache->oldest = entry->newer;
+    entry->newer = entry->older = NULL;
+}
+
+static void lru_push_newest(SurfaceCache* cache, SurfaceEntry* entry) {
+    entry->older = cache->newest;
+    entry->newer = NULL;
+    if (cache->newest) cache->newest->newer = entry;
+    cache->newest = entry;
+    if (!cache->oldest) cache->oldest = entry;
+}
+
+static void remove_entry(SurfaceCache* cache, SurfaceEntry* entry) {
+    SurfaceEntry** link = &cache->buckets[entry->hash & (SURFACE_CACHE_BUCKETS - 1)];
+    while (*link != entry) link = &(*link)->bucket_next;
+    *link = entry->bucket_next;
+
+    lru_unlink(cache, entry);
+    cache->bytes -= entry->bytes;
+    cache->entries--;
+
+    SDL_FreeSurface(entry->surface);
+    free(entry->key);
+    free(entry);
+}
+
+static SurfaceEntry* find_entry(SurfaceCache* cache, const char* key, uint32_t hash) {
+    SurfaceEntry* entry = cache->buckets[hash & (SURFACE_CACHE_BUCKETS - 1)];
+    while (entry && (entry->hash != hash || strcmp(entry->key, key) != 0)) {
+        entry = entry->bucket_next;
+    }
+    return entry;
+}
+
+SurfaceCache* surface_cache_init(size_t byte_budget) {
+    SurfaceCache* cache = calloc(1, sizeof(struct SurfaceCache));
+    if (!cache) return NULL;
+
+    cache->byte_budget = byte_budget;
+    return cache;
+}
+
+void surface_cache_free(SurfaceCache* cache) {
+    if (!cache) return;
+
+    surface_cache_clear(cache);
+    free(cache);
+}
+
+SDL_Surface* surface_cache_get(SurfaceCache* cache, const char* key) {
+    if (!cache || !key) return NULL;
+
+    SurfaceEntry* entry = find_entry(cache, key, hash_key(key));
+    if (!entry) {
+        cache->misses++;
+        return NULL;
+    }
+
+    cache->hits++;
+    if (cache->newest != entry) {
+        lru_unlink(cache, entry);
+        lru_push_newest(cache, entry);
+    }
+    return entry->surface;
+}
+
+void surface_cache_put(SurfaceCache* cache, const char* key, SDL_Surface* surface) {
+    if (!surface) return;
+    if (!cache || !key) {
+        SDL_FreeSurface(surface);
+        return;
+    }
+
+    uint32_t hash = hash_key(key);
+    SurfaceEntry* existing = find_entry(cache, key, hash);
+    if (existing) remove_entry(cache, existing);
+
+    SurfaceEntry* entry = calloc(1, sizeof(SurfaceEntry));
+    if (entry) entry->key = strdup(key);
+    if (!entry || !entry->key) {
+        free(entry);
+        SDL_FreeSurface(surface);
+        return;
+    }
+
+    entry->hash = hash;
+    entry->surface = surface;
+    entry->bytes = (size_t)surface->pitch * surface->h;
+
+    // Make room first; the newest entry itself is never evicted
+    while (cache->oldest && cache->bytes + entry->bytes > cache->byte_budget) {
+        remove_entry(cache, cache->oldest);
+        cache->evictions++;
+    }
+
+    SurfaceEntry** bucket = &cache->buckets[hash & (SURFACE_CACHE_BUCKETS - 1)];
+    entry->bucket_next = *bucket;
+    *bucket = entry;
+    lru_push_newest(cache, entry);
+    cache->bytes += entry->bytes;
+    cache->entries++;
+}
+
+void surface_cache_clear(SurfaceCache* cache) {
+    if (!cache) return;
+
+    while (cache->oldest) remove_entry(cache, cache->oldest);
+}
+
+void surface_cache_stats(const SurfaceCache* cache, SurfaceCacheStats* stats) {
+    memset(stats, 0, sizeof(SurfaceCacheStats));
+    if (!cache) return;
+
+    stats->entries = cache->entries;
+    stats->bytes = cache->bytes;
+    stats->hits = cache->hits;
+    stats->misses = cache->misses;
+    stats->evictions = cache->evictions;
+}
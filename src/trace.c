@@ -0,0 +1,152 @@
+#include "trace.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define TRACE_CAPACITY 4096   // Spans kept, a power of two
+
+// A slot is valid when seq is the index it was written at plus one. Writers
+// claim indices with one atomic add; readers copy a slot and check seq again,
+// so a slot being overwritten meanwhile is skipped instead of read torn.
+typedef struct {
+    uint64_t seq;
+    uint64_t start_us;
+    uint64_t bytes;
+    uint32_t duration_us;
+    uint16_t kind;
+    uint16_t thread;
+} TraceSlot;
+
+static TraceSlot ring[TRACE_CAPACITY];
+static uint64_t ring_head;
+static uint16_t thread_count;
+static __thread uint16_t thread_number;
+
+static FILE* dump_file;
+static uint64_t dump_next;     // First ring index not written yet
+static uint64_t dump_lost;
+static bool dump_first;
+
+static const char* kind_names[TRACE_KIND_COUNT] = {
+    "http_request", "http_dns", "http_connect", "http_ttfb", "http_transfer",
+    "json_decode", "frame", "frame_build", "frame_blit", "frame_flip",
+    "disk_write", "disk_wait"
+};
+
+uint64_t trace_now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000u + (uint64_t)ts.tv_nsec / 1000u;
+}
+
+const char* trace_kind_name(TraceKind kind) {
+    return kind < TRACE_KIND_COUNT ? kind_names[kind] : "unknown";
+}
+
+void trace_span(TraceKind kind, uint64_t start_us, uint64_t end_us, uint64_t bytes) {
+    if (!thread_number) thread_number = __atomic_add_fetch(&thread_count, 1, __ATOMIC_RELAXED);
+
+    uint64_t index = __atomic_fetch_add(&ring_head, 1, __ATOMIC_RELAXED);
+    TraceSlot* slot = &ring[index & (TRACE_CAPACITY - 1)];
+    uint64_t duration = end_us > start_us ? end_us - start_us : 0;
+
+    __atomic_store_n(&slot->seq, 0, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    __atomic_store_n(&slot->start_us, start_us, __ATOMIC_RELAXED);
+    __atomic_store_n(&slot->bytes, bytes, __ATOMIC_RELAXED);
+    __atomic_store_n(&slot->duration_us, duration > UINT32_MAX ? UINT32_MAX : (uint32_t)duration, __ATOMIC_RELAXED);
+    __atomic_store_n(&slot->kind, (uint16_t)kind, __ATOMIC_RELAXED);
+    __atomic_store_n(&slot->thread, thread_number, __ATOMIC_RELAXED);
+    __atomic_store_n(&slot->seq, index + 1, __ATOMIC_RELEASE);
+}
+
+// Copy the span written at index, false when it was overwritten or is still being written
+static bool read_slot(uint64_t index, TraceSpan* span) {
+    TraceSlot* slot = &ring[index & (TRACE_CAPACITY - 1)];
+
+    if (__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != index + 1) return false;
+    span->start_us = __atomic_load_n(&slot->start_us, __ATOMIC_RELAXED);
+    span->bytes = __atomic_load_n(&slot->bytes, __ATOMIC_RELAXED);
+    span->duration_us = __atomic_load_n(&slot->duration_us, __ATOMIC_RELAXED);
+    span->kind = __atomic_load_n(&slot->kind, __ATOMIC_RELAXED);
+    span->thread = __atomic_load_n(&slot->thread, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return __atomic_load_n(&slot->seq, __ATOMIC_RELAXED) == index + 1;
+}
+
+static int compare_durations(const void* a, const void* b) {
+    uint32_t x = *(const uint32_t*)a, y = *(const uint32_t*)b;
+    return (x > y) - (x < y);
+}
+
+void trace_stats(TraceKind kind, uint64_t since_us, TraceStats* stats) {
+    static uint32_t durations[TRACE_CAPACITY];
+    uint64_t head = __atomic_load_n(&ring_head, __ATOMIC_ACQUIRE);
+    uint64_t first = head > TRACE_CAPACITY ? head - TRACE_CAPACITY : 0;
+
+    memset(stats, 0, sizeof(TraceStats));
+    for (uint64_t index = first; index < head; index++) {
+        TraceSpan span;
+        if (!read_slot(index, &span) || span.kind != kind || span.start_us < since_us) continue;
+        durations[stats->count++] = span.duration_us;
+        stats->bytes += span.bytes;
+    }
+    if (stats->count == 0) return;
+
+    qsort(durations, stats->count, sizeof(uint32_t), compare_durations);
+    stats->p50_us = durations[(stats->count - 1) / 2];
+    stats->p99_us = durations[(stats->count - 1) * 99 / 100];
+    stats->max_us = durations[stats->count - 1];
+}
+
+int trace_dump_open(const char* path) {
+    if (dump_file) return 0;
+
+    dump_file = fopen(path, "w");
+    if (!dump_file) {
+        fprintf(stderr, "Failed to open trace file %s\n", path);
+        return -1;
+    }
+    fputs("{\"traceEvents\": [\n", dump_file);
+    dump_next = __atomic_load_n(&ring_head, __ATOMIC_ACQUIRE);
+    dump_lost = 0;
+    dump_first = true;
+    return 0;
+}
+
+void trace_dump_flush(void) {
+    if (!dump_file) return;
+
+    uint64_t head = __atomic_load_n(&ring_head, __ATOMIC_ACQUIRE);
+    if (head - dump_next > TRACE_CAPACITY) {
+        dump_lost += head - dump_next - TRACE_CAPACITY;
+        dump_next = head - TRACE_CAPACITY;
+    }
+
+    for (; dump_next < head; dump_next++) {
+        TraceSpan span;
+        if (!read_slot(dump_next, &span)) {
+            // Claimed but not written yet; pick it up on the next flush
+            TraceSlot* slot = &ring[dump_next & (TRACE_CAPACITY - 1)];
+            if (__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) <= dump_next) break;
+            dump_lost++;
+            continue;
+        }
+        fprintf(dump_file, "%s{\"name\": \"%s\", \"ph\": \"X\", \"ts\": %llu, \"dur\": %u, \"pid\": 1, "
+                           "\"tid\": %u, \"args\": {\"bytes\": %llu}}",
+                dump_first ? "" : ",\n", trace_kind_name(span.kind), (unsigned long long)span.start_us,
+                span.duration_us, span.thread, (unsigned long long)span.bytes);
+        dump_first = false;
+    }
+}
+
+void trace_dump_close(void) {
+    if (!dump_file) return;
+
+    trace_dump_flush();
+    fprintf(dump_file, "\n], \"displayTimeUnit\": \"ms\", \"otherData\": {\"lost_spans\": %llu}}\n",
+            (unsigned long long)dump_lost);
+    fclose(dump_file);
+    dump_file = NULL;
+}
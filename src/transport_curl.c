@@ -0,0 +1,198 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <pthread.h>
+#include <curl/curl.h>
+#include "transport.h"
+#include "trace.h"
+
+#define HTTP_MAX_IDLE_HANDLES 4
+#define HTTP_CONNECT_TIMEOUT 10L   // Seconds
+#define HTTP_LOW_SPEED_TIME 30L    // Abort when stalled for this many seconds
+
+typedef struct {
+    HttpTransport base;
+    CURLSH* share;                                // DNS and TLS session cache, safe across threads
+    pthread_mutex_t share_locks[CURL_LOCK_DATA_LAST];
+    pthread_mutex_t pool_lock;
+    CURL* idle[HTTP_MAX_IDLE_HANDLES];            // Easy handles keep their live connections between requests
+    int idle_count;
+} CurlTransport;
+
+static void share_lock(CURL* handle, curl_lock_data data, curl_lock_access access, void* userp) {
+    (void)handle;
+    (void)access;
+    CurlTransport* transport = (CurlTransport*)userp;
+    pthread_mutex_lock(&transport->share_locks[data]);
+}
+
+static void share_unlock(CURL* handle, curl_lock_data data, void* userp) {
+    (void)handle;
+    CurlTransport* transport = (CurlTransport*)userp;
+    pthread_mutex_unlock(&transport->share_locks[data]);
+}
+
+// Take a warm handle from the pool, or create one when every handle is busy
+static CURL* acquire_handle(CurlTransport* transport) {
+    CURL* curl = NULL;
+
+    pthread_mutex_lock(&transport->pool_lock);
+    if (transport->idle_count > 0) {
+        curl = transport->idle[--transport->idle_count];
+    }
+    pthread_mutex_unlock(&transport->pool_lock);
+
+    if (curl) {
+        curl_easy_reset(curl);  // Keeps live connections, drops per-request options
+    } else {
+        curl = curl_easy_init();
+        if (!curl) return NULL;
+    }
+
+    if (transport->share) curl_easy_setopt(curl, CURLOPT_SHARE, transport->share);
+    curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
+    curl_easy_setopt(curl, CURLOPT_TCP_KEEPALIVE, 1L);
+    curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
+    curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT, HTTP_CONNECT_TIMEOUT);
+    curl_easy_setopt(curl, CURLOPT_LOW_SPEED_LIMIT, 1L);
+    curl_easy_setopt(curl, CURLOPT_LOW_SPEED_TIME, HTTP_LOW_SPEED_TIME);
+    return curl;
+}
+
+static void release_handle(CurlTransport* transport, CURL* curl) {
+    pthread_mutex_lock(&transport->pool_lock);
+    if (transport->idle_count < HTTP_MAX_IDLE_HANDLES) {
+        transport->idle[transport->idle_count++] = curl;
+        curl = NULL;
+    }
+    pthread_mutex_unlock(&transport->pool_lock);
+
+    if (curl) curl_easy_cleanup(curl);
+}
+
+// Also runs while connecting or stalled, so an aborted session stops within a second
+static int xferinfo_callback(void* userp, curl_off_t dltotal, curl_off_t dlnow, curl_off_t ultotal, curl_off_t ulnow) {
+    (void)ultotal;
+    (void)ulnow;
+    const HttpTransfer* transfer = (const HttpTransfer*)userp;
+    return transfer->progress_fn(transfer->progress_userp, (long long)dltotal, (long long)dlnow);
+}
+
+// Split a finished transfer into lookup, handshake, wait and receive spans.
+// A reused connection skips the first two.
+static void trace_phases(CURL* curl, uint64_t start) {
+    curl_off_t lookup = 0, connect = 0, tls = 0, first_byte = 0, total = 0, size = 0;
+    curl_easy_getinfo(curl, CURLINFO_NAMELOOKUP_TIME_T, &lookup);
+    curl_easy_getinfo(curl, CURLINFO_CONNECT_TIME_T, &connect);
+    curl_easy_getinfo(curl, CURLINFO_APPCONNECT_TIME_T, &tls);
+    curl_easy_getinfo(curl, CURLINFO_STARTTRANSFER_TIME_T, &first_byte);
+    curl_easy_getinfo(curl, CURLINFO_TOTAL_TIME_T, &total);
+    curl_easy_getinfo(curl, CURLINFO_SIZE_DOWNLOAD_T, &size);
+
+    // Times are microseconds since the transfer started
+    uint64_t lookup_end = start + (uint64_t)lookup;
+    uint64_t connect_end = start + (uint64_t)(tls > connect ? tls : connect);
+    uint64_t first_byte_at = start + (uint64_t)first_byte;
+    if (lookup_end > start) trace_span(TRACE_HTTP_DNS, start, lookup_end, 0);
+    if (connect_end > lookup_end) trace_span(TRACE_HTTP_CONNECT, lookup_end, connect_end, 0);
+    trace_span(TRACE_HTTP_TTFB, connect_end, first_byte_at, 0);
+    trace_span(TRACE_HTTP_TRANSFER, first_byte_at, start + (uint64_t)total, (uint64_t)size);
+}
+
+static int curl_perform(HttpTransport* base, const HttpTransfer* transfer) {
+    CurlTransport* transport = (CurlTransport*)base;
+
+    CURL* curl = acquire_handle(transport);
+    if (!curl) {
+        fprintf(stderr, "Failed to create HTTP handle\n");
+        return -1;
+    }
+
+    struct curl_slist* headers = NULL;
+    for (int i = 0; transfer->headers && transfer->headers[i]; i++) {
+        headers = curl_slist_append(headers, transfer->headers[i]);
+    }
+
+    curl_easy_setopt(curl, CURLOPT_URL, transfer->url);
+    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+    if (transfer->body) {
+        curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE, (long)transfer->body_length);
+        curl_easy_setopt(curl, CURLOPT_POSTFIELDS, transfer->body);
+    }
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, transfer->write_fn);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, transfer->write_userp);
+    if (transfer->header_fn) {
+        curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, transfer->header_fn);
+        curl_easy_setopt(curl, CURLOPT_HEADERDATA, transfer->header_userp);
+    }
+    if (transfer->progress_fn) {
+        curl_easy_setopt(curl, CURLOPT_XFERINFOFUNCTION, xferinfo_callback);
+        curl_easy_setopt(curl, CURLOPT_XFERINFODATA, transfer);
+        curl_easy_setopt(curl, CURLOPT_NOPROGRESS, 0L);
+    }
+
+    long status = -1;
+    uint64_t start = trace_now_us();
+    CURLcode res = curl_easy_perform(curl);
+    if (res == CURLE_OK) {
+        curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &status);
+        trace_phases(curl, start);
+    } else {
+        fprintf(stderr, "Request to %s failed: %s\n", transfer->url, curl_easy_strerror(res));
+    }
+
+    curl_slist_free_all(headers);
+    release_handle(transport, curl);
+    return (int)status;
+}
+
+static void curl_destroy(HttpTransport* base) {
+    CurlTransport* transport = (CurlTransport*)base;
+
+    for (int i = 0; i < transport->idle_count; i++) {
+        curl_easy_cleanup(transport->idle[i]);
+    }
+    if (transport->share) curl_share_cleanup(transport->share);
+
+    for (int i = 0; i < CURL_LOCK_DATA_LAST; i++) {
+        pthread_mutex_destroy(&transport->share_locks[i]);
+    }
+    pthread_mutex_destroy(&transport->pool_lock);
+    free(transport);
+    curl_global_cleanup();
+}
+
+static const HttpTransportOps curl_transport_ops = {
+    curl_perform,
+    curl_destroy,
+};
+
+HttpTransport* curl_transport_create(void) {
+    if (curl_global_init(CURL_GLOBAL_DEFAULT) != CURLE_OK) {
+        fprintf(stderr, "Failed to initialize libcurl\n");
+        return NULL;
+    }
+
+    CurlTransport* transport = calloc(1, sizeof(CurlTransport));
+    if (!transport) {
+        curl_global_cleanup();
+        return NULL;
+    }
+    transport->base.ops = &curl_transport_ops;
+
+    for (int i = 0; i < CURL_LOCK_DATA_LAST; i++) {
+        pthread_mutex_init(&transport->share_locks[i], NULL);
+    }
+    pthread_mutex_init(&transport->pool_lock, NULL);
+
+    transport->share = curl_share_init();
+    if (transport->share) {
+        curl_share_setopt(transport->share, CURLSHOPT_LOCKFUNC, share_lock);
+        curl_share_setopt(transport->share, CURLSHOPT_UNLOCKFUNC, share_unlock);
+        curl_share_setopt(transport->share, CURLSHOPT_USERDATA, transport);
+        curl_share_setopt(transport->share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+        curl_share_setopt(transport->share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+    }
+
+    return &transport->base;
+}
@@ -0,0 +1,467 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <errno.h>
+#include <unistd.h>
+#include <zlib.h>
+#include "unzip.h"
+#include "download.h"
+#include "hash.h"
+#include "file_writer.h"
+
+#define ZIP_LOCAL_SIGNATURE 0x04034b50u
+#define ZIP_CENTRAL_SIGNATURE 0x02014b50u
+#define ZIP_END_SIGNATURE 0x06054b50u
+#define ZIP_DESCRIPTOR_SIGNATURE 0x08074b50u
+#define ZIP_LOCAL_HEADER_SIZE 30
+#define ZIP_FLAG_ENCRYPTED (1u << 0)
+#define ZIP_FLAG_DESCRIPTOR (1u << 3)     // CRC and sizes follow the data instead
+#define ZIP_METHOD_STORED 0
+#define ZIP_METHOD_DEFLATED 8
+#define ZIP_EXTRA_ZIP64 0x0001
+#define ZIP_WINDOW_SIZE (64 * 1024)       // Inflated bytes written at a time
+#define ZIP_SKIPPED_PREFIX "__MACOSX/"    // Resource forks, Onion would list them as ROMs
+
+enum {
+    ZIP_HEADER,       // Signature and fixed part of the next record
+    ZIP_NAME,         // Name and extra field of a local header
+    ZIP_DATA,
+    ZIP_DESCRIPTOR,
+    ZIP_DONE,         // Central directory reached, the rest is ignored
+    ZIP_FAILED
+};
+
+struct ZipExtractor {
+    char* directory;
+    int state;
+    unsigned char* buffer;       // Header bytes gathered across feeds
+    size_t buffer_size;
+    size_t buffer_capacity;
+    size_t needed;               // Bytes the current state wants in buffer
+    uint16_t flags;              // Of the current entry
+    uint16_t method;
+    uint32_t expected_crc;
+    uint64_t expected_size;
+    uint64_t compressed_left;    // Unknown (and unused) with a data descriptor
+    bool zip64;
+    uint32_t crc;
+    uint64_t written;
+    bool skipping;               // Entry is consumed without being written
+    char* path;
+    char* part_path;
+    FileWriter* writer;          // Open while an entry that is kept is extracted
+    bool inflate_ready;
+    z_stream zs;
+    char** files;                // Final paths of the verified entries, each still at <path>.part
+    int file_count;
+    int file_capacity;
+    unsigned char window[ZIP_WINDOW_SIZE];
+};
+
+static uint16_t read16(const unsigned char* p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t read32(const unsigned char* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint64_t read64(const unsigned char* p) {
+    return (uint64_t)read32(p) | ((uint64_t)read32(p + 4) << 32);
+}
+
+static int fail(ZipExtractor* extractor, const char* reason) {
+    fprintf(stderr, "Failed to extract archive into %s: %s\n", extractor->directory, reason);
+    extractor->state = ZIP_FAILED;
+    return -1;
+}
+
+// Copy input into buffer until it holds needed bytes; true once it does
+static bool gather(ZipExtractor* extractor, const unsigned char** data, size_t* length) {
+    size_t take = extractor->needed - extractor->buffer_size;
+    if (take > *length) take = *length;
+
+    memcpy(extractor->buffer + extractor->buffer_size, *data, take);
+    extractor->buffer_size += take;
+    *data += take;
+    *length -= take;
+    return extractor->buffer_size == extractor->needed;
+}
+
+static int expect(ZipExtractor* extractor, int state, size_t needed) {
+    if (needed > extractor->buffer_capacity) {
+        unsigned char* buffer = realloc(extractor->buffer, needed);
+        if (!buffer) return fail(extractor, "out of memory");
+        extractor->buffer = buffer;
+        extractor->buffer_capacity = needed;
+    }
+    extractor->state = state;
+    extractor->needed = needed;
+    return 0;
+}
+
+ZipExtractor* zip_extractor_init(const char* directory) {
+    ZipExtractor* extractor = calloc(1, sizeof(struct ZipExtractor));
+    if (!extractor) return NULL;
+
+    extractor->directory = strdup(directory);
+    if (!extractor->directory || expect(extractor, ZIP_HEADER, 4) != 0) {
+        zip_extractor_free(extractor);
+        return NULL;
+    }
+    return extractor;
+}
+
+static void close_entry(ZipExtractor* extractor) {
+    if (extractor->writer) file_writer_close(extractor->writer, false);
+    extractor->writer = NULL;
+    free(extractor->path);
+    free(extractor->part_path);
+    extractor->path = NULL;
+    extractor->part_path = NULL;
+}
+
+void zip_extractor_free(ZipExtractor* extractor) {
+    if (!extractor) return;
+
+    if (extractor->part_path) unlink(extractor->part_path);
+    close_entry(extractor);
+    if (extractor->inflate_ready) inflateEnd(&extractor->zs);
+    for (int i = 0; i < extractor->file_count; i++) {
+        free(extractor->files[i]);
+    }
+    free(extractor->files);
+    free(extractor->buffer);
+    free(extractor->directory);
+    free(extractor);
+}
+
+// "<path>.part", where an entry stays until the whole archive is verified
+static char* part_path_of(const char* path) {
+    size_t length = strlen(path) + sizeof(".part");
+    char* part_path = malloc(length);
+    if (part_path) snprintf(part_path, length, "%s.part", path);
+    return part_path;
+}
+
+int zip_extractor_commit(ZipExtractor* extractor) {
+    if (!extractor || extractor->state != ZIP_DONE) return -1;
+
+    int result = 0;
+    for (int i = 0; i < extractor->file_count; i++) {
+        char* part_path = part_path_of(extractor->files[i]);
+        if (!part_path || rename(part_path, extractor->files[i]) != 0) {
+            fprintf(stderr, "Failed to move %s into place: %s\n", extractor->files[i], strerror(errno));
+            if (part_path) unlink(part_path);
+            result = -1;
+        }
+        free(part_path);
+        free(extractor->files[i]);
+    }
+    extractor->file_count = 0;
+    return result;
+}
+
+void zip_extractor_discard(ZipExtractor* extractor) {
+    if (!extractor) return;
+
+    if (extractor->part_path) unlink(extractor->part_path);
+    close_entry(extractor);
+    for (int i = 0; i < extractor->file_count; i++) {
+        char* part_path = part_path_of(extractor->files[i]);
+        if (part_path) unlink(part_path);
+        free(part_path);
+    }
+}
+
+// Entry names come from the server: no absolute paths and no way out of the directory
+static bool safe_name(const char* name) {
+    if (name[0] == '/' || strchr(name, '\\')) return false;
+
+    for (const char* part = name; *part; ) {
+        size_t part_length = strcspn(part, "/");
+        if (part_length == 2 && part[0] == '.' && part[1] == '.') return false;
+        part += part_length;
+        if (*part == '/') part++;
+    }
+    return true;
+}
+
+static char* join_path(const char* directory, const char* name, const char* suffix) {
+    size_t length = strlen(directory) + strlen(name) + strlen(suffix) + 2;
+    char* path = malloc(length);
+    if (path) snprintf(path, length, "%s/%s%s", directory, name, suffix);
+    return path;
+}
+
+// Sizes of 0xFFFFFFFF in the local header are in the zip64 extra field
+static void read_zip64_extra(ZipExtractor* extractor, const unsigned char* extra, size_t extra_length,
+                             uint32_t size, uint32_t compressed_size) {
+    while (extra_length >= 4) {
+        uint16_t id = read16(extra);
+        uint16_t field_length = read16(extra + 2);
+        if ((size_t)field_length + 4 > extra_length) return;
+
+        if (id == ZIP_EXTRA_ZIP64) {
+            const unsigned char* field = extra + 4;
+            size_t left = field_length;
+            extractor->zip64 = true;
+            if (size == UINT32_MAX && left >= 8) {
+                extractor->expected_size = read64(field);
+                field += 8;
+                left -= 8;
+            }
+            if (compressed_size == UINT32_MAX && left >= 8) {
+                extractor->compressed_left = read64(field);
+            }
+            return;
+        }
+        extra += field_length + 4;
+        extra_length -= field_length + 4;
+    }
+}
+
+static int finish_entry(ZipExtractor* extractor) {
+    if (extractor->written != extractor->expected_size || extractor->crc != extractor->expected_crc) {
+        return fail(extractor, "entry does not match its CRC32");
+    }
+
+    if (extractor->writer) {
+        bool failed = file_writer_close(extractor->writer, true) != 0;
+        extractor->writer = NULL;
+        if (failed) return fail(extractor, "write error");
+
+        // Left as .part until zip_extractor_commit. A later entry of the same name
+        // rewrote the same .part, so it is listed once.
+        free(extractor->part_path);
+        extractor->part_path = NULL;
+        bool listed = false;
+        for (int i = 0; i < extractor->file_count && !listed; i++) {
+            listed = strcmp(extractor->files[i], extractor->path) == 0;
+        }
+
+        if (!listed && extractor->file_count == extractor->file_capacity) {
+            int capacity = extractor->file_capacity ? extractor->file_capacity * 2 : 8;
+            char** files = realloc(extractor->files, capacity * sizeof(char*));
+            if (!files) return fail(extractor, "out of memory");
+            extractor->files = files;
+            extractor->file_capacity = capacity;
+        }
+        if (!listed) {
+            extractor->files[extractor->file_count++] = extractor->path;
+            extractor->path = NULL;
+        }
+    }
+
+    close_entry(extractor);
+    extractor->buffer_size = 0;
+    return expect(extractor, ZIP_HEADER, 4);
+}
+
+// Data of the entry ended: its CRC and sizes are either known or follow now
+static int end_data(ZipExtractor* extractor) {
+    extractor->buffer_size = 0;
+    if (extractor->flags & ZIP_FLAG_DESCRIPTOR) return expect(extractor, ZIP_DESCRIPTOR, 4);
+    return finish_entry(extractor);
+}
+
+static int start_entry(ZipExtractor* extractor) {
+    const unsigned char* header = extractor->buffer;
+    uint16_t name_length = read16(header + 26);
+    uint16_t extra_length = read16(header + 28);
+    uint32_t compressed_size = read32(header + 18);
+    uint32_t size = read32(header + 22);
+
+    extractor->flags = read16(header + 6);
+    extractor->method = read16(header + 8);
+    extractor->expected_crc = read32(header + 14);
+    extractor->expected_size = size;
+    extractor->compressed_left = compressed_size;
+    extractor->zip64 = false;
+    extractor->crc = 0;
+    extractor->written = 0;
+    read_zip64_extra(extractor, header + ZIP_LOCAL_HEADER_SIZE + name_length, extra_length, size, compressed_size);
+
+    if (extractor->flags & ZIP_FLAG_ENCRYPTED) return fail(extractor, "encrypted entries are not supported");
+    if (extractor->method != ZIP_METHOD_STORED && extractor->method != ZIP_METHOD_DEFLATED) {
+        return fail(extractor, "unsupported compression method");
+    }
+
+    char name[1024];
+    if (name_length == 0 || name_length >= sizeof(name)) return fail(extractor, "bad entry name");
+    memcpy(name, header + ZIP_LOCAL_HEADER_SIZE, name_length);
+    name[name_length] = '\0';
+    if (!safe_name(name)) return fail(extractor, "entry name leaves the directory");
+
+    // A stored entry of unknown size has no end that can be found while streaming,
+    // except a directory, which has no data at all
+    bool directory = name[name_length - 1] == '/';
+    if (extractor->method == ZIP_METHOD_STORED && (extractor->flags & ZIP_FLAG_DESCRIPTOR)) {
+        if (!directory) return fail(extractor, "stored entry without sizes");
+        extractor->compressed_left = 0;
+    }
+
+    extractor->skipping = directory || strncmp(name, ZIP_SKIPPED_PREFIX, strlen(ZIP_SKIPPED_PREFIX)) == 0;
+    if (!extractor->skipping) {
+        extractor->path = join_path(extractor->directory, name, "");
+        extractor->part_path = join_path(extractor->directory, name, ".part");
+        if (!extractor->path || !extractor->part_path) return fail(extractor, "out of memory");
+        if (make_parent_dirs(extractor->path) != 0) return fail(extractor, "cannot create directory");
+
+        extractor->writer = file_writer_open(extractor->part_path, 0);
+        if (!extractor->writer) return fail(extractor, "cannot open entry");
+        if (!(extractor->flags & ZIP_FLAG_DESCRIPTOR)) file_writer_reserve(extractor->writer, (long long)extractor->expected_size);
+    } else if (directory) {
+        char* path = join_path(extractor->directory, name, "");
+        int result = path ? make_parent_dirs(path) : -1;
+        free(path);
+        if (result != 0) return fail(extractor, "cannot create directory");
+    }
+
+    if (extractor->method == ZIP_METHOD_DEFLATED) {
+        // Raw deflate, the zip entry has no zlib header
+        int result = extractor->inflate_ready ? inflateReset(&extractor->zs) : inflateInit2(&extractor->zs, -15);
+        if (result != Z_OK) return fail(extractor, "cannot initialize inflate");
+        extractor->inflate_ready = true;
+    }
+
+    extractor->state = ZIP_DATA;
+    if (extractor->method == ZIP_METHOD_STORED && extractor->compressed_left == 0) return end_data(extractor);
+    return 0;
+}
+
+static int write_data(ZipExtractor* extractor, const unsigned char* data, size_t length) {
+    extractor->crc = crc32_update(extractor->crc, data, length);
+    extractor->written += length;
+    if (extractor->written > extractor->expected_size && !(extractor->flags & ZIP_FLAG_DESCRIPTOR)) {
+        return fail(extractor, "entry larger than its header says");
+    }
+
+    if (extractor->writer && file_writer_write(extractor->writer, data, length) != 0) {
+        return fail(extractor, "write error");
+    }
+    return 0;
+}
+
+// Consume entry data from the input, returns the bytes used or -1
+static long long feed_data(ZipExtractor* extractor, const unsigned char* data, size_t length) {
+    bool sized = !(extractor->flags & ZIP_FLAG_DESCRIPTOR);
+    if (sized && length > extractor->compressed_left) length = (size_t)extractor->compressed_left;
+
+    if (extractor->method == ZIP_METHOD_STORED) {
+        if (write_data(extractor, data, length) != 0) return -1;
+        extractor->compressed_left -= length;
+        if (extractor->compressed_left == 0 && end_data(extractor) != 0) return -1;
+        return (long long)length;
+    }
+
+    z_stream* zs = &extractor->zs;
+    zs->next_in = (unsigned char*)data;
+    zs->avail_in = (uInt)length;
+    int result = Z_OK;
+    while (result != Z_STREAM_END && (zs->avail_in > 0 || zs->avail_out == 0)) {
+        zs->next_out = extractor->window;
+        zs->avail_out = sizeof(extractor->window);
+        result = inflate(zs, Z_NO_FLUSH);
+        if (result != Z_OK && result != Z_STREAM_END && result != Z_BUF_ERROR) {
+            fail(extractor, zs->msg ? zs->msg : "corrupt deflate data");
+            return -1;
+        }
+
+        size_t produced = sizeof(extractor->window) - zs->avail_out;
+        if (produced > 0 && write_data(extractor, extractor->window, produced) != 0) return -1;
+        if (result == Z_BUF_ERROR && produced == 0) break;
+    }
+
+    size_t used = length - zs->avail_in;
+    if (sized) extractor->compressed_left -= used;
+    if (result == Z_STREAM_END) {
+        if (end_data(extractor) != 0) return -1;
+    } else if (sized && extractor->compressed_left == 0) {
+        fail(extractor, "deflate data ended early");
+        return -1;
+    }
+    return (long long)used;
+}
+
+// Signature and fixed part of a local header, or the start of the central directory
+static int read_header(ZipExtractor* extractor) {
+    if (extractor->buffer_size == 4) {
+        uint32_t signature = read32(extractor->buffer);
+        if (signature == ZIP_CENTRAL_SIGNATURE || signature == ZIP_END_SIGNATURE) {
+            extractor->state = ZIP_DONE;
+            return 0;
+        }
+        if (signature != ZIP_LOCAL_SIGNATURE) return fail(extractor, "not a zip archive");
+        return expect(extractor, ZIP_HEADER, ZIP_LOCAL_HEADER_SIZE);
+    }
+
+    size_t names = (size_t)read16(extractor->buffer + 26) + read16(extractor->buffer + 28);
+    return expect(extractor, ZIP_NAME, ZIP_LOCAL_HEADER_SIZE + names);
+}
+
+// CRC32, compressed and uncompressed size, with or without a signature first
+static int read_descriptor(ZipExtractor* extractor) {
+    size_t size_length = extractor->zip64 ? 8 : 4;
+    bool signed_descriptor = read32(extractor->buffer) == ZIP_DESCRIPTOR_SIGNATURE;
+    size_t descriptor_length = (signed_descriptor ? 8 : 4) + 2 * size_length;
+
+    if (extractor->buffer_size < descriptor_length) return expect(extractor, ZIP_DESCRIPTOR, descriptor_length);
+
+    const unsigned char* fields = extractor->buffer + (signed_descriptor ? 4 : 0);
+    extractor->expected_crc = read32(fields);
+    extractor->expected_size = extractor->zip64 ? read64(fields + 12) : read32(fields + 8);
+    return finish_entry(extractor);
+}
+
+int zip_extractor_feed(ZipExtractor* extractor, const void* data, size_t length) {
+    if (!extractor || extractor->state == ZIP_FAILED) return -1;
+
+    const unsigned char* input = (const unsigned char*)data;
+    while (length > 0) {
+        int result = 0;
+        switch (extractor->state) {
+            case ZIP_HEADER:
+                if (gather(extractor, &input, &length)) result = read_header(extractor);
+                break;
+
+            case ZIP_NAME:
+                if (gather(extractor, &input, &length)) {
+                    result = start_entry(extractor);
+                    extractor->buffer_size = extractor->state == ZIP_DATA ? 0 : extractor->buffer_size;
+                }
+                break;
+
+            case ZIP_DATA: {
+                long long used = feed_data(extractor, input, length);
+                if (used < 0) return -1;
+                input += used;
+                length -= (size_t)used;
+                break;
+            }
+
+            case ZIP_DESCRIPTOR:
+                if (gather(extractor, &input, &length)) result = read_descriptor(extractor);
+                break;
+
+            case ZIP_DONE:
+                return 0;
+
+            default:
+                return -1;
+        }
+        if (result != 0) return -1;
+    }
+    return 0;
+}
+
+int zip_extractor_finish(ZipExtractor* extractor) {
+    if (!extractor || extractor->state == ZIP_FAILED) return -1;
+    if (extractor->state != ZIP_DONE) {
+        fail(extractor, "archive ended early");
+        return -1;
+    }
+    return 0;
+}